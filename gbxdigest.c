@@ -0,0 +1,388 @@
+// gbxdigest: CRC32, MD5, SHA-1 and SHA-256 of dump files (API in gbxdigest.h)
+// by Martin Strohmayer
+// Licence: CC BY-NC 3.0 (https://creativecommons.org/licenses/by-nc/3.0/)
+// Compile: with gbxdumper (libgbxdump.c) and gbxreceive, needs -lz
+//          (64 bit with SHA extensions, e.g. Pi 5: add -march=armv8-a+crypto)
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include "gbxdigest.h"
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+// gcc -march=armv8-a+crypto, used when the CPU reports the extension
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define SHA_ARMV8
+#endif
+
+typedef unsigned char BYTE;
+
+static const unsigned int SHA256K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#ifdef SHA_ARMV8
+unsigned long SHAHardware(void) {
+	static int bChecked = 0;
+	static unsigned long nHWCap = 0;
+
+	if (!bChecked) {
+		nHWCap = getauxval(AT_HWCAP) & (HWCAP_SHA1 | HWCAP_SHA2);
+		bChecked = 1;
+	}
+	return nHWCap;
+}
+
+// 16 groups of 4 rounds, MSG[i&3] holds W[4i..4i+3]
+void SHA256TransformARMv8(unsigned int* pState, const BYTE* pBlock) {
+	uint32x4_t State0 = vld1q_u32(&pState[0]);
+	uint32x4_t State1 = vld1q_u32(&pState[4]);
+	uint32x4_t Save0 = State0, Save1 = State1;
+	uint32x4_t MSG[4], Tmp0, Tmp2;
+	int i;
+
+	for (i=0; i<4; i++) {
+		MSG[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&pBlock[16*i])));
+	}
+	for (i=0; i<16; i++) {
+		Tmp0 = vaddq_u32(MSG[i&3], vld1q_u32(&SHA256K[4*i]));
+		Tmp2 = State0;
+		State0 = vsha256hq_u32(State0, State1, Tmp0);
+		State1 = vsha256h2q_u32(State1, Tmp2, Tmp0);
+		if (i<12) {
+			MSG[i&3] = vsha256su1q_u32(vsha256su0q_u32(MSG[i&3], MSG[(i+1)&3]), MSG[(i+2)&3], MSG[(i+3)&3]);
+		}
+	}
+	vst1q_u32(&pState[0], vaddq_u32(State0, Save0));
+	vst1q_u32(&pState[4], vaddq_u32(State1, Save1));
+}
+#endif
+
+void SHA256Transform(struct SHA256Struct* pSHA, const BYTE* pBlock) {
+	unsigned int W[64], a, b, c, d, e, f, g, h, t1, t2;
+	int i;
+
+#ifdef SHA_ARMV8
+	if (SHAHardware() & HWCAP_SHA2) {
+		SHA256TransformARMv8(pSHA->State, pBlock);
+		return;
+	}
+#endif
+	for (i=0; i<16; i++) {
+		W[i] = (pBlock[4*i]<<24) | (pBlock[4*i+1]<<16) | (pBlock[4*i+2]<<8) | pBlock[4*i+3];
+	}
+	for (i=16; i<64; i++) {
+		W[i] = W[i-16] + (SHA256_ROR(W[i-15], 7) ^ SHA256_ROR(W[i-15], 18) ^ (W[i-15] >> 3))
+		     + W[i-7] + (SHA256_ROR(W[i-2], 17) ^ SHA256_ROR(W[i-2], 19) ^ (W[i-2] >> 10));
+	}
+	a = pSHA->State[0]; b = pSHA->State[1]; c = pSHA->State[2]; d = pSHA->State[3];
+	e = pSHA->State[4]; f = pSHA->State[5]; g = pSHA->State[6]; h = pSHA->State[7];
+	for (i=0; i<64; i++) {
+		t1 = h + (SHA256_ROR(e, 6) ^ SHA256_ROR(e, 11) ^ SHA256_ROR(e, 25)) + ((e & f) ^ (~e & g)) + SHA256K[i] + W[i];
+		t2 = (SHA256_ROR(a, 2) ^ SHA256_ROR(a, 13) ^ SHA256_ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	pSHA->State[0] += a; pSHA->State[1] += b; pSHA->State[2] += c; pSHA->State[3] += d;
+	pSHA->State[4] += e; pSHA->State[5] += f; pSHA->State[6] += g; pSHA->State[7] += h;
+}
+
+void SHA256Init(struct SHA256Struct* pSHA) {
+	static const unsigned int Init[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	memcpy(pSHA->State, Init, sizeof(Init));
+	pSHA->nLength = 0;
+	pSHA->nBlock = 0;
+}
+
+void SHA256Update(struct SHA256Struct* pSHA, const BYTE* pData, size_t nLen) {
+	pSHA->nLength += nLen;
+	if (pSHA->nBlock) {
+		while (nLen && pSHA->nBlock<64) {
+			pSHA->Block[pSHA->nBlock++] = *pData++;
+			nLen--;
+		}
+		if (pSHA->nBlock<64) {
+			return;
+		}
+		SHA256Transform(pSHA, pSHA->Block);
+		pSHA->nBlock = 0;
+	}
+	for (; nLen>=64; nLen-=64, pData+=64) {
+		SHA256Transform(pSHA, pData);
+	}
+	memcpy(pSHA->Block, pData, nLen);
+	pSHA->nBlock = nLen;
+}
+
+void SHA256Final(struct SHA256Struct* pSHA, BYTE* pDigest) {
+	unsigned long long nBits = pSHA->nLength * 8;
+	int i;
+
+	pSHA->Block[pSHA->nBlock++] = 0x80;
+	if (pSHA->nBlock>56) {
+		memset(&pSHA->Block[pSHA->nBlock], 0, 64-pSHA->nBlock);
+		SHA256Transform(pSHA, pSHA->Block);
+		pSHA->nBlock = 0;
+	}
+	memset(&pSHA->Block[pSHA->nBlock], 0, 56-pSHA->nBlock);
+	for (i=0; i<8; i++) {
+		pSHA->Block[56+i] = (BYTE)(nBits >> (56-8*i));
+	}
+	SHA256Transform(pSHA, pSHA->Block);
+	for (i=0; i<32; i++) {
+		pDigest[i] = (BYTE)(pSHA->State[i/4] >> (24-8*(i%4)));
+	}
+}
+
+#ifdef SHA_ARMV8
+// 20 groups of 4 rounds, MSG[i&3] holds W[4i..4i+3]
+void SHA1TransformARMv8(unsigned int* pState, const BYTE* pBlock) {
+	static const unsigned int K[4] = {0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6};
+	uint32x4_t ABCD = vld1q_u32(&pState[0]);
+	uint32x4_t Save = ABCD;
+	uint32x4_t MSG[4], Tmp;
+	uint32_t E0 = pState[4], E1;
+	int i;
+
+	for (i=0; i<4; i++) {
+		MSG[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&pBlock[16*i])));
+	}
+	for (i=0; i<20; i++) {
+		Tmp = vaddq_u32(MSG[i&3], vdupq_n_u32(K[i/5]));
+		E1 = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+		if (i<5) {
+			ABCD = vsha1cq_u32(ABCD, E0, Tmp);
+		} else if (i>=10 && i<15) {
+			ABCD = vsha1mq_u32(ABCD, E0, Tmp);
+		} else {
+			ABCD = vsha1pq_u32(ABCD, E0, Tmp);
+		}
+		E0 = E1;
+		if (i<16) {
+			MSG[i&3] = vsha1su1q_u32(vsha1su0q_u32(MSG[i&3], MSG[(i+1)&3], MSG[(i+2)&3]), MSG[(i+3)&3]);
+		}
+	}
+	vst1q_u32(&pState[0], vaddq_u32(ABCD, Save));
+	pState[4] += E0;
+}
+#endif
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+void SHA1Transform(struct SHA1Struct* pSHA, const BYTE* pBlock) {
+	unsigned int W[80], a, b, c, d, e, f, k, t;
+	int i;
+
+#ifdef SHA_ARMV8
+	if (SHAHardware() & HWCAP_SHA1) {
+		SHA1TransformARMv8(pSHA->State, pBlock);
+		return;
+	}
+#endif
+	for (i=0; i<16; i++) {
+		W[i] = (pBlock[4*i]<<24) | (pBlock[4*i+1]<<16) | (pBlock[4*i+2]<<8) | pBlock[4*i+3];
+	}
+	for (i=16; i<80; i++) {
+		W[i] = ROL32(W[i-3] ^ W[i-8] ^ W[i-14] ^ W[i-16], 1);
+	}
+	a = pSHA->State[0]; b = pSHA->State[1]; c = pSHA->State[2]; d = pSHA->State[3]; e = pSHA->State[4];
+	for (i=0; i<80; i++) {
+		if (i<20) {
+			f = (b & c) | (~b & d); k = 0x5a827999;
+		} else if (i<40) {
+			f = b ^ c ^ d; k = 0x6ed9eba1;
+		} else if (i<60) {
+			f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d; k = 0xca62c1d6;
+		}
+		t = ROL32(a, 5) + f + e + k + W[i];
+		e = d; d = c; c = ROL32(b, 30); b = a; a = t;
+	}
+	pSHA->State[0] += a; pSHA->State[1] += b; pSHA->State[2] += c; pSHA->State[3] += d; pSHA->State[4] += e;
+}
+
+void SHA1Init(struct SHA1Struct* pSHA) {
+	static const unsigned int Init[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+	memcpy(pSHA->State, Init, sizeof(Init));
+	pSHA->nLength = 0;
+	pSHA->nBlock = 0;
+}
+
+void SHA1Update(struct SHA1Struct* pSHA, const BYTE* pData, size_t nLen) {
+	pSHA->nLength += nLen;
+	if (pSHA->nBlock) {
+		while (nLen && pSHA->nBlock<64) {
+			pSHA->Block[pSHA->nBlock++] = *pData++;
+			nLen--;
+		}
+		if (pSHA->nBlock<64) {
+			return;
+		}
+		SHA1Transform(pSHA, pSHA->Block);
+		pSHA->nBlock = 0;
+	}
+	for (; nLen>=64; nLen-=64, pData+=64) {
+		SHA1Transform(pSHA, pData);
+	}
+	memcpy(pSHA->Block, pData, nLen);
+	pSHA->nBlock = nLen;
+}
+
+void SHA1Final(struct SHA1Struct* pSHA, BYTE* pDigest) {
+	unsigned long long nBits = pSHA->nLength * 8;
+	int i;
+
+	pSHA->Block[pSHA->nBlock++] = 0x80;
+	if (pSHA->nBlock>56) {
+		memset(&pSHA->Block[pSHA->nBlock], 0, 64-pSHA->nBlock);
+		SHA1Transform(pSHA, pSHA->Block);
+		pSHA->nBlock = 0;
+	}
+	memset(&pSHA->Block[pSHA->nBlock], 0, 56-pSHA->nBlock);
+	for (i=0; i<8; i++) {
+		pSHA->Block[56+i] = (BYTE)(nBits >> (56-8*i));
+	}
+	SHA1Transform(pSHA, pSHA->Block);
+	for (i=0; i<20; i++) {
+		pDigest[i] = (BYTE)(pSHA->State[i/4] >> (24-8*(i%4)));
+	}
+}
+
+static const unsigned int MD5K[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const BYTE MD5Shift[16] = {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+
+void MD5Transform(struct MD5Struct* pMD5, const BYTE* pBlock) {
+	unsigned int W[16], a, b, c, d, f, t;
+	int i, g;
+
+	for (i=0; i<16; i++) {
+		W[i] = pBlock[4*i] | (pBlock[4*i+1]<<8) | (pBlock[4*i+2]<<16) | ((unsigned int)pBlock[4*i+3]<<24);
+	}
+	a = pMD5->State[0]; b = pMD5->State[1]; c = pMD5->State[2]; d = pMD5->State[3];
+	for (i=0; i<64; i++) {
+		if (i<16) {
+			f = (b & c) | (~b & d); g = i;
+		} else if (i<32) {
+			f = (d & b) | (~d & c); g = (5*i+1) & 15;
+		} else if (i<48) {
+			f = b ^ c ^ d; g = (3*i+5) & 15;
+		} else {
+			f = c ^ (b | ~d); g = (7*i) & 15;
+		}
+		t = d; d = c; c = b;
+		b = b + ROL32(a + f + MD5K[i] + W[g], MD5Shift[4*(i/16) + (i&3)]);
+		a = t;
+	}
+	pMD5->State[0] += a; pMD5->State[1] += b; pMD5->State[2] += c; pMD5->State[3] += d;
+}
+
+void MD5Init(struct MD5Struct* pMD5) {
+	static const unsigned int Init[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+	memcpy(pMD5->State, Init, sizeof(Init));
+	pMD5->nLength = 0;
+	pMD5->nBlock = 0;
+}
+
+void MD5Update(struct MD5Struct* pMD5, const BYTE* pData, size_t nLen) {
+	pMD5->nLength += nLen;
+	if (pMD5->nBlock) {
+		while (nLen && pMD5->nBlock<64) {
+			pMD5->Block[pMD5->nBlock++] = *pData++;
+			nLen--;
+		}
+		if (pMD5->nBlock<64) {
+			return;
+		}
+		MD5Transform(pMD5, pMD5->Block);
+		pMD5->nBlock = 0;
+	}
+	for (; nLen>=64; nLen-=64, pData+=64) {
+		MD5Transform(pMD5, pData);
+	}
+	memcpy(pMD5->Block, pData, nLen);
+	pMD5->nBlock = nLen;
+}
+
+void MD5Final(struct MD5Struct* pMD5, BYTE* pDigest) {
+	unsigned long long nBits = pMD5->nLength * 8;
+	int i;
+
+	pMD5->Block[pMD5->nBlock++] = 0x80;
+	if (pMD5->nBlock>56) {
+		memset(&pMD5->Block[pMD5->nBlock], 0, 64-pMD5->nBlock);
+		MD5Transform(pMD5, pMD5->Block);
+		pMD5->nBlock = 0;
+	}
+	memset(&pMD5->Block[pMD5->nBlock], 0, 56-pMD5->nBlock);
+	for (i=0; i<8; i++) {
+		pMD5->Block[56+i] = (BYTE)(nBits >> (8*i));
+	}
+	MD5Transform(pMD5, pMD5->Block);
+	for (i=0; i<16; i++) {
+		pDigest[i] = (BYTE)(pMD5->State[i/4] >> (8*(i%4)));
+	}
+}
+
+char* DigestText(char* szText, const BYTE* pDigest, int nLen) {
+	int nPos;
+
+	for (nPos=0; nPos<nLen; nPos++) {
+		sprintf(&szText[2*nPos], "%02x", (unsigned int)pDigest[nPos]);
+	}
+	return szText;
+}
+
+// Slices of 4 KiB stay in the cache while CRC32, MD5, SHA-1 and SHA-256 run over them
+#define DIGEST_SLICE 0x1000
+
+void DigestInit(struct DigestStruct* pDigest) {
+	MD5Init(&pDigest->MD5Ctx);
+	SHA1Init(&pDigest->SHA1Ctx);
+	SHA256Init(&pDigest->SHA256Ctx);
+	pDigest->crc32 = crc32(0, NULL, 0);
+	pDigest->nSize = 0;
+}
+
+void DigestUpdate(struct DigestStruct* pDigest, const BYTE* pData, size_t nLen) {
+	size_t nSlice;
+
+	for (; nLen; nLen-=nSlice, pData+=nSlice) {
+		nSlice = (nLen<DIGEST_SLICE) ? nLen : DIGEST_SLICE;
+		pDigest->crc32 = crc32(pDigest->crc32, pData, nSlice);
+		MD5Update(&pDigest->MD5Ctx, pData, nSlice);
+		SHA1Update(&pDigest->SHA1Ctx, pData, nSlice);
+		SHA256Update(&pDigest->SHA256Ctx, pData, nSlice);
+		pDigest->nSize += nSlice;
+	}
+}
+
+void DigestFinal(struct DigestStruct* pDigest) {
+	MD5Final(&pDigest->MD5Ctx, pDigest->MD5);
+	SHA1Final(&pDigest->SHA1Ctx, pDigest->SHA1);
+	SHA256Final(&pDigest->SHA256Ctx, pDigest->SHA256);
+}
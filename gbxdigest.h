@@ -0,0 +1,54 @@
+// gbxdigest: CRC32, MD5, SHA-1 and SHA-256 of dump files, shared by
+// libgbxdump (DAT record, archive chunks) and gbxreceive (stream check)
+// by Martin Strohmayer
+// Licence: CC BY-NC 3.0 (https://creativecommons.org/licenses/by-nc/3.0/)
+
+#ifndef GBXDIGEST_H
+#define GBXDIGEST_H
+
+#include <stddef.h>
+
+//SHA-256 (FIPS 180-4)
+struct SHA256Struct {
+	unsigned int State[8];
+	unsigned long long nLength;
+	unsigned char Block[64];
+	int nBlock;
+};
+
+struct SHA1Struct {
+	unsigned int State[5];
+	unsigned long long nLength;
+	unsigned char Block[64];
+	int nBlock;
+};
+
+// MD5 works little endian, otherwise the same block handling as SHA
+struct MD5Struct {
+	unsigned int State[4];
+	unsigned long long nLength;
+	unsigned char Block[64];
+	int nBlock;
+};
+
+// Digests of a dump file (DAT record)
+struct DigestStruct {
+	struct MD5Struct MD5Ctx;
+	struct SHA1Struct SHA1Ctx;
+	struct SHA256Struct SHA256Ctx;
+	unsigned long crc32;
+	unsigned long nSize;
+	unsigned char MD5[16];
+	unsigned char SHA1[20];
+	unsigned char SHA256[32];
+};
+
+void SHA256Init(struct SHA256Struct* pSHA);
+void SHA256Update(struct SHA256Struct* pSHA, const unsigned char* pData, size_t nLen);
+void SHA256Final(struct SHA256Struct* pSHA, unsigned char* pDigest);
+char* DigestText(char* szText, const unsigned char* pDigest, int nLen);  // lower case hex
+void DigestInit(struct DigestStruct* pDigest);
+void DigestUpdate(struct DigestStruct* pDigest, const unsigned char* pData, size_t nLen);
+void DigestFinal(struct DigestStruct* pDigest);
+
+#endif
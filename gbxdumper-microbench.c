@@ -0,0 +1,281 @@
+// Microbenchmark of the CPU kernels of libgbxdump (no cartridge needed)
+// by Martin Strohmayer
+// Licence: CC BY-NC 3.0 (https://creativecommons.org/licenses/by-nc/3.0/)
+// Compile: gcc gbxdumper-microbench.c gbxdigest.c -o gbxdumper-microbench -Wall -lwiringPi -lz -lpthread
+//          (same flags as gbxdumper, add -O2 to compare an optimized build)
+// Execute: ./gbxdumper-microbench [-s <ROM MB>] [-r <runs>] [-l <gbalist.csv>]
+//
+// Output, one line per kernel (key=value, fields stay in this order):
+// kernel=<name> unit=<byte|word|header|lookup> count=<units per run>
+//   ns_per_unit=<best run> ms=<best run> allocations=<malloc calls per run>
+
+#define _GNU_SOURCE
+#include "libgbxdump.c"
+#include <sys/utsname.h>
+
+//Allocation counter, glibc keeps the real functions as __libc_*
+extern void* __libc_malloc(size_t nSize);
+extern void* __libc_calloc(size_t nCount, size_t nSize);
+extern void* __libc_realloc(void* pData, size_t nSize);
+unsigned long nAllocations = 0;
+
+void* malloc(size_t nSize) {
+	nAllocations++;
+	return __libc_malloc(nSize);
+}
+
+void* calloc(size_t nCount, size_t nSize) {
+	nAllocations++;
+	return __libc_calloc(nCount, nSize);
+}
+
+void* realloc(void* pData, size_t nSize) {
+	nAllocations++;
+	return __libc_realloc(pData, nSize);
+}
+
+BYTE* pBenchROM = NULL;
+DWORD nBenchROMSize = 32*1024*1024;
+int nBenchRuns = 3;
+const char* szBenchList = "gbalist.csv";
+char** ppBenchCodes = NULL;           // "AGB-XXXX-" of every gbalist row
+int nBenchCodes = 0;
+volatile DWORD dwBenchSink;           // keeps results alive
+
+typedef DWORD (*BenchKernel)(void);
+
+double BenchNow(void) {
+	struct timespec tNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return tNow.tv_sec*1e9 + tNow.tv_nsec;
+}
+
+// Best of nBenchRuns
+void BenchRun(const char* szKernel, const char* szUnit, DWORD nCount, BenchKernel pKernel) {
+	double fBest = 0, fStart, fTime;
+	unsigned long nAllocRun = 0;
+	int nRun;
+
+	for (nRun=0; nRun<nBenchRuns; nRun++) {
+		nAllocRun = nAllocations;
+		fStart = BenchNow();
+		dwBenchSink = pKernel();
+		fTime = BenchNow() - fStart;
+		nAllocRun = nAllocations - nAllocRun;
+		if (0==nRun || fTime<fBest) {
+			fBest = fTime;
+		}
+	}
+	printf("kernel=%s unit=%s count=%lu ns_per_unit=%.3f ms=%.3f allocations=%lu\n",
+	  szKernel, szUnit, nCount, fBest/nCount, fBest/1e6, nAllocRun);
+	fflush(stdout);
+}
+
+//###########################################################
+// Kernels, each one pass over its input
+
+DWORD BenchCRC32(void) {
+	return CRC32(0xFFFFFFFF, pBenchROM, nBenchROMSize);
+}
+
+DWORD BenchCRC32Word(void) {
+	const WORD* pwROM = (const WORD*)pBenchROM;
+	DWORD crc = 0xFFFFFFFF;
+	DWORD nWord;
+
+	for (nWord=0; nWord<nBenchROMSize/2; nWord++) {
+		crc = CRC32_WORD(crc, pwROM[nWord]);
+	}
+	return crc;
+}
+
+// GetROMData: both bytes of the port word through revtable (PCB 2.0 swaps)
+DWORD BenchDecodeROM(void) {
+	const WORD* pwROM = (const WORD*)pBenchROM;
+	DWORD nSum = 0;
+	DWORD nWord;
+
+	for (nWord=0; nWord<nBenchROMSize/2; nWord++) {
+		nSum += DecodeROMWord(pwROM[nWord], 1, 1, 1);
+	}
+	return nSum;
+}
+
+// GetRAMData: one byte through revtable
+DWORD BenchDecodeRAM(void) {
+	DWORD nSum = 0;
+	DWORD nByte;
+
+	for (nByte=0; nByte<nBenchROMSize; nByte++) {
+		nSum += revtable[pBenchROM[nByte]];
+	}
+	return nSum;
+}
+
+// SetAddress: low word and high byte of every address through revtable
+DWORD BenchEncodeAddress(void) {
+	DWORD nSum = 0;
+	DWORD dwAddress;
+
+	for (dwAddress=0; dwAddress<nBenchROMSize/2; dwAddress++) {
+		nSum += EncodeROMWord(dwAddress & GBA_Low_Address_Mask, 1, 1, 1);
+		nSum += revtable[(dwAddress & GBA_High_Address_Mask) >> 16];
+	}
+	return nSum;
+}
+
+#define BENCH_HEADERS 100000
+
+// DumpGBAROMHeader: logo compare and header complement
+DWORD BenchHeader(void) {
+	DWORD nValid = 0;
+	int nHeader;
+
+	for (nHeader=0; nHeader<BENCH_HEADERS; nHeader++) {
+		const BYTE* pHeader = &pBenchROM[(nHeader & 0xFF) * 0x100];
+		nValid += !memcmp(Logo, &pHeader[0x04], sizeof(Logo)-4);
+		nValid += (GBAHeaderComplement(pHeader) == pHeader[0xBD]);
+	}
+	return nValid;
+}
+
+// DumpGBAROMHeader: strstr for the game code and the row with GetCVS*Value
+DWORD BenchListLookup(void) {
+	const char* pSrcBufferMax = &GBARelaeseListBuffer[GBARelaeseListBufferSize];
+	char szText[20+1];
+	DWORD nSum = 0;
+	int nCode;
+
+	for (nCode=0; nCode<nBenchCodes; nCode++) {
+		char* pPos = strstr(GBARelaeseListBuffer, ppBenchCodes[nCode]);
+
+		if (!pPos) {
+			continue;
+		}
+		GetCVSTextValue(&pPos, pSrcBufferMax, szText, 12);
+		nSum += GetCVSIntValue(&pPos, pSrcBufferMax);
+		GetCVSTextValue(&pPos, pSrcBufferMax, szText, 2);
+		GetCVSTextValue(&pPos, pSrcBufferMax, szText, 8);
+		GetCVSTextValue(&pPos, pSrcBufferMax, szText, 20);
+		nSum += GetCVSIntValue(&pPos, pSrcBufferMax);
+	}
+	return nSum;
+}
+
+// Game code not in the list: strstr scans the whole file
+DWORD BenchListMiss(void) {
+	DWORD nFound = 0;
+	int nCode;
+
+	for (nCode=0; nCode<nBenchCodes; nCode++) {
+		nFound += (NULL != strstr(GBARelaeseListBuffer, "AGB-ZZZZ-"));
+	}
+	return nFound;
+}
+
+//###########################################################
+// Inputs
+
+// Pseudo random ROM data (fixed seed), every 256 byte a valid GBA header
+int BenchMakeROM(void) {
+	DWORD nPos, nSeed = 1;
+
+	pBenchROM = malloc(nBenchROMSize);
+	if (!pBenchROM) {
+		return 0;
+	}
+	for (nPos=0; nPos<nBenchROMSize; nPos++) {
+		nSeed = (nSeed*1103515245 + 12345) & 0xFFFFFFFF;
+		pBenchROM[nPos] = nSeed >> 16;
+	}
+	for (nPos=0; nPos<0x100*0x100 && nPos+0xC0<=nBenchROMSize; nPos+=0x100) {
+		memcpy(&pBenchROM[nPos+0x04], Logo, sizeof(Logo)-4);
+		memcpy(&pBenchROM[nPos+0xA0], "BENCHMARK\0\0\0BNCE01", 18);
+		pBenchROM[nPos+0xBD] = GBAHeaderComplement(&pBenchROM[nPos]);
+	}
+	return 1;
+}
+
+int BenchLoadList(void) {
+	struct stat fileStat;
+	FILE* fp;
+	char* pPos;
+
+	fp = fopen(szBenchList, "r");
+	if (!fp || fstat(fileno(fp), &fileStat)!=0) {
+		perror(szBenchList);
+		return 0;
+	}
+	GBARelaeseListBufferSize = fileStat.st_size;
+	GBARelaeseListBuffer = malloc(GBARelaeseListBufferSize+1);
+	ppBenchCodes = malloc(sizeof(char*) * (GBARelaeseListBufferSize/10+1));
+	if (!GBARelaeseListBuffer || !ppBenchCodes) {
+		fclose(fp);
+		return 0;
+	}
+	GBARelaeseListBufferSize = fread(GBARelaeseListBuffer, 1, GBARelaeseListBufferSize, fp);
+	GBARelaeseListBuffer[GBARelaeseListBufferSize] = '\0';
+	fclose(fp);
+	//lookup keys in list order, like DumpGBAROMHeader builds them
+	pPos = GBARelaeseListBuffer;
+	while ((pPos = strstr(pPos, "AGB-")) != NULL) {
+		if (pPos[8]=='-') {
+			ppBenchCodes[nBenchCodes] = strndup(pPos, 9);
+			nBenchCodes += (ppBenchCodes[nBenchCodes] != NULL);
+		}
+		pPos += 4;
+	}
+	return nBenchCodes>0;
+}
+
+void print_usage() {
+	printf("Usage: gbxdumper-microbench [-s <ROM MB>] [-r <runs>] [-l <gbalist.csv>]\n");
+}
+
+int main(int argc, char* argv[]) {
+	struct utsname Machine;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:r:l:")) != -1) {
+		switch (c) {
+			case 's':
+				nBenchROMSize = (DWORD)atoi(optarg)*1024*1024;
+				break;
+			case 'r':
+				nBenchRuns = atoi(optarg);
+				break;
+			case 'l':
+				szBenchList = optarg;
+				break;
+			default:
+				print_usage();
+				exit(EXIT_FAILURE);
+		}
+	}
+	if (nBenchROMSize<0x10000 || nBenchRuns<1) {
+		print_usage();
+		exit(EXIT_FAILURE);
+	}
+	uname(&Machine);
+#ifdef __OPTIMIZE__
+	printf("# gbxdumper-microbench machine=%s build=optimized runs=%d\n", Machine.machine, nBenchRuns);
+#else
+	printf("# gbxdumper-microbench machine=%s build=O0 runs=%d\n", Machine.machine, nBenchRuns);
+#endif
+	if (!BenchMakeROM()) {
+		fprintf(stderr, "no memory for %lu byte ROM\n", nBenchROMSize);
+		exit(EXIT_FAILURE);
+	}
+	BenchRun("crc32", "byte", nBenchROMSize, BenchCRC32);
+	BenchRun("crc32_word", "word", nBenchROMSize/2, BenchCRC32Word);
+	BenchRun("decode_rom", "word", nBenchROMSize/2, BenchDecodeROM);
+	BenchRun("decode_ram", "byte", nBenchROMSize, BenchDecodeRAM);
+	BenchRun("encode_address", "word", nBenchROMSize/2, BenchEncodeAddress);
+	BenchRun("header_check", "header", BENCH_HEADERS, BenchHeader);
+	if (BenchLoadList()) {
+		BenchRun("gbalist_lookup", "lookup", nBenchCodes, BenchListLookup);
+		BenchRun("gbalist_miss", "lookup", nBenchCodes, BenchListMiss);
+	}
+	return 0;
+}
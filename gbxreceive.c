@@ -0,0 +1,291 @@
+// Receiver for gbxdumper --stream
+// by Martin Strohmayer
+// Licence: CC BY-NC 3.0 (https://creativecommons.org/licenses/by-nc/3.0/)
+// Compile: gcc gbxreceive.c gbxdigest.c -o gbxreceive -Wall -lz
+// Execute pipe:   ./gbxdumper -b -c -x --stream - | ./gbxreceive [dir]
+// Execute socket: ./gbxreceive -u /tmp/gbx.sock [dir]  and  ./gbxdumper --stream unix:/tmp/gbx.sock
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <zlib.h>
+#include "gbxdigest.h"
+
+typedef unsigned char BYTE;
+typedef unsigned long DWORD;
+
+#define STREAM_HEADER_SIZE 20
+#define STREAM_CLOSE_SIZE (1+4+4+32)
+#define STREAM_MAX_PAYLOAD 0x100000
+
+typedef enum {
+	StreamFrameOpen = 1,
+	StreamFrameData,
+	StreamFrameClose,
+	StreamFrameRename,
+	StreamFrameRemove,
+	StreamFrameEnd
+} StreamFrameType;
+
+char szDirectory[PATH_MAX] = ".";
+
+struct ReceiveFileStruct {
+	char szFileName[256];
+	int fd;
+	struct DigestStruct Digest;
+} File = { .fd = -1 };
+
+DWORD Get32(const BYTE* p) {
+	return p[0] | (p[1]<<8) | (p[2]<<16) | ((DWORD)p[3]<<24);
+}
+
+// Read exactly nLen bytes, 0 at end of stream
+int ReadAll(int fd, BYTE* pBuffer, size_t nLen) {
+	ssize_t nRead;
+
+	while (nLen) {
+		nRead = read(fd, pBuffer, nLen);
+		if (nRead<0 && errno==EINTR) {
+			continue;
+		}
+		if (nRead<=0) {
+			return 0;
+		}
+		pBuffer += nRead;
+		nLen -= nRead;
+	}
+	return 1;
+}
+
+// File names from the dumper, no paths
+int GetFileName(char* szPath, size_t nSize, const BYTE* pPayload, DWORD nLen, char* szName) {
+	if (nLen==0 || nLen>=sizeof(File.szFileName) || pPayload[0]=='.' || memchr(pPayload, '/', nLen) || memchr(pPayload, '\0', nLen)) {
+		return 0;
+	}
+	memcpy(szName, pPayload, nLen);
+	szName[nLen] = '\0';
+	snprintf(szPath, nSize, "%s/%s", szDirectory, szName);
+	return 1;
+}
+
+int ReceiveFrame(StreamFrameType nType, const BYTE* pPayload, DWORD nLen) {
+	char szPath[PATH_MAX+256];
+	char szNewPath[PATH_MAX+256];
+	char szNewName[sizeof(File.szFileName)];
+	char szMD5[32+1], szSHA1[40+1], szSHA256[64+1];
+
+	switch (nType) {
+		case StreamFrameOpen:
+			if (File.fd>=0 || !GetFileName(szPath, sizeof(szPath), pPayload, nLen, File.szFileName)) {
+				fprintf(stderr, "invalid open frame\n");
+				return 0;
+			}
+			File.fd = open(szPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (File.fd<0) {
+				perror(szPath);
+				return 0;
+			}
+			DigestInit(&File.Digest);
+			break;
+		case StreamFrameData:
+			if (File.fd<0) {
+				fprintf(stderr, "data frame without file\n");
+				return 0;
+			}
+			if (nLen != (DWORD)write(File.fd, pPayload, nLen)) {
+				perror(File.szFileName);
+				return 0;
+			}
+			DigestUpdate(&File.Digest, pPayload, nLen);
+			break;
+		case StreamFrameClose:
+			if (File.fd<0 || nLen!=STREAM_CLOSE_SIZE) {
+				fprintf(stderr, "invalid close frame\n");
+				return 0;
+			}
+			if (0!=fsync(File.fd) || 0!=close(File.fd)) {
+				perror(File.szFileName);
+				File.fd = -1;
+				return 0;
+			}
+			File.fd = -1;
+			DigestFinal(&File.Digest);
+			snprintf(szPath, sizeof(szPath), "%s/%s", szDirectory, File.szFileName);
+			if (pPayload[0]!=0 || Get32(&pPayload[1])!=File.Digest.nSize) {
+				printf("%s: dump failed (%lu of %lu bytes), removed\n", File.szFileName, File.Digest.nSize, Get32(&pPayload[1]));
+				unlink(szPath);
+				File.szFileName[0] = '\0';
+				break;
+			}
+			//digests of the dumper over the same bytes
+			if (Get32(&pPayload[5])!=File.Digest.crc32 || memcmp(&pPayload[9], File.Digest.SHA256, 32)) {
+				printf("%s: CRC32 %08X or SHA-256 differs from the dumper, removed\n", File.szFileName, (unsigned int)File.Digest.crc32);
+				unlink(szPath);
+				File.szFileName[0] = '\0';
+				break;
+			}
+			printf("%s: %lu bytes, CRC32 %08X, MD5 %s, SHA-1 %s, SHA-256 %s\n", File.szFileName, File.Digest.nSize, (unsigned int)File.Digest.crc32,
+			  DigestText(szMD5, File.Digest.MD5, 16), DigestText(szSHA1, File.Digest.SHA1, 20), DigestText(szSHA256, File.Digest.SHA256, 32));
+			break;
+		case StreamFrameRename:
+			if (File.fd>=0 || File.szFileName[0]=='\0' || !GetFileName(szNewPath, sizeof(szNewPath), pPayload, nLen, szNewName)) {
+				fprintf(stderr, "invalid rename frame\n");
+				return 0;
+			}
+			snprintf(szPath, sizeof(szPath), "%s/%s", szDirectory, File.szFileName);
+			if (rename(szPath, szNewPath)!=0) {
+				perror(szNewPath);
+				return 0;
+			}
+			printf("%s -> %s\n", File.szFileName, szNewName);
+			strcpy(File.szFileName, szNewName);
+			break;
+		case StreamFrameRemove:
+			if (File.fd>=0 || File.szFileName[0]=='\0') {
+				fprintf(stderr, "invalid remove frame\n");
+				return 0;
+			}
+			snprintf(szPath, sizeof(szPath), "%s/%s", szDirectory, File.szFileName);
+			unlink(szPath);
+			printf("%s removed\n", File.szFileName);
+			File.szFileName[0] = '\0';
+			break;
+		case StreamFrameEnd:
+			printf("cartridge done\n");
+			File.szFileName[0] = '\0';
+			break;
+		default:
+			fprintf(stderr, "unknown frame type %d\n", (int)nType);
+			return 0;
+	}
+	return 1;
+}
+
+// Frames of one dumper until end of stream, 0 on protocol errors
+int ReceiveStream(int fd) {
+	BYTE Header[STREAM_HEADER_SIZE];
+	BYTE* pPayload;
+	DWORD nSequence = 0, nLen;
+	int bFirst = 1, bOK = 1;
+
+	pPayload = malloc(STREAM_MAX_PAYLOAD);
+	if (!pPayload) {
+		return 0;
+	}
+	while (ReadAll(fd, Header, sizeof(Header))) {
+		if (memcmp(Header, "GBXF", 4)) {
+			fprintf(stderr, "frame magic missing\n");
+			bOK = 0;
+			break;
+		}
+		//the dumper counts over several connections
+		if (!bFirst && Get32(&Header[8]) != nSequence) {
+			fprintf(stderr, "frame %lu expected, got %lu\n", nSequence, Get32(&Header[8]));
+			bOK = 0;
+			break;
+		}
+		bFirst = 0;
+		nSequence = (Get32(&Header[8]) + 1) & 0xFFFFFFFF;
+		nLen = Get32(&Header[12]);
+		if (nLen>STREAM_MAX_PAYLOAD) {
+			fprintf(stderr, "frame %lu too large (%lu bytes)\n", nSequence-1, nLen);
+			bOK = 0;
+			break;
+		}
+		if (!ReadAll(fd, pPayload, nLen)) {
+			fprintf(stderr, "stream ends inside frame %lu\n", nSequence-1);
+			bOK = 0;
+			break;
+		}
+		if ((crc32(0, pPayload, nLen) & 0xFFFFFFFF) != Get32(&Header[16])) {
+			fprintf(stderr, "frame %lu CRC32 error\n", nSequence-1);
+			bOK = 0;
+			break;
+		}
+		if (!ReceiveFrame((StreamFrameType)Header[4], pPayload, nLen)) {
+			bOK = 0;
+			break;
+		}
+		fflush(stdout);
+	}
+	//file of an aborted dump is not valid
+	if (File.fd>=0) {
+		char szPath[PATH_MAX+256];
+
+		close(File.fd);
+		File.fd = -1;
+		snprintf(szPath, sizeof(szPath), "%s/%s", szDirectory, File.szFileName);
+		unlink(szPath);
+		fprintf(stderr, "%s incomplete, removed\n", File.szFileName);
+		bOK = 0;
+	}
+	File.szFileName[0] = '\0';
+	free(pPayload);
+	return bOK;
+}
+
+void print_usage() {
+	printf("Usage: gbxreceive [-u <socket path>] [directory]\n");
+	printf("  without -u frames are read from stdin\n");
+}
+
+int main(int argc, char* argv[]) {
+	char* szSocket = NULL;
+	struct sockaddr_un Addr;
+	int fd_Listen, fd;
+	int c;
+
+	while ((c = getopt(argc, argv, "u:")) != -1) {
+		switch (c) {
+			case 'u':
+				szSocket = optarg;
+				break;
+			default:
+				print_usage();
+				exit(EXIT_FAILURE);
+		}
+	}
+	if (optind < argc) {
+		snprintf(szDirectory, sizeof(szDirectory), "%s", argv[optind]);
+	}
+	if (!szSocket) {
+		exit(ReceiveStream(STDIN_FILENO) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	memset(&Addr, 0, sizeof(Addr));
+	Addr.sun_family = AF_UNIX;
+	strncpy(Addr.sun_path, szSocket, sizeof(Addr.sun_path)-1);
+	unlink(szSocket);
+	fd_Listen = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd_Listen<0 || bind(fd_Listen, (struct sockaddr*)&Addr, sizeof(Addr))!=0 || listen(fd_Listen, 1)!=0) {
+		perror(szSocket);
+		exit(EXIT_FAILURE);
+	}
+	printf("waiting for gbxdumper on '%s'\n", szSocket);
+	fflush(stdout);
+	for (;;) {
+		fd = accept(fd_Listen, NULL, NULL);
+		if (fd<0) {
+			if (errno==EINTR) {
+				continue;
+			}
+			perror("accept");
+			break;
+		}
+		if (!ReceiveStream(fd)) {
+			printf("connection dropped\n");
+		}
+		close(fd);
+		fflush(stdout);
+	}
+	close(fd_Listen);
+	return EXIT_FAILURE;
+}
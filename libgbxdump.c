@@ -0,0 +1,7420 @@
+// libgbxdump: GB(C) and GBA cartridge dump engines of GBxDumper (API in libgbxdump.h)
+// by Martin Strohmayer
+// Licence: CC BY-NC 3.0 (https://creativecommons.org/licenses/by-nc/3.0/)
+// Compile: gcc gbxdumper.c libgbxdump.c gbxdigest.c -o gbxdumper -Wall -lwiringPi -lz -lpthread
+//          (64 bit with SHA extensions, e.g. Pi 5: add -march=armv8-a+crypto)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <linux/fs.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <linux/gpio.h>
+#include <poll.h>
+#include <time.h>
+#include <ctype.h>
+#include <sys/time.h>
+#include <wiringPi.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <zlib.h>
+#include "libgbxdump.h"
+#include "gbxdigest.h"
+
+#define MAX_PATH 4096
+
+typedef unsigned long DWORD;
+typedef unsigned short WORD;
+typedef unsigned char BYTE;
+#define CBYTE const BYTE
+#define CWORD const WORD
+#define CDWORD const DWORD
+
+static volatile sig_atomic_t end = 0;
+
+enum CONTROLBIT{
+	CONTROL_WR  = 1,
+	CONTROL_RD  = 2,
+	CONTROL_CS  = 4,
+	CONTROL_CS2 = 8,
+};
+
+static CBYTE ControlByteDefault = 0x0F; //RD,WR,CS,CS2
+static BYTE ControlByte    = 0x0F;
+static CBYTE MCP_IOCON     = 0x0B; //IOCON.Bank 0
+static CBYTE MCP_Direction = 0x00;
+static CBYTE MCP_Write     = 0x14; //IOCON.Bank 0
+static CBYTE MCP_PullUp    = 0x0C; //IOCON.Bank 0
+static CBYTE MCP_Read      = 0x12; //IOCON.Bank 0
+static CBYTE MCP_PORTA     = 0x00; //IOCON.Bank 0
+static CBYTE MCP_PORTB     = 0x01; //IOCON.Bank 0
+
+/*
+CBYTE MCP_Direction_B1 = 0x00; //IOCON.Bank 1
+CBYTE MCP_Write_B1  = 0x0A; //IOCON.Bank 1
+CBYTE MCP_Read_B1   = 0x09; //IOCON.Bank 1
+CBYTE MCP_PORTA_B1  = 0x00; //IOCON.Bank 1
+CBYTE MCP_PORTB_B1  = 0x10; //IOCON.Bank 1
+CBYTE MCP_BANK0     = 0x00;
+CBYTE MCP_BANK1     = 0x80;
+*/
+
+static CBYTE MCP_OUTPUT    = 0x00;
+static CWORD MCP_WOUTPUT   = 0x0000;
+static CBYTE MCP_INPUT     = 0xFF;
+static CWORD MCP_WINPUT    = 0xFFFF;
+static CBYTE MCP_ON        = 0xFF;
+static CWORD MCP_WON       = 0xFFFF;
+
+static DWORD GBA_Low_Address_A_Mask = 0x000000FF; //24 Bit -> Bit 0-7
+static DWORD GBA_Low_Address_B_Mask = 0x0000FF00; //24 Bit -> Bit 8-15
+static DWORD GBA_Low_Address_Mask   = 0x0000FFFF; //24 Bit -> Bit 0-15
+static DWORD GBA_High_Address_Mask  = 0x00FF0000; //24 Bit -> Bit 16-23
+
+static const unsigned char revtable[] = {
+	0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+	0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+	0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8,
+	0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
+	0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4,
+	0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
+	0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec,
+	0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
+	0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2,
+	0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
+	0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea,
+	0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
+	0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6,
+	0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
+	0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee,
+	0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
+	0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1,
+	0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
+	0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9,
+	0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
+	0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5,
+	0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
+	0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed,
+	0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
+	0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3,
+	0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
+	0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb,
+	0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
+	0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7,
+	0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
+	0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef,
+	0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff,
+};
+
+
+static const unsigned char Logo[] = {
+	0x24, 0xFF, 0xAE, 0x51, 0x69, 0x9A, 0xA2, 0x21,
+	0x3D, 0x84, 0x82, 0x0A, 0x84, 0xE4, 0x09, 0xAD,
+	0x11, 0x24, 0x8B, 0x98, 0xC0, 0x81, 0x7F, 0x21,
+	0xA3, 0x52, 0xBE, 0x19, 0x93, 0x09, 0xCE, 0x20,
+	0x10, 0x46, 0x4A, 0x4A, 0xF8, 0x27, 0x31, 0xEC,
+	0x58, 0xC7, 0xE8, 0x33, 0x82, 0xE3, 0xCE, 0xBF,
+	0x85, 0xF4, 0xDF, 0x94, 0xCE, 0x4B, 0x09, 0xC1,
+	0x94, 0x56, 0x8A, 0xC0, 0x13, 0x72, 0xA7, 0xFC,
+	0x9F, 0x84, 0x4D, 0x73, 0xA3, 0xCA, 0x9A, 0x61,
+	0x58, 0x97, 0xA3, 0x27, 0xFC, 0x03, 0x98, 0x76,
+	0x23, 0x1D, 0xC7, 0x61, 0x03, 0x04, 0xAE, 0x56,
+	0xBF, 0x38, 0x84, 0x00, 0x40, 0xA7, 0x0E, 0xFD,
+	0xFF, 0x52, 0xFE, 0x03, 0x6F, 0x95, 0x30, 0xF1,
+	0x97, 0xFB, 0xC0, 0x85, 0x60, 0xD6, 0x80, 0x25,
+	0xA9, 0x63, 0xBE, 0x03, 0x01, 0x4E, 0x38, 0xE2,
+	0xF9, 0xA2, 0x34, 0xFF, 0xBB, 0x3E, 0x03, 0x44,
+	0x78, 0x00, 0x90, 0xCB, 0x88, 0x11, 0x3A, 0x94,
+	0x65, 0xC0, 0x7C, 0x63, 0x87, 0xF0, 0x3C, 0xAF,
+	0xD6, 0x25, 0xE4, 0x8B, 0x38, 0x0A, 0xAC, 0x72,
+	0x21, 0xD4, 0xF8, 0x07 
+};
+
+//GB(C) Nintendo logo at 0x0104
+static const unsigned char GBLogo[] = {
+	0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B,
+	0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+	0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E,
+	0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+	0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC,
+	0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E 
+};
+
+
+static DWORD CRC32(DWORD crc, BYTE* data, int nLen) {
+	BYTE BitCount;
+	unsigned int mask, nPosition;
+
+	for (nPosition=0; nPosition<nLen; nPosition++) {
+		crc = crc ^ data[nPosition];
+		for (BitCount=0; BitCount<=7; BitCount++) {
+			mask = -(crc & 1);
+			crc = (crc>>1)^(0xedb88320 & mask);
+		}
+	}
+	return(crc);
+}
+
+static DWORD CRC32_WORD(DWORD crc, WORD word) {
+	return CRC32(crc, (BYTE*) &word, sizeof(word));
+}
+
+
+//Settings (default), GBxSessionOpen copies them from struct GBxSettings
+static int LEDState = LOW;
+static int GPIO_SW = 16;
+static int GPIO_LED = 4;
+static int GPIO_RD = 26;
+static int bAutoAddressMode = 1;
+static int bRDviaGIOMode = 1;
+static int bVerify = 0;
+static int bLog = 0;
+static int I2CNo = 1;
+static unsigned int SlaveAddr_IC1 = 0x22;
+static unsigned int SlaveAddr_IC2 = 0x21;
+static int bAD0_7_swap = 0;
+static int bAD8_15_swap = 0;
+static int bAD16_23_swap = 0;
+static int bAD0_7_AD8_15_swap = 0;
+static DWORD Force_GBA_MaxAddress = 0;
+static DWORD AddrOffset = 0;
+static DWORD SpotCheckInterval = 0x4000; //words, 0 = off
+static const char* szLibraryDir = NULL;
+static const char* szArchiveDir = NULL;
+static int bGzip = 0;
+static const char* szFatImage = NULL;
+static char* GBARelaeseListBuffer = NULL;
+static int GBARelaeseListBufferSize = 0;
+static char szGameFileNameROM[16+4+3+1];
+static char szGameFileNameRAM[16+4+3+1];
+static int bCalibrate = 0;
+static const char* szProfileFile = NULL;
+static int bSelfTest = 0;
+static const char* szRanges = NULL;
+static int bTune = 0;
+static const char* szGPIOChip = NULL;
+static int VoteMajority = 2;
+static int VoteReads = 3;
+
+//Session of libgbxdump.h, one at a time
+static struct GBxSession* pGBxSession = NULL;
+static int bLocalFiles = 1;
+static int bLocalDumpFiles = 1;                  // dump files also on the SD card, not only in the FAT image
+
+static void GBxNotifyError(GBxError nError, const char* szMessage) {
+	if (pGBxSession && pGBxSession->Callbacks.Error) {
+		pGBxSession->Callbacks.Error(pGBxSession->pUser, nError, szMessage);
+	}
+}
+
+static void GBxReportError(GBxError nError, const char* szFormat, ...) {
+	char szMessage[256];
+	va_list args;
+
+	va_start(args, szFormat);
+	vsnprintf(szMessage, sizeof(szMessage), szFormat, args);
+	va_end(args);
+	printf("%s\n", szMessage);
+	GBxNotifyError(nError, szMessage);
+}
+
+//Board profile (option --profile), "key=value" per line
+static struct ProfileKeyStruct {
+	const char* szKey;
+	int* pnValue;                 // setting of the session (saved)
+	size_t nOffset;               // same setting in struct GBxSettings (loaded)
+	int bCommandLine;             // given as option, the profile does not overwrite it
+} ProfileKeys[] = {
+	{"swap_ad0_7",       &bAD0_7_swap,        offsetof(struct GBxSettings, bAD0_7_swap)},
+	{"swap_ad8_15",      &bAD8_15_swap,       offsetof(struct GBxSettings, bAD8_15_swap)},
+	{"swap_ad16_23",     &bAD16_23_swap,      offsetof(struct GBxSettings, bAD16_23_swap)},
+	{"swap_ad0_7_ad8_15", &bAD0_7_AD8_15_swap, offsetof(struct GBxSettings, bAD0_7_AD8_15_swap)},
+	{"auto_address",     &bAutoAddressMode,   offsetof(struct GBxSettings, bAutoAddressMode)},
+	{"verify",           &bVerify,            offsetof(struct GBxSettings, bVerify)},
+};
+
+void GBxProfileKeep(const char* szKey) {
+	int nKey;
+
+	for (nKey=0; nKey<sizeof(ProfileKeys)/sizeof(ProfileKeys[0]); nKey++) {
+		if (!strcmp(ProfileKeys[nKey].szKey, szKey)) {
+			ProfileKeys[nKey].bCommandLine = 1;
+		}
+	}
+}
+
+static int ProfileKept(const int* pnValue) {
+	int nKey;
+
+	for (nKey=0; nKey<sizeof(ProfileKeys)/sizeof(ProfileKeys[0]); nKey++) {
+		if (ProfileKeys[nKey].pnValue==pnValue) {
+			return ProfileKeys[nKey].bCommandLine;
+		}
+	}
+	return 0;
+}
+
+int GBxProfileLoad(struct GBxSettings* pSettings, const char* szFileName) {
+	FILE* fp;
+	char szLine[128];
+	int nKey;
+
+	fp = fopen(szFileName, "r");
+	if (!fp) {
+		return 0;
+	}
+	while (fgets(szLine, sizeof(szLine), fp)) {
+		char* pValue = strchr(szLine, '=');
+		if (szLine[0]=='#' || !pValue) continue;
+		*pValue++ = '\0';
+		for (nKey=0; nKey<sizeof(ProfileKeys)/sizeof(ProfileKeys[0]); nKey++) {
+			if (!strcmp(szLine, ProfileKeys[nKey].szKey)) {
+				if (!ProfileKeys[nKey].bCommandLine) {
+					*(int*)((char*)pSettings + ProfileKeys[nKey].nOffset) = atoi(pValue);
+				}
+				break;
+			}
+		}
+	}
+	fclose(fp);
+	return 1;
+}
+
+static int ProfileSave(const char* szFileName) {
+	FILE* fp;
+	int nKey;
+
+	fp = fopen(szFileName, "w");
+	if (!fp) {
+		perror("Could not create board profile");
+		return 0;
+	}
+	fprintf(fp, "# gbxdumper board profile\n");
+	for (nKey=0; nKey<sizeof(ProfileKeys)/sizeof(ProfileKeys[0]); nKey++) {
+		fprintf(fp, "%s=%d\n", ProfileKeys[nKey].szKey, *ProfileKeys[nKey].pnValue);
+	}
+	fclose(fp);
+	return 1;
+}
+
+// Write to a reader that may close its end (--json, --stream): EPIPE instead
+// of SIGPIPE, without changing the signal disposition of the host process.
+// Sockets get MSG_NOSIGNAL, for pipes SIGPIPE is blocked in this thread and
+// a SIGPIPE raised by the write is taken back.
+static ssize_t WritevNoSigPipe(int fd, struct iovec* pVector, int nVector) {
+	struct msghdr Message;
+	sigset_t Pipe, Old;
+	struct timespec Zero = {0, 0};
+	ssize_t nWritten;
+	int nError;
+
+	memset(&Message, 0, sizeof(Message));
+	Message.msg_iov = pVector;
+	Message.msg_iovlen = nVector;
+	nWritten = sendmsg(fd, &Message, MSG_NOSIGNAL);
+	if (nWritten>=0 || errno!=ENOTSOCK) {
+		return nWritten;
+	}
+	sigemptyset(&Pipe);
+	sigaddset(&Pipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &Pipe, &Old);
+	nWritten = writev(fd, pVector, nVector);
+	nError = errno;
+	if (nWritten<0 && EPIPE==nError && !sigismember(&Old, SIGPIPE)) {
+		while (sigtimedwait(&Pipe, NULL, &Zero)<0 && EINTR==errno);
+	}
+	pthread_sigmask(SIG_SETMASK, &Old, NULL);
+	errno = nError;
+	return nWritten;
+}
+
+//JSON-lines event stream (option --json)
+static int fd_JSON = -1;
+static int JSONRate_ms = 1000;
+static int bConsoleProgress = 1;
+static struct timeval tJSONLastProgress;
+
+int GBxJSONOpen(const char* szTarget) {
+	const char* pPos = szTarget;
+
+	while (isdigit((unsigned char)pPos[0])) {
+		pPos++;
+	}
+	if (szTarget[0]!='\0' && pPos[0]=='\0') {
+		fd_JSON = atoi(szTarget); //already open file descriptor
+	} else {
+		//regular file or FIFO (blocks until a reader opened the FIFO)
+		fd_JSON = open(szTarget, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	}
+	if (fd_JSON<0 || fcntl(fd_JSON, F_GETFD)<0) {
+		fprintf(stderr, "Failed to open JSON stream '%s' (%s)\n", szTarget, strerror(errno));
+		fd_JSON = -1;
+		return 0;
+	}
+	bConsoleProgress = 0;
+	return 1;
+}
+
+static void JSONEmit(const char* szFormat, ...) {
+	char szLine[1024];
+	int nLen, nAdd, nPos;
+	ssize_t nWritten;
+	va_list args;
+	struct timeval tNow;
+
+	if (fd_JSON<0) return;
+	gettimeofday(&tNow, 0);
+	nLen = snprintf(szLine, sizeof(szLine), "{\"ts\":%ld.%03ld,", (long)tNow.tv_sec, (long)tNow.tv_usec/1000);
+	va_start(args, szFormat);
+	nAdd = vsnprintf(&szLine[nLen], sizeof(szLine)-nLen-2, szFormat, args);
+	va_end(args);
+	if (nAdd<0) return;
+	if (nAdd >= (int)sizeof(szLine)-nLen-2) {
+		//a cut line is no valid JSON, report the drop instead
+		nAdd = snprintf(&szLine[nLen], sizeof(szLine)-nLen-2, "\"event\":\"error\",\"message\":\"event dropped, %d byte too long\"", nAdd);
+	}
+	nLen += nAdd;
+	szLine[nLen++] = '}';
+	szLine[nLen++] = '\n';
+	for (nPos=0; nPos<nLen; nPos+=nWritten) {
+		struct iovec Vector = {&szLine[nPos], nLen-nPos};
+
+		nWritten = WritevNoSigPipe(fd_JSON, &Vector, 1);
+		if (nWritten<0 && errno==EINTR) {
+			nWritten = 0;
+			continue;
+		}
+		if (nWritten<=0) {
+			if (errno==EPIPE) {
+				fprintf(stderr, "JSON stream reader closed, stream disabled\n");
+				close(fd_JSON);
+				fd_JSON = -1;
+			}
+			return;
+		}
+	}
+}
+
+static const char* JSONString(char* szDest, int nDestSize, const char* szSrc) {
+	int nPos = 0;
+
+	while (szSrc && szSrc[0]!='\0' && nPos<nDestSize-7) {
+		unsigned char cChar = (unsigned char)szSrc[0];
+		if (cChar=='"' || cChar=='\\') {
+			szDest[nPos++] = '\\';
+			szDest[nPos++] = cChar;
+		} else if (cChar<0x20 || cChar>=0x7F) {
+			nPos += sprintf(&szDest[nPos], "\\u%04x", (unsigned int)cChar);
+		} else {
+			szDest[nPos++] = cChar;
+		}
+		szSrc++;
+	}
+	szDest[nPos] = '\0';
+	return szDest;
+}
+
+static void JSONProgress(const char* szArtifact, const char* szUnit, DWORD nDone, DWORD nTotal, DWORD nRetries, const struct timeval* ptStart) {
+	struct timeval tNow;
+	double elapsedTime, fRate, fETA;
+
+	if (pGBxSession && pGBxSession->Callbacks.Progress) {
+		pGBxSession->Callbacks.Progress(pGBxSession->pUser, szArtifact, nDone, nTotal);
+	}
+	if (fd_JSON<0) return;
+	gettimeofday(&tNow, 0);
+	if ((tNow.tv_sec - tJSONLastProgress.tv_sec)*1000 + (tNow.tv_usec - tJSONLastProgress.tv_usec)/1000 < JSONRate_ms) {
+		return;
+	}
+	tJSONLastProgress = tNow;
+	elapsedTime = (tNow.tv_sec - ptStart->tv_sec)  + (tNow.tv_usec - ptStart->tv_usec)/1000000.0;
+	fRate = (elapsedTime>0) ? nDone/elapsedTime : 0;
+	fETA = (fRate>0 && nTotal>nDone) ? (nTotal-nDone)/fRate : 0;
+	JSONEmit("\"event\":\"progress\",\"artifact\":\"%s\",\"unit\":\"%s\",\"done\":%lu,\"total\":%lu,\"per_sec\":%.1f,\"eta_sec\":%.1f,\"retries\":%lu",
+	  szArtifact, szUnit, nDone, nTotal, fRate, fETA, nRetries);
+}
+
+static void JSONPhase(const char* szArtifact, const char* szPhase, double elapsedTime) {
+	JSONEmit("\"event\":\"phase\",\"artifact\":\"%s\",\"phase\":\"%s\",\"sec\":%.3f", szArtifact, szPhase, elapsedTime);
+}
+
+static void JSONResult(const char* szArtifact, const char* szFileName, DWORD nSize, DWORD crc, const char* szStatus, double elapsedTime, float fTimePerOperation) {
+	char szFile[64];
+
+	JSONEmit("\"event\":\"result\",\"artifact\":\"%s\",\"file\":\"%s\",\"size\":%lu,\"crc32\":\"%08X\",\"status\":\"%s\",\"sec\":%.3f,\"us_per_op\":%.1f",
+	  szArtifact, JSONString(szFile, sizeof(szFile), szFileName), nSize, (unsigned int)crc, szStatus, elapsedTime, fTimePerOperation);
+}
+
+
+//Station metrics, Prometheus textfile format (option --metrics)
+static const char* szMetricsFile = NULL;
+static unsigned long long nI2CTransactions = 0;
+static unsigned long long nI2CErrors = 0;
+static unsigned long long nI2CTransactionsReported = 0;
+static unsigned long long nI2CErrorsReported = 0;
+
+typedef enum {
+	MetricDumps = 0,
+	MetricBytes,
+	MetricPhaseSeconds,
+	MetricVerifyMismatches,
+	MetricCRCChecks,
+	MetricI2CTransactions,
+	MetricI2CErrors,
+	MetricOpsPerSecond,
+	MetricTimePerOperation,
+	MetricLastDump,
+	MetricCount,
+} MetricID;
+
+static const struct MetricDescStruct {
+	const char* szName;
+	const char* szType;
+	const char* szHelp;
+} MetricDesc[MetricCount] = {
+	{"gbxdumper_dumps_total",                  "counter", "Finished dumps by artifact and status"},
+	{"gbxdumper_bytes_total",                  "counter", "Bytes dumped by artifact"},
+	{"gbxdumper_phase_seconds_total",          "counter", "Time spent per artifact and phase"},
+	{"gbxdumper_verify_mismatches_total",      "counter", "Verify read mismatches by artifact"},
+	{"gbxdumper_crc_checks_total",             "counter", "ROM CRC32 checks against gbalist by result"},
+	{"gbxdumper_i2c_transactions_total",       "counter", "I2C read and write transactions"},
+	{"gbxdumper_i2c_errors_total",             "counter", "Failed I2C transactions"},
+	{"gbxdumper_operations_per_second",        "gauge",   "Throughput of the last dump by artifact (ROM words, RAM bytes, EEPROM bits)"},
+	{"gbxdumper_microseconds_per_operation",   "gauge",   "Time per operation of the last dump by artifact"},
+	{"gbxdumper_last_dump_timestamp_seconds",  "gauge",   "Unix time of the last finished dump by artifact"},
+};
+
+#define MAX_METRICS 128
+static struct MetricStruct {
+	MetricID nID;
+	char szLabels[64];
+	double fValue;
+} Metrics[MAX_METRICS];
+static int nMetrics = 0;
+
+static struct MetricStruct* MetricGet(MetricID nID, const char* szLabels) {
+	int nPos;
+
+	for (nPos=0; nPos<nMetrics; nPos++) {
+		if (Metrics[nPos].nID==nID && !strcmp(Metrics[nPos].szLabels, szLabels)) {
+			return &Metrics[nPos];
+		}
+	}
+	if (nMetrics>=MAX_METRICS) {
+		return NULL;
+	}
+	Metrics[nMetrics].nID = nID;
+	snprintf(Metrics[nMetrics].szLabels, sizeof(Metrics[nMetrics].szLabels), "%s", szLabels);
+	Metrics[nMetrics].fValue = 0;
+	return &Metrics[nMetrics++];
+}
+
+static void MetricAdd(MetricID nID, const char* szLabels, double fValue) {
+	struct MetricStruct* pMetric = MetricGet(nID, szLabels);
+	if (pMetric) pMetric->fValue += fValue;
+}
+
+static void MetricSet(MetricID nID, const char* szLabels, double fValue) {
+	struct MetricStruct* pMetric = MetricGet(nID, szLabels);
+	if (pMetric) pMetric->fValue = fValue;
+}
+
+//continue counting from the values of the previous run
+void GBxMetricsLoad(const struct GBxSettings* pSettings) {
+	FILE* fp;
+	char szLine[256];
+
+	szMetricsFile = pSettings->szMetricsFile;
+	if (!szMetricsFile || !(fp = fopen(szMetricsFile, "r"))) {
+		return;
+	}
+	while (fgets(szLine, sizeof(szLine), fp)) {
+		char* pLabels;
+		char* pValue;
+		char szNoLabels[1] = "";
+		int nID;
+
+		if (szLine[0]=='#') continue;
+		pValue = strrchr(szLine, ' ');
+		if (!pValue) continue;
+		*pValue++ = '\0';
+		pLabels = strchr(szLine, '{');
+		if (pLabels) {
+			*pLabels++ = '\0';
+			pLabels[strcspn(pLabels, "}")] = '\0';
+		} else {
+			pLabels = szNoLabels;
+		}
+		for (nID=0; nID<MetricCount; nID++) {
+			if (!strcmp(szLine, MetricDesc[nID].szName)) {
+				MetricSet((MetricID)nID, pLabels, strtod(pValue, NULL));
+				break;
+			}
+		}
+	}
+	fclose(fp);
+}
+
+//write to temporary file and rename, a scraper never sees a partial file
+static int MetricsWrite() {
+	char szTmpFile[PATH_MAX+1];
+	FILE* fp;
+	int nID, nPos;
+
+	if (!szMetricsFile) {
+		return 0;
+	}
+	MetricAdd(MetricI2CTransactions, "", nI2CTransactions-nI2CTransactionsReported);
+	MetricAdd(MetricI2CErrors, "", nI2CErrors-nI2CErrorsReported);
+	nI2CTransactionsReported = nI2CTransactions;
+	nI2CErrorsReported = nI2CErrors;
+	//all CRC check results from the first write on, a match series that stays 0 shows
+	MetricAdd(MetricCRCChecks, "result=\"match\"", 0);
+	MetricAdd(MetricCRCChecks, "result=\"mismatch\"", 0);
+	MetricAdd(MetricCRCChecks, "result=\"unlisted\"", 0);
+
+	snprintf(szTmpFile, sizeof(szTmpFile), "%s.tmp", szMetricsFile);
+	fp = fopen(szTmpFile, "w");
+	if (!fp) {
+		perror("Could not create metrics file");
+		return 0;
+	}
+	for (nID=0; nID<MetricCount; nID++) {
+		fprintf(fp, "# HELP %s %s\n", MetricDesc[nID].szName, MetricDesc[nID].szHelp);
+		fprintf(fp, "# TYPE %s %s\n", MetricDesc[nID].szName, MetricDesc[nID].szType);
+		for (nPos=0; nPos<nMetrics; nPos++) {
+			if (Metrics[nPos].nID!=nID) continue;
+			if (Metrics[nPos].szLabels[0]!='\0') {
+				fprintf(fp, "%s{%s} %.17g\n", MetricDesc[nID].szName, Metrics[nPos].szLabels, Metrics[nPos].fValue);
+			} else {
+				fprintf(fp, "%s %.17g\n", MetricDesc[nID].szName, Metrics[nPos].fValue);
+			}
+		}
+	}
+	fflush(fp);
+	fsync(fileno(fp));
+	if (fclose(fp)!=0 || rename(szTmpFile, szMetricsFile)!=0) {
+		perror("Could not write metrics file");
+		unlink(szTmpFile);
+		return 0;
+	}
+	return 1;
+}
+
+static void ReportPhase(const char* szArtifact, const char* szPhase, double elapsedTime) {
+	char szLabels[64];
+
+	JSONPhase(szArtifact, szPhase, elapsedTime);
+	snprintf(szLabels, sizeof(szLabels), "artifact=\"%s\",phase=\"%s\"", szArtifact, szPhase);
+	MetricAdd(MetricPhaseSeconds, szLabels, elapsedTime);
+}
+
+static void ReportResult(const char* szArtifact, const char* szFileName, DWORD nSize, DWORD crc, const char* szStatus, double elapsedTime, float fTimePerOperation, DWORD nRetries) {
+	char szLabels[64];
+
+	JSONResult(szArtifact, szFileName, nSize, crc, szStatus, elapsedTime, fTimePerOperation);
+	if (!strcmp(szStatus, "failed") || !strcmp(szStatus, "cancelled")) {
+		snprintf(szLabels, sizeof(szLabels), "%s dump %s", szArtifact, szStatus);
+		GBxNotifyError(strcmp(szStatus, "failed") ? GBxErrorCancelled : GBxErrorDump, szLabels);
+	}
+	snprintf(szLabels, sizeof(szLabels), "artifact=\"%s\",status=\"%s\"", szArtifact, szStatus);
+	MetricAdd(MetricDumps, szLabels, 1);
+	snprintf(szLabels, sizeof(szLabels), "artifact=\"%s\"", szArtifact);
+	MetricAdd(MetricBytes, szLabels, nSize);
+	MetricAdd(MetricVerifyMismatches, szLabels, nRetries);
+	if (fTimePerOperation>0) {
+		MetricSet(MetricOpsPerSecond, szLabels, 1000000.0/fTimePerOperation);
+		MetricSet(MetricTimePerOperation, szLabels, fTimePerOperation);
+	}
+	MetricSet(MetricLastDump, szLabels, (double)time(NULL));
+	if (!strcmp(szArtifact, "rom")) {
+		if (!strcmp(szStatus, "ok")) {
+			MetricAdd(MetricCRCChecks, "result=\"match\"", 1);
+		} else if (!strcmp(szStatus, "crc_mismatch")) {
+			MetricAdd(MetricCRCChecks, "result=\"mismatch\"", 1);
+		} else if (!strcmp(szStatus, "unverified")) {
+			MetricAdd(MetricCRCChecks, "result=\"unlisted\"", 1);
+		}
+	}
+}
+
+//###########################################################
+// Read quality: every pair of disagreeing reads (verify, spot check) is
+// XORed and the flipped bits are counted per data line, per address region
+// and per high address byte. A flaky data line shows as a column, a bad
+// address line as a region or a skewed address bit. Printed after each
+// cartridge, with --heatmap also written to a file. --diff fills the same
+// map from two dump files of one cartridge.
+
+#define QUALITY_REGIONS 16
+
+typedef enum {
+	QualityBusROM = 0,      // AD0-AD15, GBA ROM word address (EEPROM on AD0)
+	QualityBusByte,         // D0-D7, byte bus address (GBA SRAM/Flash, GB ROM/RAM)
+	QualityBusCount
+} QualityBus;
+
+static const struct QualityBusDescStruct {
+	const char* szName;
+	const char* szLine;
+	int nLines;
+	int nAddressBits;
+} QualityBusDesc[QualityBusCount] = {
+	{"rom",  "AD", 16, 24},
+	{"byte", "D",   8, 16},
+};
+
+static struct QualityStruct {
+	unsigned long long nCompared;
+	unsigned long long nMismatches;
+	unsigned long long LineFlips[16];
+	unsigned long long RegionFlips[QUALITY_REGIONS][16];
+	unsigned long long HighByteMismatches[256];
+	unsigned long long AddressBitSet[24];    // mismatches with the address bit high
+} Quality[QualityBusCount];
+
+static const char* szHeatmapFile = NULL;
+
+static void QualityReset() {
+	memset(Quality, 0, sizeof(Quality));
+}
+
+static void QualityAdd(QualityBus nBus, DWORD dwAddress, WORD wXor) {
+	const struct QualityBusDescStruct* pDesc = &QualityBusDesc[nBus];
+	struct QualityStruct* pQuality = &Quality[nBus];
+	int nRegion = (dwAddress >> (pDesc->nAddressBits-4)) & (QUALITY_REGIONS-1);
+	int nBit;
+
+	pQuality->nMismatches++;
+	pQuality->HighByteMismatches[(dwAddress >> (pDesc->nAddressBits-8)) & 0xFF]++;
+	for (nBit=0; nBit<pDesc->nLines; nBit++) {
+		if (wXor & (1<<nBit)) {
+			pQuality->LineFlips[nBit]++;
+			pQuality->RegionFlips[nRegion][nBit]++;
+		}
+	}
+	for (nBit=0; nBit<pDesc->nAddressBits; nBit++) {
+		if (dwAddress & (1UL<<nBit)) {
+			pQuality->AddressBitSet[nBit]++;
+		}
+	}
+}
+
+// Compare two reads of one address, 1 if they differ
+static int QualityCheck(QualityBus nBus, DWORD dwAddress, WORD wRead, WORD wRead2) {
+	Quality[nBus].nCompared++;
+	if (wRead==wRead2) {
+		return 0;
+	}
+	QualityAdd(nBus, dwAddress, wRead ^ wRead2);
+	return 1;
+}
+
+// '.' no flips, '1'..'9' relative to the largest count
+static char QualityHeat(unsigned long long nCount, unsigned long long nMax) {
+	if (!nCount || !nMax) {
+		return '.';
+	}
+	return '0' + (char)((9*nCount + nMax-1) / nMax);
+}
+
+static void QualityPrint(FILE* fp) {
+	int nBus, nRegion, nBit, nRow;
+
+	for (nBus=0; nBus<QualityBusCount; nBus++) {
+		const struct QualityBusDescStruct* pDesc = &QualityBusDesc[nBus];
+		struct QualityStruct* pQuality = &Quality[nBus];
+		unsigned long long nMax = 0, nLineMax = 0, nHighMax = 0;
+		char szRow[24+1];
+
+		if (!pQuality->nCompared) {
+			continue;
+		}
+		fprintf(fp, "read quality %s (%s0-%s%d): %llu reads compared, %llu mismatches\n", pDesc->szName,
+		  pDesc->szLine, pDesc->szLine, pDesc->nLines-1, pQuality->nCompared, pQuality->nMismatches);
+		if (!pQuality->nMismatches) {
+			continue;
+		}
+		for (nBit=0; nBit<pDesc->nLines; nBit++) {
+			if (pQuality->LineFlips[nBit]>nLineMax) nLineMax = pQuality->LineFlips[nBit];
+			for (nRegion=0; nRegion<QUALITY_REGIONS; nRegion++) {
+				if (pQuality->RegionFlips[nRegion][nBit]>nMax) nMax = pQuality->RegionFlips[nRegion][nBit];
+			}
+		}
+		//data lines MSB left, one row per region with flips
+		fprintf(fp, "  %-10s", "region");
+		for (nBit=pDesc->nLines-1; nBit>=0; nBit--) {
+			fputc("0123456789ABCDEF"[nBit], fp);
+		}
+		fprintf(fp, "  (%s%d..%s0)\n", pDesc->szLine, pDesc->nLines-1, pDesc->szLine);
+		for (nRegion=0; nRegion<QUALITY_REGIONS; nRegion++) {
+			int bFlips = 0;
+
+			for (nBit=pDesc->nLines-1; nBit>=0; nBit--) {
+				szRow[pDesc->nLines-1-nBit] = QualityHeat(pQuality->RegionFlips[nRegion][nBit], nMax);
+				bFlips |= pQuality->RegionFlips[nRegion][nBit]!=0;
+			}
+			szRow[pDesc->nLines] = '\0';
+			if (bFlips) {
+				char szRegion[16];
+
+				snprintf(szRegion, sizeof(szRegion), "0x%0*lX", pDesc->nAddressBits/4, (DWORD)nRegion << (pDesc->nAddressBits-4));
+				fprintf(fp, "  %-10s%s\n", szRegion, szRow);
+			}
+		}
+		for (nBit=pDesc->nLines-1; nBit>=0; nBit--) {
+			szRow[pDesc->nLines-1-nBit] = QualityHeat(pQuality->LineFlips[nBit], nLineMax);
+		}
+		fprintf(fp, "  %-10s%s\n", "all", szRow);
+		fprintf(fp, "  %-9s", "flips");
+		for (nBit=pDesc->nLines-1; nBit>=0; nBit--) {
+			if (pQuality->LineFlips[nBit]) {
+				fprintf(fp, " %s%d=%llu", pDesc->szLine, nBit, pQuality->LineFlips[nBit]);
+			}
+		}
+		//about 5 for noise, 0 or 9 if the mismatches follow an address line
+		fprintf(fp, "\n  %-10s", "A-bit set");
+		for (nBit=pDesc->nAddressBits-1; nBit>=0; nBit--) {
+			szRow[pDesc->nAddressBits-1-nBit] = '0' + (char)(9*pQuality->AddressBitSet[nBit] / pQuality->nMismatches);
+		}
+		szRow[pDesc->nAddressBits] = '\0';
+		fprintf(fp, "%s  (A%d..A0)\n", szRow, pDesc->nAddressBits-1);
+		//high address byte, 16 per row
+		for (nRow=0; nRow<256; nRow++) {
+			if (pQuality->HighByteMismatches[nRow]>nHighMax) nHighMax = pQuality->HighByteMismatches[nRow];
+		}
+		fprintf(fp, "  high byte 0123456789ABCDEF  (A%d..A%d)\n", pDesc->nAddressBits-1, pDesc->nAddressBits-8);
+		for (nRow=0; nRow<16; nRow++) {
+			int bFlips = 0;
+
+			for (nBit=0; nBit<16; nBit++) {
+				szRow[nBit] = QualityHeat(pQuality->HighByteMismatches[nRow*16+nBit], nHighMax);
+				bFlips |= pQuality->HighByteMismatches[nRow*16+nBit]!=0;
+			}
+			szRow[16] = '\0';
+			if (bFlips) {
+				fprintf(fp, "  0x%02X      %s\n", nRow*16, szRow);
+			}
+		}
+	}
+}
+
+// After each cartridge: console, JSON and --heatmap file
+static void QualityReport() {
+	char szTmpFile[PATH_MAX+1];
+	FILE* fp;
+	int nBus;
+
+	QualityPrint(stdout);
+	for (nBus=0; nBus<QualityBusCount; nBus++) {
+		if (Quality[nBus].nCompared) {
+			JSONEmit("\"event\":\"quality\",\"bus\":\"%s\",\"compared\":%llu,\"mismatches\":%llu",
+			  QualityBusDesc[nBus].szName, Quality[nBus].nCompared, Quality[nBus].nMismatches);
+		}
+	}
+	if (!szHeatmapFile) {
+		return;
+	}
+	snprintf(szTmpFile, sizeof(szTmpFile), "%s.tmp", szHeatmapFile);
+	fp = fopen(szTmpFile, "w");
+	if (!fp) {
+		perror("Could not create heatmap file");
+		return;
+	}
+	QualityPrint(fp);
+	if (fclose(fp)!=0 || rename(szTmpFile, szHeatmapFile)!=0) {
+		perror("Could not write heatmap file");
+		unlink(szTmpFile);
+	}
+}
+
+typedef enum {
+	QualityFileGBA = 0,       // .gba ROM, GBA save
+	QualityFileGBROM,         // .gb, .gbc
+	QualityFileGBSave         // .sav next to a .gb/.gbc dump
+} QualityFileType;
+
+// Bus address of a file offset: .gba ROM words, .gb/.gbc ROM banks at
+// 0x4000, GB(C) saves 8 KiB banks at 0xA000, GBA saves 64 KiB banks
+static DWORD QualityFileAddress(QualityBus nBus, QualityFileType nType, DWORD nOffset) {
+	if (QualityBusROM==nBus) {
+		return nOffset/2;
+	}
+	if (QualityFileGBROM==nType && nOffset>=0x4000) {
+		return 0x4000 | (nOffset & 0x3FFF);
+	}
+	if (QualityFileGBSave==nType) {
+		return 0xA000 | (nOffset & 0x1FFF);
+	}
+	return nOffset & 0xFFFF;
+}
+
+// Type of a dump by the extension of its base name, a trailing .gz is
+// skipped. A .sav is a GB(C) save if the ROM dump lies next to it.
+static QualityFileType QualityFileTypeOf(const char* szFileName, QualityBus* pnBus) {
+	const char* cszGBROM[] = {".gb", ".gbc", ".gb.gz", ".gbc.gz"};
+	char szStem[PATH_MAX+1];
+	char szROM[PATH_MAX+8+1];
+	char* pBase;
+	char* pExtension;
+	size_t nLen;
+	int nROM;
+
+	snprintf(szStem, sizeof(szStem), "%s", szFileName);
+	pBase = strrchr(szStem, '/');
+	pBase = pBase ? pBase+1 : szStem;
+	nLen = strlen(pBase);
+	if (nLen>3 && !strcasecmp(&pBase[nLen-3], ".gz")) {
+		pBase[nLen-3] = '\0';
+	}
+	*pnBus = QualityBusByte;
+	pExtension = strrchr(pBase, '.');
+	if (!pExtension || pExtension==pBase) {
+		return QualityFileGBA;
+	}
+	if (!strcasecmp(pExtension, ".gba")) {
+		*pnBus = QualityBusROM;
+		return QualityFileGBA;
+	}
+	if (!strcasecmp(pExtension, ".gb") || !strcasecmp(pExtension, ".gbc")) {
+		return QualityFileGBROM;
+	}
+	if (!strcasecmp(pExtension, ".sav")) {
+		pExtension[0] = '\0';
+		for (nROM=0; nROM<(int)(sizeof(cszGBROM)/sizeof(cszGBROM[0])); nROM++) {
+			snprintf(szROM, sizeof(szROM), "%s%s", szStem, cszGBROM[nROM]);
+			if (0==access(szROM, F_OK)) {
+				return QualityFileGBSave;
+			}
+		}
+	}
+	return QualityFileGBA;
+}
+
+#define QUALITY_DIFF_BLOCK 0x10000
+typedef BYTE QualityVector __attribute__((vector_size(16)));
+
+// Offline: XOR two dumps of the same cartridge (plain or gzip) 16 bytes at
+// a time (NEON/SSE2 through the compiler), only differing vectors are
+// looked at per word. EXIT_SUCCESS if the files are equal.
+int GBxQualityDiff(const struct GBxSettings* pSettings, const char* szFileName1, const char* szFileName2) {
+	QualityBus nBus;
+	QualityFileType nType;
+	gzFile gzFile1, gzFile2;
+	BYTE* pBuffer1;
+	BYTE* pBuffer2;
+	DWORD nOffset = 0;
+	int nRead1, nRead2 = 0, nPos, nStep;
+	int bSizeDiffers = 0;
+
+	szHeatmapFile = pSettings->szHeatmapFile;
+	nType = QualityFileTypeOf(szFileName1, &nBus);
+	nStep = QualityBusROM==nBus ? 2 : 1;
+
+	gzFile1 = gzopen(szFileName1, "rb");
+	gzFile2 = gzopen(szFileName2, "rb");
+	pBuffer1 = malloc(QUALITY_DIFF_BLOCK);
+	pBuffer2 = malloc(QUALITY_DIFF_BLOCK);
+	if (!gzFile1 || !gzFile2 || !pBuffer1 || !pBuffer2) {
+		perror(!gzFile1 ? szFileName1 : szFileName2);
+		if (gzFile1) gzclose(gzFile1);
+		if (gzFile2) gzclose(gzFile2);
+		free(pBuffer1);
+		free(pBuffer2);
+		return EXIT_FAILURE;
+	}
+	QualityReset();
+	printf("diff '%s' '%s' as %s bus\n", szFileName1, szFileName2, QualityBusDesc[nBus].szName);
+	for (;;) {
+		nRead1 = gzread(gzFile1, pBuffer1, QUALITY_DIFF_BLOCK);
+		nRead2 = gzread(gzFile2, pBuffer2, QUALITY_DIFF_BLOCK);
+		if (nRead1<=0 || nRead2<=0) {
+			break;
+		}
+		if (nRead1!=nRead2) {
+			bSizeDiffers = 1;
+			nRead1 = nRead1<nRead2 ? nRead1 : nRead2;
+		}
+		nRead1 &= ~(nStep-1);
+		for (nPos=0; nPos<nRead1; nPos+=sizeof(QualityVector)) {
+			QualityVector Data1, Data2;
+			unsigned long long Lanes[2];
+			int nWord, nEnd;
+
+			if (nPos+(int)sizeof(QualityVector)<=nRead1) {
+				memcpy(&Data1, &pBuffer1[nPos], sizeof(Data1));
+				memcpy(&Data2, &pBuffer2[nPos], sizeof(Data2));
+				Data1 ^= Data2;
+				memcpy(Lanes, &Data1, sizeof(Lanes));
+				if (!(Lanes[0] | Lanes[1])) {
+					continue;
+				}
+				nEnd = nPos+sizeof(QualityVector);
+			} else {
+				nEnd = nRead1;
+			}
+			for (nWord=nPos; nWord<nEnd; nWord+=nStep) {
+				WORD wXor = pBuffer1[nWord] ^ pBuffer2[nWord];
+
+				if (2==nStep) {
+					wXor |= (pBuffer1[nWord+1] ^ pBuffer2[nWord+1]) << 8;
+				}
+				if (wXor) {
+					QualityAdd(nBus, QualityFileAddress(nBus, nType, nOffset+nWord), wXor);
+				}
+			}
+		}
+		Quality[nBus].nCompared += nRead1/nStep;
+		nOffset += nRead1;
+	}
+	if (nRead1<0 || nRead2<0) {
+		printf("read error after %lu bytes\n", nOffset);
+	} else if (bSizeDiffers || nRead1>0 || nRead2>0) {
+		printf("files differ in size, compared the first %lu bytes\n", nOffset);
+		bSizeDiffers = 1;
+	}
+	gzclose(gzFile1);
+	gzclose(gzFile2);
+	free(pBuffer1);
+	free(pBuffer2);
+	QualityReport();
+	return (Quality[nBus].nMismatches || bSizeDiffers || nRead1<0 || nRead2<0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//###########################################################
+// Retry policy: two reads of one address that differ are decided by voting,
+// up to VoteReads reads until VoteMajority of them agree (option --vote,
+// default 2 of 3). If no value gets the majority the bitwise majority of
+// all reads is used. GBA ROM regions (128 KiB) with repeated spot check
+// failures fall back to explicit addressing with verify, the rest of the
+// cartridge keeps the fast auto address mode.
+// Option f still reads every word twice: a spot check sees one word per
+// interval, single bit flips of a weak contact fall between two checks and
+// a GBA cartridge has no per-block checksum to compare with.
+
+#define VOTE_READS_MAX 15
+#define RETRY_REGIONS 0x100             // 64 Ki words each
+#define RETRY_REGION_ERRORS 2           // spot check failures until fallback
+
+struct VoteStruct {
+	WORD wReads[VOTE_READS_MAX];
+	int nReads;
+};
+
+static BYTE RetryRegionErrors[RETRY_REGIONS];
+
+// "<n>/<m>": n of m reads have to agree
+int GBxVoteSet(struct GBxSettings* pSettings, const char* szVote) {
+	int nMajority, nReads;
+
+	if (2 != sscanf(szVote, "%d/%d", &nMajority, &nReads) || nReads<3 || nReads>VOTE_READS_MAX || 2*nMajority<=nReads || nMajority>nReads) {
+		return 0;
+	}
+	pSettings->VoteMajority = nMajority;
+	pSettings->VoteReads = nReads;
+	return 1;
+}
+
+static void VoteInit(struct VoteStruct* pVote, WORD wRead, WORD wRead2) {
+	pVote->wReads[0] = wRead;
+	pVote->wReads[1] = wRead2;
+	pVote->nReads = 2;
+}
+
+static void VoteAdd(struct VoteStruct* pVote, WORD wRead) {
+	if (pVote->nReads < VOTE_READS_MAX) {
+		pVote->wReads[pVote->nReads++] = wRead;
+	}
+}
+
+// 1 if decided: a value has the majority or all reads are done
+static int VoteResult(const struct VoteStruct* pVote, WORD* pwResult) {
+	int nRead, nOther, nSame, nBit, nOnes;
+
+	for (nRead=0; nRead<pVote->nReads; nRead++) {
+		nSame = 0;
+		for (nOther=0; nOther<pVote->nReads; nOther++) {
+			nSame += pVote->wReads[nOther] == pVote->wReads[nRead];
+		}
+		if (nSame >= VoteMajority) {
+			*pwResult = pVote->wReads[nRead];
+			return 1;
+		}
+	}
+	if (pVote->nReads < VoteReads) {
+		return 0;
+	}
+	*pwResult = 0;
+	for (nBit=0; nBit<16; nBit++) {
+		nOnes = 0;
+		for (nRead=0; nRead<pVote->nReads; nRead++) {
+			nOnes += (pVote->wReads[nRead] >> nBit) & 1;
+		}
+		if (2*nOnes > pVote->nReads) {
+			*pwResult |= 1 << nBit;
+		}
+	}
+	return 1;
+}
+
+static void RetryRegionReset(void) {
+	memset(RetryRegionErrors, 0, sizeof(RetryRegionErrors));
+}
+
+// Region of the ROM word address read with explicit addressing and verify
+static int RetryRegionExplicit(DWORD dwAddress) {
+	return RetryRegionErrors[(dwAddress >> 16) % RETRY_REGIONS] >= RETRY_REGION_ERRORS;
+}
+
+// Spot check failure between dwGoodAddress and dwAddress
+static void RetryRegionError(DWORD dwGoodAddress, DWORD dwAddress) {
+	DWORD dwRegion;
+
+	for (dwRegion=dwGoodAddress>>16; dwRegion<=dwAddress>>16 && dwRegion<RETRY_REGIONS; dwRegion++) {
+		if (RetryRegionErrors[dwRegion] < RETRY_REGION_ERRORS && ++RetryRegionErrors[dwRegion] == RETRY_REGION_ERRORS) {
+			printf("\n-> region 0x%06lX-0x%06lX: explicit addressing with verify", dwRegion<<17, ((dwRegion+1)<<17)-1);
+			JSONEmit("\"event\":\"retry_fallback\",\"start\":%lu,\"end\":%lu", dwRegion<<17, ((dwRegion+1)<<17)-1);
+		}
+	}
+}
+
+//###########################################################
+// Dump archive (option --archive): dumps are cut into 64 KiB chunks, every
+// distinct chunk is stored once as <dir>/chunks/<xx>/<sha256>, a manifest
+// per dump lists its chunks. Known chunks (padding, re-dumps, variants)
+// cost no write on the SD card.
+
+#define ARCHIVE_CHUNK_SIZE 0x10000
+#define ARCHIVE_MAX_CHUNKS (0x2000000/ARCHIVE_CHUNK_SIZE) //32 MiB
+
+static struct ArchiveStruct {
+	int bActive;
+	BYTE Chunk[ARCHIVE_CHUNK_SIZE];
+	size_t nChunk;                              // bytes in Chunk
+	char Hashes[ARCHIVE_MAX_CHUNKS][64+1];
+	int nChunks;
+	int nNewChunks;
+	DWORD nSize;
+	DWORD crc;
+} Archive;
+
+static void ArchiveMakeDir(const char* szPath) {
+	if (mkdir(szPath, 0755)!=0 && errno!=EEXIST) {
+		perror(szPath);
+	}
+}
+
+static int ArchiveBegin() {
+	char szPath[PATH_MAX+1];
+
+	Archive.bActive = 0;
+	if (!szArchiveDir) {
+		return 0;
+	}
+	ArchiveMakeDir(szArchiveDir);
+	snprintf(szPath, sizeof(szPath), "%s/chunks", szArchiveDir);
+	ArchiveMakeDir(szPath);
+	snprintf(szPath, sizeof(szPath), "%s/manifests", szArchiveDir);
+	ArchiveMakeDir(szPath);
+	Archive.nChunk = 0;
+	Archive.nChunks = 0;
+	Archive.nNewChunks = 0;
+	Archive.nSize = 0;
+	Archive.crc = 0xFFFFFFFF;
+	Archive.bActive = 1;
+	return 1;
+}
+
+static int ArchiveStoreChunk() {
+	struct SHA256Struct SHA;
+	BYTE Digest[32];
+	char szPath[PATH_MAX+1];
+	char szTmpFile[PATH_MAX+4+1];
+	char* szHash;
+	struct stat Stat;
+	size_t nLen = Archive.nChunk;
+	FILE* fp;
+
+	if (Archive.nChunks>=ARCHIVE_MAX_CHUNKS) {
+		printf("archive: dump larger than %d MiB\n", ARCHIVE_MAX_CHUNKS*ARCHIVE_CHUNK_SIZE/1024/1024);
+		return 0;
+	}
+	SHA256Init(&SHA);
+	SHA256Update(&SHA, Archive.Chunk, nLen);
+	SHA256Final(&SHA, Digest);
+	szHash = DigestText(Archive.Hashes[Archive.nChunks], Digest, sizeof(Digest));
+	Archive.nChunks++;
+	Archive.nChunk = 0;
+
+	snprintf(szPath, sizeof(szPath), "%s/chunks/%.2s", szArchiveDir, szHash);
+	ArchiveMakeDir(szPath);
+	snprintf(szPath, sizeof(szPath), "%s/chunks/%.2s/%s", szArchiveDir, szHash, szHash);
+	if (0==stat(szPath, &Stat)) {
+		return 1;
+	}
+	snprintf(szTmpFile, sizeof(szTmpFile), "%s.tmp", szPath);
+	fp = fopen(szTmpFile, "wb");
+	if (!fp) {
+		perror("Could not create archive chunk");
+		return 0;
+	}
+	if (1!=fwrite(Archive.Chunk, nLen, 1, fp) || fflush(fp)!=0 || fsync(fileno(fp))!=0 || fclose(fp)!=0 || rename(szTmpFile, szPath)!=0) {
+		perror("Could not write archive chunk");
+		unlink(szTmpFile);
+		return 0;
+	}
+	Archive.nNewChunks++;
+	return 1;
+}
+
+static int ArchiveWrite(const BYTE* pData, size_t nLen) {
+	size_t nCopy;
+
+	while (Archive.bActive && nLen) {
+		nCopy = ARCHIVE_CHUNK_SIZE-Archive.nChunk;
+		if (nCopy>nLen) {
+			nCopy = nLen;
+		}
+		memcpy(&Archive.Chunk[Archive.nChunk], pData, nCopy);
+		Archive.crc = CRC32(Archive.crc, (BYTE*)pData, nCopy);
+		Archive.nChunk += nCopy;
+		Archive.nSize += nCopy;
+		pData += nCopy;
+		nLen -= nCopy;
+		if (ARCHIVE_CHUNK_SIZE==Archive.nChunk && !ArchiveStoreChunk()) {
+			Archive.bActive = 0;
+		}
+	}
+	return Archive.bActive;
+}
+
+// Compressed dumps (--gzip) are archived with their content, so the
+// manifest names the file without the .gz suffix
+static int ArchiveEnd(const char* szDumpName) {
+	char szManifest[PATH_MAX+1];
+	char szTmpFile[PATH_MAX+4+1];
+	char szJSONFile[MAX_PATH+1];
+	char szFileName[64];
+	size_t nLen;
+	FILE* fp;
+	int nPos;
+
+	if (!Archive.bActive) {
+		return 0;
+	}
+	snprintf(szFileName, sizeof(szFileName), "%s", szDumpName);
+	nLen = strlen(szFileName);
+	if (nLen>3 && !strcmp(&szFileName[nLen-3], ".gz")) {
+		szFileName[nLen-3] = '\0';
+	}
+	Archive.bActive = 0;
+	if (Archive.nChunk && !ArchiveStoreChunk()) {
+		return 0;
+	}
+	Archive.crc ^= 0xFFFFFFFF;
+	snprintf(szManifest, sizeof(szManifest), "%s/manifests/%s.%08X.manifest", szArchiveDir, szFileName, (unsigned int)Archive.crc);
+	snprintf(szTmpFile, sizeof(szTmpFile), "%s.tmp", szManifest);
+	fp = fopen(szTmpFile, "w");
+	if (!fp) {
+		perror("Could not create archive manifest");
+		return 0;
+	}
+	fprintf(fp, "# gbxdumper archive manifest\n");
+	fprintf(fp, "file=%s\n", szFileName);
+	fprintf(fp, "size=%lu\n", Archive.nSize);
+	fprintf(fp, "crc32=%08X\n", (unsigned int)Archive.crc);
+	fprintf(fp, "chunk_size=%d\n", ARCHIVE_CHUNK_SIZE);
+	for (nPos=0; nPos<Archive.nChunks; nPos++) {
+		fprintf(fp, "chunk=%s\n", Archive.Hashes[nPos]);
+	}
+	fflush(fp);
+	fsync(fileno(fp));
+	if (fclose(fp)!=0 || rename(szTmpFile, szManifest)!=0) {
+		perror("Could not write archive manifest");
+		unlink(szTmpFile);
+		return 0;
+	}
+	printf("archived '%s' (%d chunks, %d new)\n", szFileName, Archive.nChunks, Archive.nNewChunks);
+	JSONEmit("\"event\":\"archive\",\"file\":\"%s\",\"size\":%lu,\"crc32\":\"%08X\",\"chunks\":%d,\"new_chunks\":%d",
+	  JSONString(szJSONFile, sizeof(szJSONFile), szFileName), Archive.nSize, (unsigned int)Archive.crc, Archive.nChunks, Archive.nNewChunks);
+	return 1;
+}
+
+static int ArchiveFile(const char* szFileName) {
+	BYTE Buffer[0x1000];
+	gzFile gz;
+	int nRead;
+
+	if (!ArchiveBegin()) {
+		return 0;
+	}
+	// gzopen reads uncompressed files as they are
+	gz = gzopen(szFileName, "rb");
+	if (!gz) {
+		Archive.bActive = 0;
+		return 0;
+	}
+	while ((nRead = gzread(gz, Buffer, sizeof(Buffer))) > 0) {
+		ArchiveWrite(Buffer, nRead);
+	}
+	if (nRead<0) {
+		Archive.bActive = 0;
+	}
+	gzclose(gz);
+	return ArchiveEnd(szFileName);
+}
+
+// Rebuild a dump from its manifest (option --extract), every chunk is
+// checked against its SHA-256, the file against size and CRC32
+int GBxArchiveExtract(const struct GBxSettings* pSettings, const char* szManifest) {
+	char szLine[128];
+	char szFileName[MAX_PATH+1];
+	char szTmpFile[MAX_PATH+8];
+	char szPath[PATH_MAX+1];
+	char szHash[64+1];
+	DWORD nSize = 0, nWritten = 0, crcManifest = 0, crc = 0xFFFFFFFF;
+	struct SHA256Struct SHA;
+	BYTE Digest[32];
+	FILE* fp;
+	FILE* fpOut = NULL;
+	FILE* fpChunk;
+	size_t nRead;
+	int bOK = 1;
+
+	szArchiveDir = pSettings->szArchiveDir;
+	fp = fopen(szManifest, "r");
+	if (!fp) {
+		perror(szManifest);
+		return EXIT_FAILURE;
+	}
+	szFileName[0] = '\0';
+	while (bOK && fgets(szLine, sizeof(szLine), fp)) {
+		char* pValue = strchr(szLine, '=');
+		if (szLine[0]=='#' || !pValue) continue;
+		*pValue++ = '\0';
+		pValue[strcspn(pValue, "\r\n")] = '\0';
+		if (!strcmp(szLine, "file")) {
+			strncpy(szFileName, pValue, MAX_PATH);
+			szFileName[MAX_PATH] = '\0';
+		} else if (!strcmp(szLine, "size")) {
+			nSize = strtoul(pValue, NULL, 10);
+		} else if (!strcmp(szLine, "crc32")) {
+			crcManifest = strtoul(pValue, NULL, 16);
+		} else if (!strcmp(szLine, "chunk")) {
+			if (!fpOut) {
+				if (szFileName[0]=='\0' || strchr(szFileName, '/')) {
+					printf("manifest without valid file name\n");
+					bOK = 0;
+					break;
+				}
+				snprintf(szTmpFile, sizeof(szTmpFile), "%s.tmp", szFileName);
+				fpOut = fopen(szTmpFile, "wb");
+				if (!fpOut) {
+					perror(szTmpFile);
+					bOK = 0;
+					break;
+				}
+			}
+			strncpy(szHash, pValue, 64);
+			szHash[64] = '\0';
+			snprintf(szPath, sizeof(szPath), "%s/chunks/%.2s/%s", szArchiveDir, szHash, szHash);
+			fpChunk = fopen(szPath, "rb");
+			if (!fpChunk) {
+				printf("chunk %s missing\n", szHash);
+				bOK = 0;
+				break;
+			}
+			nRead = fread(Archive.Chunk, 1, ARCHIVE_CHUNK_SIZE, fpChunk);
+			fclose(fpChunk);
+			SHA256Init(&SHA);
+			SHA256Update(&SHA, Archive.Chunk, nRead);
+			SHA256Final(&SHA, Digest);
+			if (strcmp(DigestText(szPath, Digest, sizeof(Digest)), szHash)) {
+				printf("chunk %s damaged\n", szHash);
+				bOK = 0;
+				break;
+			}
+			crc = CRC32(crc, Archive.Chunk, nRead);
+			if (nRead!=fwrite(Archive.Chunk, 1, nRead, fpOut)) {
+				perror(szTmpFile);
+				bOK = 0;
+			}
+			nWritten += nRead;
+		}
+	}
+	fclose(fp);
+	crc ^= 0xFFFFFFFF;
+	if (fpOut) {
+		if (fclose(fpOut)!=0) {
+			bOK = 0;
+		}
+		if (bOK && (nWritten!=nSize || crc!=crcManifest)) {
+			printf("extracted size %lu or CRC32 %08X does not match manifest\n", nWritten, (unsigned int)crc);
+			bOK = 0;
+		}
+		if (bOK && rename(szTmpFile, szFileName)!=0) {
+			perror(szFileName);
+			bOK = 0;
+		}
+		if (!bOK) {
+			unlink(szTmpFile);
+		}
+	} else {
+		bOK = 0;
+	}
+	if (bOK) {
+		printf("extracted '%s' (%lu bytes, CRC32 %08X)\n", szFileName, nWritten, (unsigned int)crc);
+	}
+	return bOK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//###########################################################
+// FAT32 image (option --fat-image): the USB mass storage gadget exports
+// the ramdisk (or a backing file) directly. For every cartridge the image
+// gets a new MBR and FAT32 file system, each dump file streams into
+// contiguous clusters while it is read, FAT chain and directory entry are
+// written when the file is complete under its final name.
+
+#define FAT_SECTOR 512
+#define FAT_PART_START 2048              // sectors, like fdisk
+#define FAT_RESERVED 32
+#define FAT_ROOT_CLUSTERS 8
+#define FAT_MAX_FILES 8
+#define FAT_MIN_CLUSTERS 65525
+#define FAT_MAX_CLUSTERS 0x3FFFFF
+#define FAT_DEFAULT_SIZE (48*1024*1024)  // new image file, ramdisk_size=49152
+#define FAT_EOC 0x0FFFFFFF
+
+struct FatFileEntryStruct {
+	char szName[64];
+	DWORD nCluster;
+	DWORD nSize;
+	time_t tTime;
+};
+
+static struct FatImageStruct {
+	int fd;
+	int bFormatted;
+	DWORD nPartSectors;
+	DWORD nSectorsPerCluster;
+	DWORD nClusterSize;                   // bytes
+	DWORD nFATSectors;
+	DWORD nClusters;
+	DWORD nNextCluster;                   // first free cluster
+	off_t nFATOffset;                     // bytes, first FAT
+	off_t nDataOffset;                    // bytes, cluster 2
+	struct FatFileEntryStruct Files[FAT_MAX_FILES];
+	int nFiles;
+	int bStreaming, bStreamError;         // file not yet in the directory
+	DWORD nStreamCluster;
+	DWORD nStreamSize;
+} FatImage = { .fd = -1 };
+
+static void FatPut16(BYTE* p, unsigned int nValue) {
+	p[0] = nValue & 0xFF;
+	p[1] = (nValue >> 8) & 0xFF;
+}
+
+static void FatPut32(BYTE* p, DWORD nValue) {
+	FatPut16(p, nValue & 0xFFFF);
+	FatPut16(p+2, (nValue >> 16) & 0xFFFF);
+}
+
+static int FatWrite(off_t nOffset, const void* pData, size_t nLen) {
+	const BYTE* pSrc = (const BYTE*)pData;
+	ssize_t nWritten;
+
+	while (nLen) {
+		nWritten = pwrite(FatImage.fd, pSrc, nLen, nOffset);
+		if (nWritten<=0) {
+			return 0;
+		}
+		pSrc += nWritten;
+		nOffset += nWritten;
+		nLen -= nWritten;
+	}
+	return 1;
+}
+
+static int FatWriteZero(off_t nOffset, off_t nLen) {
+	static const BYTE Zero[0x10000];
+
+	while (nLen>0) {
+		size_t nPart = (nLen<(off_t)sizeof(Zero)) ? nLen : sizeof(Zero);
+		if (!FatWrite(nOffset, Zero, nPart)) {
+			return 0;
+		}
+		nOffset += nPart;
+		nLen -= nPart;
+	}
+	return 1;
+}
+
+// Chain nCount clusters from nFirst on in both FATs, nCount 0 marks the
+// reserved entries 0 and 1
+static int FatWriteChain(DWORD nFirst, DWORD nCount) {
+	BYTE* pEntries;
+	DWORD nPos;
+	int bOK = 1, nFAT;
+
+	if (!nCount) {
+		BYTE Reserved[8];
+		FatPut32(Reserved, 0x0FFFFFF8);
+		FatPut32(Reserved+4, FAT_EOC);
+		for (nFAT=0; nFAT<2; nFAT++) {
+			bOK &= FatWrite(FatImage.nFATOffset + (off_t)nFAT*FatImage.nFATSectors*FAT_SECTOR, Reserved, sizeof(Reserved));
+		}
+		return bOK;
+	}
+	pEntries = malloc(nCount*4);
+	if (!pEntries) {
+		return 0;
+	}
+	for (nPos=0; nPos<nCount; nPos++) {
+		FatPut32(&pEntries[4*nPos], (nPos+1<nCount) ? nFirst+nPos+1 : FAT_EOC);
+	}
+	for (nFAT=0; nFAT<2; nFAT++) {
+		bOK &= FatWrite(FatImage.nFATOffset + (off_t)nFAT*FatImage.nFATSectors*FAT_SECTOR + (off_t)nFirst*4, pEntries, nCount*4);
+	}
+	free(pEntries);
+	return bOK;
+}
+
+static void FatDOSTime(time_t tTime, BYTE* pTime, BYTE* pDate) {
+	struct tm tmLocal;
+
+	localtime_r(&tTime, &tmLocal);
+	FatPut16(pTime, (tmLocal.tm_hour<<11) | (tmLocal.tm_min<<5) | (tmLocal.tm_sec/2));
+	FatPut16(pDate, ((tmLocal.tm_year-80)<<9) | ((tmLocal.tm_mon+1)<<5) | tmLocal.tm_mday);
+}
+
+// Every file gets long name entries, the short name NAME~n.EXT only has to
+// be unique
+static int FatWriteDirectory(void) {
+	size_t nDirSize = (size_t)FAT_ROOT_CLUSTERS*FatImage.nClusterSize;
+	BYTE* pDir = calloc(1, nDirSize);
+	BYTE* pEntry = pDir;
+	int nFile, bOK;
+
+	if (!pDir) {
+		return 0;
+	}
+	memcpy(pEntry, "GBXDUMPER  ", 11);
+	pEntry[11] = 0x08; // volume label
+	FatDOSTime(time(NULL), &pEntry[22], &pEntry[24]);
+	pEntry += 32;
+	for (nFile=0; nFile<FatImage.nFiles; nFile++) {
+		const struct FatFileEntryStruct* pFile = &FatImage.Files[nFile];
+		const char* pExt = strrchr(pFile->szName, '.');
+		int nNameLen = strlen(pFile->szName);
+		int nLFN = (nNameLen+12)/13;
+		BYTE ShortName[11];
+		BYTE nSum = 0;
+		int nPos, nChar, nSrc;
+
+		memset(ShortName, ' ', sizeof(ShortName));
+		for (nPos=0, nSrc=0; nPos<6 && pFile->szName+nSrc!=pExt && pFile->szName[nSrc]; nSrc++) {
+			nChar = toupper((unsigned char)pFile->szName[nSrc]);
+			ShortName[nPos++] = isalnum(nChar) ? nChar : '_';
+		}
+		ShortName[nPos++] = '~';
+		ShortName[nPos] = '1'+nFile;
+		for (nPos=0; pExt && nPos<3 && pExt[1+nPos]; nPos++) {
+			nChar = toupper((unsigned char)pExt[1+nPos]);
+			ShortName[8+nPos] = isalnum(nChar) ? nChar : '_';
+		}
+		for (nPos=0; nPos<11; nPos++) {
+			nSum = ((nSum & 1) << 7) + (nSum >> 1) + ShortName[nPos];
+		}
+		for (nPos=nLFN; nPos>0; nPos--) {
+			static const int Offset[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+			int nPart;
+
+			pEntry[0] = nPos | ((nPos==nLFN) ? 0x40 : 0);
+			pEntry[11] = 0x0F; // long name
+			pEntry[13] = nSum;
+			for (nPart=0; nPart<13; nPart++) {
+				nSrc = (nPos-1)*13 + nPart;
+				if (nSrc<nNameLen) {
+					FatPut16(&pEntry[Offset[nPart]], (unsigned char)pFile->szName[nSrc]);
+				} else {
+					FatPut16(&pEntry[Offset[nPart]], (nSrc==nNameLen) ? 0x0000 : 0xFFFF);
+				}
+			}
+			pEntry += 32;
+		}
+		memcpy(pEntry, ShortName, 11);
+		pEntry[11] = 0x20; // archive
+		FatDOSTime(pFile->tTime, &pEntry[14], &pEntry[16]);
+		memcpy(&pEntry[18], &pEntry[16], 2);
+		memcpy(&pEntry[22], &pEntry[14], 4);
+		FatPut16(&pEntry[20], pFile->nCluster >> 16);
+		FatPut16(&pEntry[26], pFile->nCluster & 0xFFFF);
+		FatPut32(&pEntry[28], pFile->nSize);
+		pEntry += 32;
+	}
+	bOK = FatWrite(FatImage.nDataOffset, pDir, nDirSize);
+	free(pDir);
+	return bOK;
+}
+
+static int FatWriteFSInfo(void) {
+	BYTE Sector[FAT_SECTOR];
+	off_t nPart = (off_t)FAT_PART_START*FAT_SECTOR;
+
+	memset(Sector, 0, sizeof(Sector));
+	FatPut32(&Sector[0], 0x41615252);
+	FatPut32(&Sector[484], 0x61417272);
+	FatPut32(&Sector[488], FatImage.nClusters+2-FatImage.nNextCluster);
+	FatPut32(&Sector[492], FatImage.nNextCluster);
+	FatPut32(&Sector[508], 0xAA550000);
+	return FatWrite(nPart + 1*FAT_SECTOR, Sector, sizeof(Sector)) && FatWrite(nPart + 7*FAT_SECTOR, Sector, sizeof(Sector));
+}
+
+// Size: block device size, size of an existing file or FAT_DEFAULT_SIZE
+static int FatImageFormat(const char* szImage) {
+	BYTE Sector[FAT_SECTOR];
+	BYTE* pPartition;
+	struct stat Stat;
+	unsigned long long nBytes = 0;
+	DWORD nSectors, nTmp1, nTmp2;
+	off_t nPart = (off_t)FAT_PART_START*FAT_SECTOR;
+
+	if (FatImage.fd<0) {
+		FatImage.fd = open(szImage, O_RDWR | O_CREAT, 0644);
+	}
+	if (FatImage.fd<0 || fstat(FatImage.fd, &Stat)!=0) {
+		perror(szImage);
+		return 0;
+	}
+	if (S_ISBLK(Stat.st_mode)) {
+		ioctl(FatImage.fd, BLKGETSIZE64, &nBytes);
+	} else if (Stat.st_size) {
+		nBytes = Stat.st_size;
+	} else if (0==ftruncate(FatImage.fd, FAT_DEFAULT_SIZE)) {
+		nBytes = FAT_DEFAULT_SIZE;
+	}
+	nSectors = (nBytes/FAT_SECTOR > 0xFFFFFFFF) ? 0xFFFFFFFF : nBytes/FAT_SECTOR;
+	FatImage.nPartSectors = (nSectors>FAT_PART_START) ? nSectors-FAT_PART_START : 0;
+	// FAT size as in the Microsoft FAT specification, the smallest cluster
+	// that stays below FAT_MAX_CLUSTERS
+	FatImage.nSectorsPerCluster = 1;
+	do {
+		nTmp1 = FatImage.nPartSectors - FAT_RESERVED;
+		nTmp2 = (256*FatImage.nSectorsPerCluster + 2)/2;
+		FatImage.nFATSectors = (nTmp1 + nTmp2 - 1)/nTmp2;
+		FatImage.nClusters = (FatImage.nPartSectors - FAT_RESERVED - 2*FatImage.nFATSectors)/FatImage.nSectorsPerCluster;
+	} while (FatImage.nClusters>FAT_MAX_CLUSTERS && FatImage.nSectorsPerCluster<64 && (FatImage.nSectorsPerCluster*=2));
+	if (FatImage.nPartSectors<=FAT_RESERVED || FatImage.nClusters<FAT_MIN_CLUSTERS) {
+		printf("FAT image '%s' too small for FAT32 (%llu bytes, at least 34 MiB)\n", szImage, nBytes);
+		return 0;
+	}
+	FatImage.nClusterSize = FatImage.nSectorsPerCluster*FAT_SECTOR;
+	FatImage.nFATOffset = nPart + (off_t)FAT_RESERVED*FAT_SECTOR;
+	FatImage.nDataOffset = FatImage.nFATOffset + (off_t)2*FatImage.nFATSectors*FAT_SECTOR;
+	FatImage.nNextCluster = 2+FAT_ROOT_CLUSTERS;
+	FatImage.nFiles = 0;
+
+	// MBR with one FAT32 (LBA) partition
+	memset(Sector, 0, sizeof(Sector));
+	FatPut32(&Sector[0x1B8], (DWORD)time(NULL));
+	pPartition = &Sector[0x1BE];
+	pPartition[1] = 0xFE; pPartition[2] = 0xFF; pPartition[3] = 0xFF; // CHS not used
+	pPartition[4] = 0x0C;
+	pPartition[5] = 0xFE; pPartition[6] = 0xFF; pPartition[7] = 0xFF;
+	FatPut32(&pPartition[8], FAT_PART_START);
+	FatPut32(&pPartition[12], FatImage.nPartSectors);
+	Sector[510] = 0x55; Sector[511] = 0xAA;
+	if (!FatWrite(0, Sector, sizeof(Sector)) || !FatWriteZero(nPart, FatImage.nDataOffset + (off_t)FAT_ROOT_CLUSTERS*FatImage.nClusterSize - nPart)) {
+		perror(szImage);
+		return 0;
+	}
+	// boot sector and its backup
+	memset(Sector, 0, sizeof(Sector));
+	Sector[0] = 0xEB; Sector[1] = 0x58; Sector[2] = 0x90;
+	memcpy(&Sector[3], "GBXDUMP ", 8);
+	FatPut16(&Sector[11], FAT_SECTOR);
+	Sector[13] = FatImage.nSectorsPerCluster;
+	FatPut16(&Sector[14], FAT_RESERVED);
+	Sector[16] = 2;
+	Sector[21] = 0xF8;
+	FatPut16(&Sector[24], 63);
+	FatPut16(&Sector[26], 255);
+	FatPut32(&Sector[28], FAT_PART_START);
+	FatPut32(&Sector[32], FatImage.nPartSectors);
+	FatPut32(&Sector[36], FatImage.nFATSectors);
+	FatPut32(&Sector[44], 2);   // root directory cluster
+	FatPut16(&Sector[48], 1);   // FSInfo sector
+	FatPut16(&Sector[50], 6);   // backup boot sector
+	Sector[64] = 0x80;
+	Sector[66] = 0x29;
+	FatPut32(&Sector[67], (DWORD)time(NULL));
+	memcpy(&Sector[71], "GBXDUMPER  ", 11);
+	memcpy(&Sector[82], "FAT32   ", 8);
+	Sector[510] = 0x55; Sector[511] = 0xAA;
+	if (!FatWrite(nPart, Sector, sizeof(Sector)) || !FatWrite(nPart + 6*FAT_SECTOR, Sector, sizeof(Sector)) ||
+	    !FatWriteFSInfo() || !FatWriteChain(0, 0) || !FatWriteChain(2, FAT_ROOT_CLUSTERS) || !FatWriteDirectory()) {
+		perror(szImage);
+		return 0;
+	}
+	FatImage.bFormatted = 1;
+	printf("FAT32 image '%s' formatted (%lu clusters of %lu bytes)\n", szImage, FatImage.nClusters, FatImage.nClusterSize);
+	return 1;
+}
+
+// New cartridge: the next dump file formats the image again
+static void FatImageReset(void) {
+	FatImage.bFormatted = 0;
+	FatImage.bStreaming = 0;
+}
+
+static void FatImageClose(void) {
+	if (FatImage.fd>=0) {
+		fsync(FatImage.fd);
+		close(FatImage.fd);
+		FatImage.fd = -1;
+	}
+}
+
+static int FatFileBegin(void) {
+	if (!szFatImage || (!FatImage.bFormatted && !FatImageFormat(szFatImage))) {
+		FatImage.bStreaming = 0;
+		return 0;
+	}
+	FatImage.bStreaming = 1;
+	FatImage.bStreamError = 0;
+	FatImage.nStreamCluster = FatImage.nNextCluster;
+	FatImage.nStreamSize = 0;
+	return 1;
+}
+
+// Only from the thread that writes the dump file
+static void FatFileWrite(const BYTE* pData, size_t nLen) {
+	off_t nFree = (off_t)(FatImage.nClusters+2-FatImage.nStreamCluster)*FatImage.nClusterSize;
+
+	if (!FatImage.bStreaming || FatImage.bStreamError) {
+		return;
+	}
+	if (FatImage.nStreamSize+nLen > nFree ||
+	    !FatWrite(FatImage.nDataOffset + (off_t)(FatImage.nStreamCluster-2)*FatImage.nClusterSize + FatImage.nStreamSize, pData, nLen)) {
+		FatImage.bStreamError = 1;
+		return;
+	}
+	FatImage.nStreamSize += nLen;
+}
+
+// The streamed file is complete, szName is its final name
+static int FatFileCommit(const char* szName) {
+	struct FatFileEntryStruct* pFile;
+	DWORD nCount;
+
+	if (!FatImage.bStreaming) {
+		return 0;
+	}
+	FatImage.bStreaming = 0;
+	if (FatImage.bStreamError || FatImage.nFiles>=FAT_MAX_FILES) {
+		printf("'%s' not stored in FAT image (full)\n", szName);
+		return 0;
+	}
+	nCount = (FatImage.nStreamSize + FatImage.nClusterSize - 1)/FatImage.nClusterSize;
+	pFile = &FatImage.Files[FatImage.nFiles++];
+	snprintf(pFile->szName, sizeof(pFile->szName), "%s", szName);
+	pFile->nCluster = nCount ? FatImage.nStreamCluster : 0;
+	pFile->nSize = FatImage.nStreamSize;
+	pFile->tTime = time(NULL);
+	FatImage.nNextCluster += nCount;
+	if ((nCount && !FatWriteChain(FatImage.nStreamCluster, nCount)) || !FatWriteDirectory() || !FatWriteFSInfo()) {
+		perror("Could not write FAT image");
+		return 0;
+	}
+	return 1;
+}
+
+// Small files written outside of DumpFile (DAT record)
+static int FatImportFile(const char* szFileName) {
+	BYTE Buffer[0x1000];
+	FILE* fp;
+	size_t nRead;
+
+	if (!FatFileBegin()) {
+		return 0;
+	}
+	fp = fopen(szFileName, "rb");
+	if (!fp) {
+		FatImage.bStreaming = 0;
+		return 0;
+	}
+	while ((nRead = fread(Buffer, 1, sizeof(Buffer), fp)) > 0) {
+		FatFileWrite(Buffer, nRead);
+	}
+	fclose(fp);
+	return FatFileCommit(szFileName);
+}
+
+//###########################################################
+// Host offload (option --stream): dump files are not written here but sent
+// as frames to a receiver (gbxreceive.c) that verifies, hashes and stores
+// them. Frame header, 20 bytes little endian: magic "GBXF", type, 3 bytes
+// zero, sequence number, payload length, CRC32 of the payload.
+
+#define STREAM_HEADER_SIZE 20
+
+typedef enum {
+	StreamFrameOpen = 1,      // new file, payload: file name
+	StreamFrameData,          // payload: next bytes of the file
+	StreamFrameClose,         // payload: status (0 ok), size, CRC32 (4 bytes each), SHA-256
+	StreamFrameRename,        // last file, payload: new file name
+	StreamFrameRemove,        // last file is not valid
+	StreamFrameEnd            // cartridge done
+} StreamFrameType;
+
+static int fd_Stream = -1;
+static DWORD nStreamSequence = 0;
+
+// "-" is stdout (console output goes to stderr then), a number an open
+// file descriptor, "unix:<path>" a listening receiver, else file or FIFO
+int GBxStreamOpen(const char* szTarget) {
+	const char* pPos = szTarget;
+
+	while (isdigit((unsigned char)pPos[0])) {
+		pPos++;
+	}
+	if (!strcmp(szTarget, "-")) {
+		fd_Stream = dup(STDOUT_FILENO);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	} else if (szTarget[0]!='\0' && pPos[0]=='\0') {
+		fd_Stream = atoi(szTarget);
+	} else if (!strncmp(szTarget, "unix:", 5)) {
+		struct sockaddr_un Addr;
+
+		memset(&Addr, 0, sizeof(Addr));
+		Addr.sun_family = AF_UNIX;
+		strncpy(Addr.sun_path, &szTarget[5], sizeof(Addr.sun_path)-1);
+		fd_Stream = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd_Stream>=0 && connect(fd_Stream, (struct sockaddr*)&Addr, sizeof(Addr))!=0) {
+			close(fd_Stream);
+			fd_Stream = -1;
+		}
+	} else {
+		fd_Stream = open(szTarget, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if (fd_Stream<0 || fcntl(fd_Stream, F_GETFD)<0) {
+		fprintf(stderr, "Failed to open stream '%s' (%s)\n", szTarget, strerror(errno));
+		fd_Stream = -1;
+		return 0;
+	}
+	bLocalFiles = 0;
+	return 1;
+}
+
+static int StreamSend(StreamFrameType nType, const void* pPayload, DWORD nLen) {
+	BYTE Header[STREAM_HEADER_SIZE];
+	struct iovec Vector[2];
+	ssize_t nWritten;
+	int nFirst = 0, nVector = nLen ? 2 : 1;
+
+	if (fd_Stream<0) {
+		return 0;
+	}
+	memset(Header, 0, sizeof(Header));
+	memcpy(Header, "GBXF", 4);
+	Header[4] = nType;
+	FatPut32(&Header[8], nStreamSequence++);
+	FatPut32(&Header[12], nLen);
+	FatPut32(&Header[16], crc32(0, (const Bytef*)pPayload, nLen));
+	Vector[0].iov_base = Header;
+	Vector[0].iov_len = sizeof(Header);
+	Vector[1].iov_base = (void*)pPayload;
+	Vector[1].iov_len = nLen;
+	while (nFirst<nVector) {
+		nWritten = WritevNoSigPipe(fd_Stream, &Vector[nFirst], nVector-nFirst);
+		if (nWritten<0 && errno==EINTR) {
+			continue;
+		}
+		if (nWritten<=0) {
+			fprintf(stderr, "stream receiver closed (%s)\n", strerror(errno));
+			close(fd_Stream);
+			fd_Stream = -1;
+			return 0;
+		}
+		while (nFirst<nVector && (size_t)nWritten>=Vector[nFirst].iov_len) {
+			nWritten -= Vector[nFirst].iov_len;
+			nFirst++;
+		}
+		if (nFirst<nVector) {
+			Vector[nFirst].iov_base = (BYTE*)Vector[nFirst].iov_base + nWritten;
+			Vector[nFirst].iov_len -= nWritten;
+		}
+	}
+	return 1;
+}
+
+// End of the open file, the receiver compares size and digests with its own
+static int StreamClose(int bOK, const struct DigestStruct* pDigest) {
+	BYTE Status[1+4+4+32];
+
+	Status[0] = bOK ? 0 : 1;
+	FatPut32(&Status[1], pDigest->nSize);
+	FatPut32(&Status[5], pDigest->crc32);
+	memcpy(&Status[9], pDigest->SHA256, 32);
+	return StreamSend(StreamFrameClose, Status, sizeof(Status));
+}
+
+// A small file made here (DAT record) in one data frame
+static int StreamFile(const char* szFileName, const void* pData, DWORD nLen) {
+	struct DigestStruct Digest;
+
+	DigestInit(&Digest);
+	DigestUpdate(&Digest, pData, nLen);
+	DigestFinal(&Digest);
+	return StreamSend(StreamFrameOpen, szFileName, strlen(szFileName))
+	  && (!nLen || StreamSend(StreamFrameData, pData, nLen))
+	  && StreamClose(1, &Digest);
+}
+
+//###########################################################
+// Dump output: blocks are handed to a worker thread that computes the
+// digests and writes them (with --gzip through deflate) to the file and
+// the FAT image. At most DUMPFILE_BLOCKS are buffered. With --stream the
+// worker hashes and sends the blocks, the receiver checks the digests of
+// the close frame and stores them.
+// The block callback of the session gets the data in DumpFileWrite.
+
+#define DUMPFILE_BLOCKS 4
+#define DUMPFILE_BLOCK_SIZE 0x10000
+
+struct DumpFileStruct {
+	char szFileName[16+4+3+1];
+	GBxDataKind nKind;
+	FILE* fp;                             // local file
+	z_stream Stream;                      // --gzip
+	BYTE* pBlocks;
+	BYTE* pOut;                           // deflate output
+	size_t Fill[DUMPFILE_BLOCKS];
+	int nHead, nTail, nQueued;
+	int bClosing, bError;                 // under Mutex, both threads set bError
+	pthread_t Thread;
+	pthread_mutex_t Mutex;
+	pthread_cond_t Cond;
+	struct DigestStruct Digest;           // valid after DumpFileClose, local files
+	DWORD nSize;                          // uncompressed
+};
+
+// Store output bytes, with --gzip deflate them first (nFlush Z_FINISH at the end)
+static int DumpFileOutput(struct DumpFileStruct* pFile, const BYTE* pData, size_t nLen, int nFlush) {
+	size_t nOut;
+
+	if (fd_Stream>=0) {
+		return !nLen || StreamSend(StreamFrameData, pData, nLen);
+	}
+	if (!pFile->fp && !FatImage.bStreaming) {
+		return 1;
+	}
+	if (!bGzip) {
+		FatFileWrite(pData, nLen);
+		return !pFile->fp || (nLen == fwrite(pData, 1, nLen, pFile->fp));
+	}
+	pFile->Stream.next_in = (BYTE*)pData;
+	pFile->Stream.avail_in = nLen;
+	do {
+		pFile->Stream.next_out = pFile->pOut;
+		pFile->Stream.avail_out = DUMPFILE_BLOCK_SIZE;
+		if (Z_STREAM_ERROR == deflate(&pFile->Stream, nFlush)) {
+			return 0;
+		}
+		nOut = DUMPFILE_BLOCK_SIZE - pFile->Stream.avail_out;
+		FatFileWrite(pFile->pOut, nOut);
+		if (pFile->fp && nOut != fwrite(pFile->pOut, 1, nOut, pFile->fp)) {
+			return 0;
+		}
+	} while (0==pFile->Stream.avail_out);
+	return 1;
+}
+
+static void* DumpFileWorker(void* pArg) {
+	struct DumpFileStruct* pFile = (struct DumpFileStruct*)pArg;
+	BYTE* pBlock;
+	size_t nFill;
+	int nBlock, bFailed;
+
+	pthread_mutex_lock(&pFile->Mutex);
+	for (;;) {
+		while (!pFile->nQueued && !pFile->bClosing) {
+			pthread_cond_wait(&pFile->Cond, &pFile->Mutex);
+		}
+		if (!pFile->nQueued) {
+			break;
+		}
+		nBlock = pFile->nTail;
+		pthread_mutex_unlock(&pFile->Mutex);
+		pBlock = &pFile->pBlocks[nBlock*DUMPFILE_BLOCK_SIZE];
+		nFill = pFile->Fill[nBlock];
+		if (bLocalFiles || fd_Stream>=0) {
+			DigestUpdate(&pFile->Digest, pBlock, nFill);
+		}
+		bFailed = !DumpFileOutput(pFile, pBlock, nFill, Z_NO_FLUSH);
+		pthread_mutex_lock(&pFile->Mutex);
+		pFile->bError |= bFailed;
+		pFile->nTail = (nBlock+1) % DUMPFILE_BLOCKS;
+		pFile->nQueued--;
+		pthread_cond_broadcast(&pFile->Cond);
+	}
+	pthread_mutex_unlock(&pFile->Mutex);
+	return NULL;
+}
+
+static int DumpFileOpen(struct DumpFileStruct* pFile, const char* szFileName, GBxDataKind nKind) {
+	memset(pFile, 0, sizeof(*pFile));
+	pFile->nKind = nKind;
+	snprintf(pFile->szFileName, sizeof(pFile->szFileName), bGzip ? "%s.gz" : "%s", szFileName);
+	DigestInit(&pFile->Digest);
+	pFile->pBlocks = malloc(DUMPFILE_BLOCKS*DUMPFILE_BLOCK_SIZE + (bGzip ? DUMPFILE_BLOCK_SIZE : 0));
+	pFile->pOut = &pFile->pBlocks[DUMPFILE_BLOCKS*DUMPFILE_BLOCK_SIZE];
+	if (fd_Stream>=0) {
+		if (!pFile->pBlocks || !StreamSend(StreamFrameOpen, pFile->szFileName, strlen(pFile->szFileName))) {
+			free(pFile->pBlocks);
+			pFile->pBlocks = NULL;
+			return 0;
+		}
+	} else if (bLocalDumpFiles) {
+		pFile->fp = fopen(pFile->szFileName, "w+");
+	}
+	//gzip header and trailer (windowBits 15+16), level 6 like gzip
+	if (!pFile->pBlocks || (bLocalDumpFiles && !pFile->fp) || (bGzip && Z_OK != deflateInit2(&pFile->Stream, 6, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY))) {
+		if (pFile->fp) {
+			fclose(pFile->fp);
+		}
+		free(pFile->pBlocks);
+		pFile->pBlocks = NULL;
+		return 0;
+	}
+	if (bLocalFiles) {
+		FatFileBegin();
+	}
+	pthread_mutex_init(&pFile->Mutex, NULL);
+	pthread_cond_init(&pFile->Cond, NULL);
+	if (pthread_create(&pFile->Thread, NULL, DumpFileWorker, pFile)!=0) {
+		if (bGzip) {
+			deflateEnd(&pFile->Stream);
+		}
+		if (pFile->fp) {
+			fclose(pFile->fp);
+		}
+		free(pFile->pBlocks);
+		pFile->pBlocks = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+static int DumpFileError(struct DumpFileStruct* pFile, int bSet) {
+	int bError;
+
+	pthread_mutex_lock(&pFile->Mutex);
+	pFile->bError |= bSet;
+	bError = pFile->bError;
+	pthread_mutex_unlock(&pFile->Mutex);
+	return bError;
+}
+
+static int DumpFileWrite(struct DumpFileStruct* pFile, const void* pData, size_t nLen) {
+	const BYTE* pSrc = (const BYTE*)pData;
+	size_t nCopy;
+	int bError = DumpFileError(pFile, 0);
+
+	if (pGBxSession && pGBxSession->Callbacks.Block && nLen && !bError) {
+		if (!pGBxSession->Callbacks.Block(pGBxSession->pUser, pFile->nKind, pFile->nSize, pSrc, nLen)) {
+			bError = DumpFileError(pFile, 1);
+		}
+	}
+	pFile->nSize += nLen;
+	while (nLen && !bError) {
+		size_t* pFill = &pFile->Fill[pFile->nHead];
+
+		nCopy = DUMPFILE_BLOCK_SIZE - *pFill;
+		if (nCopy>nLen) {
+			nCopy = nLen;
+		}
+		memcpy(&pFile->pBlocks[pFile->nHead*DUMPFILE_BLOCK_SIZE + *pFill], pSrc, nCopy);
+		*pFill += nCopy;
+		pSrc += nCopy;
+		nLen -= nCopy;
+		if (DUMPFILE_BLOCK_SIZE == *pFill) {
+			pthread_mutex_lock(&pFile->Mutex);
+			pFile->nQueued++;
+			pFile->nHead = (pFile->nHead+1) % DUMPFILE_BLOCKS;
+			pthread_cond_broadcast(&pFile->Cond);
+			while (DUMPFILE_BLOCKS == pFile->nQueued) {
+				pthread_cond_wait(&pFile->Cond, &pFile->Mutex);
+			}
+			bError = pFile->bError;
+			pthread_mutex_unlock(&pFile->Mutex);
+			pFile->Fill[pFile->nHead] = 0;
+		}
+	}
+	return !bError;
+}
+
+static int DumpFileClose(struct DumpFileStruct* pFile) {
+	int bOK;
+
+	if (!pFile->pBlocks) {
+		return 0;
+	}
+	pthread_mutex_lock(&pFile->Mutex);
+	if (pFile->Fill[pFile->nHead]) {
+		pFile->nQueued++;
+	}
+	pFile->bClosing = 1;
+	pthread_cond_broadcast(&pFile->Cond);
+	pthread_mutex_unlock(&pFile->Mutex);
+	pthread_join(pFile->Thread, NULL);
+	pthread_mutex_destroy(&pFile->Mutex);
+	pthread_cond_destroy(&pFile->Cond);
+	DigestFinal(&pFile->Digest);
+	bOK = !pFile->bError;
+	if (bGzip) {
+		bOK = bOK && DumpFileOutput(pFile, NULL, 0, Z_FINISH);
+		deflateEnd(&pFile->Stream);
+	}
+	if (fd_Stream>=0) {
+		bOK &= StreamClose(bOK, &pFile->Digest);
+	} else if (pFile->fp) {
+		bOK &= (0==fflush(pFile->fp));
+		bOK &= (0==fclose(pFile->fp));
+		pFile->fp = NULL;
+	}
+	free(pFile->pBlocks);
+	pFile->pBlocks = NULL;
+	return bOK;
+}
+
+// Rename to szTarget (+ ".gz"), szFinal receives the new name
+static int DumpFileRename(struct DumpFileStruct* pFile, const char* szTarget, char* szFinal, size_t nFinalSize) {
+	char szNewName[sizeof(pFile->szFileName)];
+
+	snprintf(szNewName, sizeof(szNewName), bGzip ? "%s.gz" : "%s", szTarget);
+	if (fd_Stream>=0) {
+		if (!StreamSend(StreamFrameRename, szNewName, strlen(szNewName))) {
+			return 0;
+		}
+	} else if (bLocalDumpFiles && rename(pFile->szFileName, szNewName)!=0) {
+		return 0;
+	}
+	strcpy(pFile->szFileName, szNewName);
+	if (szFinal) {
+		snprintf(szFinal, nFinalSize, "%s", szNewName);
+	}
+	return 1;
+}
+
+// Throw away a closed dump file that is not valid
+static void DumpFileRemove(const struct DumpFileStruct* pFile) {
+	if (fd_Stream>=0) {
+		StreamSend(StreamFrameRemove, NULL, 0);
+	} else if (bLocalDumpFiles) {
+		unlink(pFile->szFileName);
+	}
+}
+
+//###########################################################
+// DAT record: ROM and save of a cartridge with size and digests go to
+// <game>.dat (XML like the No-Intro DATs), the digests describe the
+// uncompressed content also with --gzip. Logiqx datafile layout with the
+// No-Intro additions to <rom>: sha256 and serial (game code of the ROM).
+
+struct DatFileStruct {
+	char szFileName[16+4+3+1];
+	struct DigestStruct Digest;
+	int bValid;
+};
+
+static struct DatStruct {
+	char szGameName[16+1];
+	char szGameCode[4+1];
+	char szSaveType[16];
+	int nSaveSize;
+	struct DatFileStruct Files[2];        // ROM, save
+} Dat;
+
+static const char* XMLString(char* szDest, int nDestSize, const char* szSrc) {
+	int nPos = 0;
+
+	while (szSrc && szSrc[0]!='\0' && nPos<nDestSize-7) {
+		unsigned char cChar = (unsigned char)szSrc[0];
+		if (cChar=='&') {
+			nPos += sprintf(&szDest[nPos], "&amp;");
+		} else if (cChar=='<') {
+			nPos += sprintf(&szDest[nPos], "&lt;");
+		} else if (cChar=='>') {
+			nPos += sprintf(&szDest[nPos], "&gt;");
+		} else if (cChar=='"') {
+			nPos += sprintf(&szDest[nPos], "&quot;");
+		} else if (cChar<0x20 || cChar>=0x7F) {
+			szDest[nPos++] = '_';
+		} else {
+			szDest[nPos++] = cChar;
+		}
+		szSrc++;
+	}
+	szDest[nPos] = '\0';
+	return szDest;
+}
+
+static void DatBegin(const char* szGameName, const char* szGameCode) {
+	memset(&Dat, 0, sizeof(Dat));
+	snprintf(Dat.szGameName, sizeof(Dat.szGameName), "%s", szGameName);
+	snprintf(Dat.szGameCode, sizeof(Dat.szGameCode), "%s", szGameCode);
+}
+
+static void DatSetSave(const char* szSaveType, int nSize) {
+	snprintf(Dat.szSaveType, sizeof(Dat.szSaveType), "%s", szSaveType);
+	Dat.nSaveSize = nSize;
+}
+
+// Call after DumpFileClose (and rename) of a complete dump
+static void DatAddFile(const struct DumpFileStruct* pFile) {
+	struct DatFileStruct* pDat = &Dat.Files[(GBxDataROM==pFile->nKind) ? 0 : 1];
+	char szMD5[32+1], szSHA1[40+1], szSHA256[64+1];
+	char szJSONFile[MAX_PATH+1];
+	size_t nLen;
+
+	pDat->bValid = 1;
+	snprintf(pDat->szFileName, sizeof(pDat->szFileName), "%s", pFile->szFileName);
+	nLen = strlen(pDat->szFileName);
+	if (nLen>3 && !strcmp(&pDat->szFileName[nLen-3], ".gz")) {
+		pDat->szFileName[nLen-3] = '\0';
+	}
+	pDat->Digest = pFile->Digest;
+	printf("MD5: %s, SHA-1: %s\n", DigestText(szMD5, pDat->Digest.MD5, 16), DigestText(szSHA1, pDat->Digest.SHA1, 20));
+	JSONEmit("\"event\":\"digest\",\"file\":\"%s\",\"size\":%lu,\"crc32\":\"%08X\",\"md5\":\"%s\",\"sha1\":\"%s\",\"sha256\":\"%s\"",
+	  JSONString(szJSONFile, sizeof(szJSONFile), pDat->szFileName), pDat->Digest.nSize, (unsigned int)pDat->Digest.crc32,
+	  szMD5, szSHA1, DigestText(szSHA256, pDat->Digest.SHA256, 32));
+}
+
+// A dump file is complete under its final name
+static void DumpFileFinished(const struct DumpFileStruct* pFile) {
+	if (pGBxSession && pGBxSession->Callbacks.Finished) {
+		pGBxSession->Callbacks.Finished(pGBxSession->pUser, pFile->nKind, pFile->szFileName, pFile->nSize);
+	}
+	if (fd_Stream>=0) {
+		printf("%s streamed (%lu bytes)\n", pFile->szFileName, pFile->nSize);
+		DatAddFile(pFile);
+		return;
+	}
+	if (!bLocalFiles) {
+		return;
+	}
+	DatAddFile(pFile);
+	FatFileCommit(pFile->szFileName);
+}
+
+static int DatWrite(void) {
+	char szDatFile[16+4+1];
+	char szName[6*(16+4+3)+1];
+	char szMD5[32+1], szSHA1[40+1], szSHA256[64+1];
+	char* pText = NULL;
+	size_t nText = 0;
+	FILE* fp;
+	int nFile, bOK;
+
+	if (!Dat.Files[0].bValid && !Dat.Files[1].bValid) {
+		return 0;
+	}
+	snprintf(szDatFile, sizeof(szDatFile), "%s.dat", Dat.szGameName[0] ? Dat.szGameName : "UNKNOWN");
+	//with --stream the record goes to the receiver like the dump files
+	fp = (fd_Stream>=0) ? open_memstream(&pText, &nText) : fopen(szDatFile, "w");
+	if (!fp) {
+		perror("Could not create DAT file");
+		return 0;
+	}
+	fprintf(fp, "<?xml version=\"1.0\"?>\n");
+	fprintf(fp, "<!DOCTYPE datafile PUBLIC \"-//Logiqx//DTD ROM Management Datafile//EN\" \"http://www.logiqx.com/Dats/datafile.dtd\">\n");
+	fprintf(fp, "<datafile>\n");
+	fprintf(fp, "\t<header>\n\t\t<name>gbxdumper</name>\n\t\t<description>%s</description>\n\t</header>\n",
+	  XMLString(szName, sizeof(szName), Dat.szGameName));
+	fprintf(fp, "\t<game name=\"%s\">\n", szName);
+	if (Dat.szSaveType[0]) {
+		fprintf(fp, "\t\t<comment>save: %s, %d bytes</comment>\n", Dat.szSaveType, Dat.nSaveSize);
+	}
+	fprintf(fp, "\t\t<description>%s</description>\n", szName);
+	for (nFile=0; nFile<2; nFile++) {
+		const struct DigestStruct* pDigest = &Dat.Files[nFile].Digest;
+
+		if (!Dat.Files[nFile].bValid) {
+			continue;
+		}
+		fprintf(fp, "\t\t<rom name=\"%s\" size=\"%lu\" crc=\"%08x\" md5=\"%s\" sha1=\"%s\" sha256=\"%s\"",
+		  XMLString(szName, sizeof(szName), Dat.Files[nFile].szFileName), pDigest->nSize, (unsigned int)pDigest->crc32,
+		  DigestText(szMD5, pDigest->MD5, 16), DigestText(szSHA1, pDigest->SHA1, 20), DigestText(szSHA256, pDigest->SHA256, 32));
+		if (0==nFile && Dat.szGameCode[0]) {
+			fprintf(fp, " serial=\"%s\"", XMLString(szName, sizeof(szName), Dat.szGameCode));
+		}
+		fprintf(fp, "/>\n");
+	}
+	fprintf(fp, "\t</game>\n");
+	fprintf(fp, "</datafile>\n");
+	bOK = (fclose(fp)==0);
+	if (bOK && fd_Stream>=0) {
+		bOK = StreamFile(szDatFile, pText, nText);
+		free(pText);
+		if (bOK) {
+			printf("DAT record streamed as '%s'\n", szDatFile);
+		}
+		return bOK;
+	}
+	free(pText);
+	if (!bOK) {
+		perror("Could not write DAT file");
+		return 0;
+	}
+	printf("DAT record written to '%s'\n", szDatFile);
+	FatImportFile(szDatFile);
+	return 1;
+}
+
+//###########################################################
+// GPIO backend for RD, LED and switch: wiringPi (default, /dev/mem) or the
+// Linux GPIO character device (option --gpio-chip, uAPI v2, no root with
+// access to the chip). Every line is requested once, RD then only needs one
+// ioctl per edge on its own handle. Switch edges come as kernel events.
+
+#define GPIO_LINES_MAX 4
+
+static struct GPIOLineStruct {
+	int nPin;               // line offset of the chip (BCM number on the Pi)
+	int fd;                 // line request
+	int nMode;              // INPUT, OUTPUT
+	int bPullUp;
+} GPIOLines[GPIO_LINES_MAX];
+static int nGPIOLines = 0;
+static int fd_GPIOChip = -1;
+
+static int GPIOSetup(void) {
+	if (!szGPIOChip) {
+		if (wiringPiSetupGpio() == -1) {
+			GBxReportError(GBxErrorBus, "wiringPiSetup failed");
+			return 0;
+		}
+		return 1;
+	}
+	fd_GPIOChip = open(szGPIOChip, O_RDWR | O_CLOEXEC);
+	if (fd_GPIOChip < 0) {
+		GBxReportError(GBxErrorBus, "Failed to open GPIO chip '%s' (%s)", szGPIOChip, strerror(errno));
+		return 0;
+	}
+	return 1;
+}
+
+static void GPIORelease(void) {
+	int nLine;
+
+	for (nLine=0; nLine<nGPIOLines; nLine++) {
+		close(GPIOLines[nLine].fd);
+	}
+	nGPIOLines = 0;
+	if (fd_GPIOChip >= 0) {
+		close(fd_GPIOChip);
+		fd_GPIOChip = -1;
+	}
+}
+
+static struct GPIOLineStruct* GPIOFindLine(int nPin) {
+	int nLine;
+
+	for (nLine=0; nLine<nGPIOLines; nLine++) {
+		if (GPIOLines[nLine].nPin == nPin) {
+			return &GPIOLines[nLine];
+		}
+	}
+	return NULL;
+}
+
+// Line flags of the mode, an output starts high (RD inactive, LED off)
+static void GPIOLineConfig(const struct GPIOLineStruct* pLine, struct gpio_v2_line_config* pConfig) {
+	memset(pConfig, 0, sizeof(*pConfig));
+	if (OUTPUT == pLine->nMode) {
+		pConfig->flags = GPIO_V2_LINE_FLAG_OUTPUT;
+		pConfig->num_attrs = 1;
+		pConfig->attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+		pConfig->attrs[0].attr.values = 1;
+		pConfig->attrs[0].mask = 1;
+	} else {
+		pConfig->flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+		if (pLine->bPullUp) {
+			pConfig->flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+		}
+	}
+}
+
+// Request the line on first use, later only change its configuration
+static int GPIOLineSet(int nPin, int nMode, int bPullUp) {
+	struct GPIOLineStruct* pLine = GPIOFindLine(nPin);
+	struct gpio_v2_line_request Request;
+	struct gpio_v2_line_config Config;
+
+	if (pLine) {
+		if (pLine->nMode == nMode && pLine->bPullUp == bPullUp) {
+			return 1;
+		}
+		pLine->nMode = nMode;
+		pLine->bPullUp = bPullUp;
+		GPIOLineConfig(pLine, &Config);
+		if (ioctl(pLine->fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &Config) < 0) {
+			GBxReportError(GBxErrorBus, "Failed to configure GPIO %d of '%s' (%s)", nPin, szGPIOChip, strerror(errno));
+			return 0;
+		}
+		return 1;
+	}
+	if (fd_GPIOChip < 0 || nGPIOLines >= GPIO_LINES_MAX) {
+		return 0;
+	}
+	pLine = &GPIOLines[nGPIOLines];
+	pLine->nPin = nPin;
+	pLine->nMode = nMode;
+	pLine->bPullUp = bPullUp;
+	memset(&Request, 0, sizeof(Request));
+	Request.offsets[0] = nPin;
+	Request.num_lines = 1;
+	strcpy(Request.consumer, "gbxdumper");
+	GPIOLineConfig(pLine, &Request.config);
+	if (ioctl(fd_GPIOChip, GPIO_V2_GET_LINE_IOCTL, &Request) < 0) {
+		GBxReportError(GBxErrorBus, "Failed to request GPIO %d of '%s' (%s)", nPin, szGPIOChip, strerror(errno));
+		return 0;
+	}
+	pLine->fd = Request.fd;
+	nGPIOLines++;
+	return 1;
+}
+
+int GBxGPIOMode(int nPin, int nMode) {
+	if (!szGPIOChip) {
+		pinMode(nPin, nMode);
+		return 1;
+	}
+	return GPIOLineSet(nPin, nMode, 0);
+}
+
+int GBxGPIOPullUp(int nPin) {
+	if (!szGPIOChip) {
+		pullUpDnControl(nPin, PUD_UP);
+		return 1;
+	}
+	return GPIOLineSet(nPin, INPUT, 1);
+}
+
+void GBxGPIOWrite(int nPin, int nValue) {
+	struct GPIOLineStruct* pLine;
+	struct gpio_v2_line_values Values;
+
+	if (!szGPIOChip) {
+		digitalWrite(nPin, nValue);
+		return;
+	}
+	pLine = GPIOFindLine(nPin);
+	if (!pLine) {
+		return;
+	}
+	Values.bits = (nValue != LOW);
+	Values.mask = 1;
+	ioctl(pLine->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &Values);
+}
+
+int GBxGPIORead(int nPin) {
+	struct GPIOLineStruct* pLine;
+	struct gpio_v2_line_values Values;
+
+	if (!szGPIOChip) {
+		return digitalRead(nPin);
+	}
+	pLine = GPIOFindLine(nPin);
+	Values.mask = 1;
+	if (!pLine || ioctl(pLine->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &Values) < 0) {
+		return HIGH;
+	}
+	return (Values.bits & 1) ? HIGH : LOW;
+}
+
+// Wait up to nTimeout_ms for an edge of an input (character device) or
+// sleep (wiringPi), then return the level. Edges are logged with the
+// kernel time stamp.
+int GBxGPIOWaitEdge(int nPin, int nTimeout_ms) {
+	struct GPIOLineStruct* pLine;
+	struct gpio_v2_line_event Event;
+	struct pollfd Poll;
+
+	if (!szGPIOChip || !(pLine = GPIOFindLine(nPin))) {
+		usleep(nTimeout_ms*1000);
+		return GBxGPIORead(nPin);
+	}
+	Poll.fd = pLine->fd;
+	Poll.events = POLLIN;
+	if (poll(&Poll, 1, nTimeout_ms) > 0) {
+		while (poll(&Poll, 1, 0) > 0 && sizeof(Event) == read(pLine->fd, &Event, sizeof(Event))) {
+			if (bLog) printf("GPIO %d %s edge at %llu.%09llu\n", nPin, (GPIO_V2_LINE_EVENT_FALLING_EDGE==Event.id) ? "falling" : "rising",
+			  (unsigned long long)Event.timestamp_ns/1000000000, (unsigned long long)Event.timestamp_ns%1000000000);
+		}
+	}
+	return GBxGPIORead(nPin);
+}
+
+//###########################################################
+
+static int I2CWrite(int fd, unsigned char Register, unsigned char Value) {
+	unsigned char buf[2];
+
+	nI2CTransactions++;
+	buf[0] = Register;
+	buf[1] = Value ;
+	if (write(fd, buf, 2) != 2) {
+		nI2CErrors++;
+		fprintf(stderr,
+		 "Failed to write byte to the i2c bus (%s)\n", strerror(errno));
+		return 0;
+	}
+	return 1;
+}
+
+static int I2CWriteWord(int fd, unsigned char Register, unsigned short Value) {
+	unsigned char buf[3];
+
+	nI2CTransactions++;
+	buf[0] = Register;
+	memcpy(&buf[1], &Value, 2);
+	if (write(fd, buf, 3) != 3) {
+		nI2CErrors++;
+		fprintf(stderr,
+		 "Failed to write word to the i2c bus (%s)\n", strerror(errno));
+		return 0;
+	}
+	return 2;
+}
+
+static int I2CRead(int fd, unsigned char Register, unsigned char* Value) {
+	
+	nI2CTransactions++;
+	if (write(fd, &Register, 1) != 1) {
+		nI2CErrors++;
+		fprintf(stderr,
+		 "Failed to write to the i2c bus (%s)\n", strerror(errno));
+		return 0;
+	}
+	if (read(fd, Value, 1) != 1) {
+		nI2CErrors++;
+		fprintf(stderr,
+		 "Failed to read byte from the i2c bus (%s)\n",strerror(errno));
+		return 0;
+	}
+	return 1;
+}
+
+
+static int I2CReadWord(int fd, unsigned char Register, unsigned short* Value) {
+	unsigned short ValueBuf = 0;
+	
+	nI2CTransactions++;
+	if (write(fd, &Register, 1) != 1) {
+		nI2CErrors++;
+		fprintf(stderr,
+		 "Failed to write to the i2c bus (%s)\n", strerror(errno));
+		return 0;
+	}
+	if (read(fd, &ValueBuf, 2) != 2) {
+		nI2CErrors++;
+		fprintf(stderr,
+		 "Failed to read word from the i2c bus (%s)\n",strerror(errno));
+		return 0;
+	}
+	*Value = ValueBuf;
+	return 2;
+}
+
+//Combined I2C transfer (I2C_RDWR): many register writes/reads of both ICs with one system call
+struct I2CBatchStruct {
+	struct i2c_msg Msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+	BYTE Buffer[I2C_RDWR_IOCTL_MAX_MSGS*4];
+	int nMsgs;
+	int nBufferPos;
+};
+
+static void I2CBatchInit(struct I2CBatchStruct* pBatch) {
+	pBatch->nMsgs = 0;
+	pBatch->nBufferPos = 0;
+}
+
+static BYTE* I2CBatchAdd(struct I2CBatchStruct* pBatch, unsigned int nSlaveAddr, int bRead, const BYTE* pData, int nLen) {
+	BYTE* pBuffer = &pBatch->Buffer[pBatch->nBufferPos];
+	struct i2c_msg* pMsg = &pBatch->Msgs[pBatch->nMsgs];
+
+	if (pBatch->nMsgs>=I2C_RDWR_IOCTL_MAX_MSGS || pBatch->nBufferPos+nLen>sizeof(pBatch->Buffer)) {
+		fprintf(stderr, "I2C batch overflow\n");
+		return NULL;
+	}
+	if (pData) {
+		memcpy(pBuffer, pData, nLen);
+	}
+	pMsg->addr = nSlaveAddr;
+	pMsg->flags = (bRead) ? I2C_M_RD : 0;
+	pMsg->len = nLen;
+	pMsg->buf = pBuffer;
+	pBatch->nMsgs++;
+	pBatch->nBufferPos += nLen;
+	return pBuffer;
+}
+
+static int I2CBatchWrite(struct I2CBatchStruct* pBatch, unsigned int nSlaveAddr, unsigned char Register, unsigned char Value) {
+	BYTE buf[2] = {Register, Value};
+	return I2CBatchAdd(pBatch, nSlaveAddr, 0, buf, 2) != NULL;
+}
+
+static int I2CBatchWriteWord(struct I2CBatchStruct* pBatch, unsigned int nSlaveAddr, unsigned char Register, unsigned short Value) {
+	BYTE buf[3] = {Register, Value & 0xFF, Value >> 8};
+	return I2CBatchAdd(pBatch, nSlaveAddr, 0, buf, 3) != NULL;
+}
+
+//returns the position of the read data, valid after I2CBatchFlush
+static BYTE* I2CBatchRead(struct I2CBatchStruct* pBatch, unsigned int nSlaveAddr, unsigned char Register, int nLen) {
+	if (!I2CBatchAdd(pBatch, nSlaveAddr, 0, &Register, 1)) {
+		return NULL;
+	}
+	return I2CBatchAdd(pBatch, nSlaveAddr, 1, NULL, nLen);
+}
+
+static int I2CBatchFlush(int fd, struct I2CBatchStruct* pBatch) {
+	struct i2c_rdwr_ioctl_data Transfer;
+
+	if (0==pBatch->nMsgs) {
+		return 1;
+	}
+	Transfer.msgs = pBatch->Msgs;
+	Transfer.nmsgs = pBatch->nMsgs;
+	nI2CTransactions += pBatch->nMsgs;
+	if (ioctl(fd, I2C_RDWR, &Transfer) < 0) {
+		nI2CErrors++;
+		fprintf(stderr,
+		 "Failed to transfer %d messages on the i2c bus (%s)\n", pBatch->nMsgs, strerror(errno));
+		I2CBatchInit(pBatch);
+		return 0;
+	}
+	I2CBatchInit(pBatch);
+	return 1;
+}
+
+static const int cnDumpBufferMaxAddress = 0x100/2;
+static WORD DumpBuffer[0x100/2];
+static BYTE* pDumpBuffer = (BYTE*) DumpBuffer;
+static BYTE RAMBuffer[0x20000]; //128 KB
+static int nRAMBufferSize;
+
+static WORD GBA_Last_LowAddress = 0;
+static BYTE GBA_Last_LowAddress_A = 0;
+static BYTE GBA_Last_LowAddress_B = 0;
+static BYTE GBA_Last_HighAddress = 0;
+
+
+static void SetAddress(int fd_X, int fd_Y, DWORD dwAddress, int bLog) {
+	WORD GBA_LowAddress = dwAddress & GBA_Low_Address_Mask;
+	BYTE GBA_LowAddress_A = dwAddress & GBA_Low_Address_A_Mask;
+	BYTE GBA_LowAddress_B = (dwAddress & GBA_Low_Address_B_Mask) >> 8;
+	BYTE GBA_HighAddress = (dwAddress & GBA_High_Address_Mask) >> 16;
+
+	if (fd_X && GBA_LowAddress != GBA_Last_LowAddress) {
+		if (GBA_Last_LowAddress_A !=  GBA_LowAddress_A) {
+			int bAD0_7_swap2 = (bAD0_7_AD8_15_swap)  ? bAD8_15_swap : bAD0_7_swap;
+			unsigned char value = (unsigned int) bAD0_7_swap2 ? revtable[GBA_LowAddress_A] : GBA_LowAddress_A;
+			if (bLog) printf("Address %X: Low Address Low BYTE=%X\n", (unsigned int) dwAddress, (unsigned int) value);
+			if (bAD0_7_AD8_15_swap) {
+				I2CWrite(fd_X, MCP_Write+MCP_PORTB, value);
+			} else {
+				I2CWrite(fd_X, MCP_Write+MCP_PORTA, value);
+			}
+		}
+		if (GBA_Last_LowAddress_B !=  GBA_LowAddress_B) {
+			int bAD8_15_swap2 = (bAD0_7_AD8_15_swap)  ? bAD0_7_swap : bAD8_15_swap;
+			unsigned char value = (unsigned int) bAD8_15_swap2 ? revtable[GBA_LowAddress_B] : GBA_LowAddress_B;
+			if (bLog) printf("Address %X: Low Address High BYTE=%X\n", (unsigned int) dwAddress, (unsigned int) value);
+			if (bAD0_7_AD8_15_swap) {
+				I2CWrite(fd_X, MCP_Write+MCP_PORTA, value);
+			} else {
+				I2CWrite(fd_X, MCP_Write+MCP_PORTB, value);
+			}
+		}
+		GBA_Last_LowAddress = GBA_LowAddress;
+		GBA_Last_LowAddress_A = GBA_LowAddress_A;
+		GBA_Last_LowAddress_B = GBA_LowAddress_B;
+	}
+	if (fd_Y && GBA_HighAddress != GBA_Last_HighAddress) {
+		unsigned char value = (unsigned int) bAD16_23_swap ? revtable[GBA_HighAddress] : GBA_HighAddress;
+		if (bLog) printf("Address %X: High Address BYTE=%X\n", (unsigned int) dwAddress, (unsigned int) value);
+		I2CWrite(fd_Y, MCP_Write + MCP_PORTA, value);
+		GBA_Last_HighAddress = GBA_HighAddress;
+	}
+}
+
+
+static WORD DecodeROMWord(WORD wRaw, int bSwapA, int bSwapB, int bSwapAB) {
+	BYTE nPortA = bSwapA ? revtable[wRaw & 0xFF] : (wRaw & 0xFF);
+	BYTE nPortB = bSwapB ? revtable[wRaw >> 8] : (wRaw >> 8);
+
+	return (bSwapAB) ? ((nPortA<<8) | nPortB) : ((nPortB<<8) | nPortA);
+}
+
+static WORD EncodeROMWord(WORD wData, int bSwapA, int bSwapB, int bSwapAB) {
+	BYTE nLow = wData & 0xFF;
+	BYTE nHigh = wData >> 8;
+	BYTE nPortA = (bSwapAB) ? nHigh : nLow;
+	BYTE nPortB = (bSwapAB) ? nLow : nHigh;
+
+	if (bSwapA) nPortA = revtable[nPortA];
+	if (bSwapB) nPortB = revtable[nPortB];
+	return (nPortB<<8) | nPortA;
+}
+
+
+static BYTE ReadAD0(int fd_X, int bLog) {
+	BYTE nDataRead, nData = 0;
+	int bSwap = 0;
+	char cPortName = '?'; 
+
+	if (bAD0_7_AD8_15_swap) {
+		//Bit 0 - Port B 
+		cPortName = 'B';
+		if (!I2CRead(fd_X, MCP_Read + MCP_PORTB, &nDataRead)) {
+			fprintf(stderr,
+			  "Failed to read byte to the i2c bus (%s)\n", strerror(errno));
+			return 0;
+		}
+		bSwap = bAD8_15_swap;
+	} else {
+		//Bit 0 - Port A 
+		cPortName = 'A';	
+		if (!I2CRead(fd_X, MCP_Read + MCP_PORTA, &nDataRead)) {
+			fprintf(stderr,
+			  "Failed to read byte to the i2c bus (%s)\n", strerror(errno));
+			return 0;
+		}
+		bSwap = bAD0_7_swap;
+	}
+	if (bSwap) {
+		nData = (nDataRead & 0x80) ? 1 : 0;
+	} else {
+		nData = (nDataRead & 0x01);	
+	}
+	if (bLog) printf("AD0 read %02X from X-%c, Data=%X\n", (int)nDataRead, cPortName, (int)nData);
+	return nData;
+}
+
+
+static int GetROMData(int fd_X, DWORD dwAddress, WORD *wData, int bLog) {
+	unsigned char* WordByteArray = (unsigned char*)wData;
+
+	if (!I2CReadWord(fd_X, MCP_Read + MCP_PORTA, wData)) {
+		printf("Error reading Data\n");
+		return 0;
+	}
+	unsigned char Byte0 = (unsigned int) bAD0_7_swap ? revtable[WordByteArray[0]] : WordByteArray[0];
+	unsigned char Byte1 = (unsigned int) bAD8_15_swap ? revtable[WordByteArray[1]] : WordByteArray[1];
+	if (bAD0_7_AD8_15_swap) {
+		WordByteArray[0] = Byte1;
+		WordByteArray[1] = Byte0;
+	} else {
+		WordByteArray[0] = Byte0;
+		WordByteArray[1] = Byte1;
+	}
+
+	if (bLog) printf("Address %X: Data=%X, byte=0x%02X%02X\n", (int)dwAddress, (int)*wData,
+	  (int)WordByteArray[0], (int)WordByteArray[1]);
+	return 1;
+}
+
+// Two reads of the latched word differ: read it again until the vote is decided
+static int GetROMDataVoted(int fd_X, DWORD dwAddress, WORD wData, WORD wData2, WORD* pwData) {
+	struct VoteStruct Vote;
+	WORD wRead;
+
+	VoteInit(&Vote, wData, wData2);
+	while (!VoteResult(&Vote, pwData)) {
+		if (!GetROMData(fd_X, dwAddress, &wRead, bLog)) {
+			return 0;
+		}
+		VoteAdd(&Vote, wRead);
+	}
+	return 1;
+}
+
+
+static int GetRAMData(int fd_Y, DWORD dwAddress, BYTE *nData, int bLog) {
+
+	if (!I2CRead(fd_Y, MCP_Read + MCP_PORTA, nData)) {
+		printf("Error reading Data");
+		return 0;
+	}
+	if (bAD16_23_swap)  {
+		*nData = revtable[*nData];
+	}
+	if (bLog) printf("Address %X: Data=%X\n", (int)dwAddress, (int)*nData);
+	return 1;
+}
+
+
+static void SetControlBit(int fd_Y, BYTE nBit) {
+	BYTE nByte = ControlByte | nBit;
+	if (I2CWrite(fd_Y, MCP_Write + MCP_PORTB, nByte) > 0) {
+		ControlByte = nByte;
+	}
+}
+
+static void ResetControlBit(int fd_Y, BYTE nBit) {
+	BYTE nByte = ControlByte & (~nBit);
+	if (I2CWrite(fd_Y, MCP_Write + MCP_PORTB, nByte) > 0) {
+		ControlByte = nByte;
+	}
+}
+
+static const char szGBARelaeseList[]= "gbalist.csv";
+
+static const char* GetCVSTextValue(char** ppSrcBuffer, const char *pSrcBufferMax, char* szDesBuffer, int nDesMaxSize) {
+	int nDesBufferPos = 0;
+	const char*	pDataPos = NULL;
+	char* pSrcBuffer = ppSrcBuffer[0];
+	
+	while (pSrcBuffer[0]=='\t' && pSrcBuffer<pSrcBufferMax) { //goto next column
+		pSrcBuffer++;
+	}
+	pDataPos = pSrcBuffer;
+	while (pSrcBuffer[0]!='\t' && pSrcBuffer<pSrcBufferMax) {
+		if (szDesBuffer && nDesBufferPos<nDesMaxSize) {
+			szDesBuffer[nDesBufferPos] = pSrcBuffer[0];
+			nDesBufferPos++;
+		}
+		pSrcBuffer = &pSrcBuffer[1];
+	}
+	if (szDesBuffer && nDesMaxSize>0) {
+		szDesBuffer[nDesBufferPos] = '\0';
+	}
+	ppSrcBuffer[0] = pSrcBuffer;
+	return pDataPos;
+ }
+ 
+static int GetCVSIntValue(char** pSrcBuffer, const char *pSrcBufferMax) {
+	const char* pDataPos = GetCVSTextValue(pSrcBuffer, pSrcBufferMax , NULL, 0);
+	
+	if (pDataPos) {
+		return atoi(pDataPos);
+	} else {
+		return 0;
+	}
+}
+
+static int DumpGBAEEPROM(int fd_X, int fd_Y, int nSize, int nROMSize, const char* szGameName) {
+	struct timeval tDumpStart, t2;
+	DWORD GBA_Address = 0x0000;
+	// 0xFFFF ... 64 KB
+	// 0x7FFF ... 32 KB
+	DWORD GBA_MaxAddress = 0x0000;
+	float fTimePerOperation;
+	double elapsedTime;
+	struct DumpFileStruct File;
+	int bGetChar = 0;
+	int BitLoop, BitLoopStart;
+	BYTE BitValue, BitValue2;
+	struct VoteStruct Vote;
+	WORD wResult;
+	BYTE Data[8];
+	char szGameFileName[12+4+3+1];
+	int b32MBROM;
+	DWORD nRetries = 0;
+	
+	if (512==nSize || 8192==nSize) {
+		GBA_MaxAddress = nSize/8; // 8 Byte per Address
+		b32MBROM = (32==nROMSize) ? 1 : 0;
+	} else {
+		printf("error invalid size\n");
+		return EXIT_FAILURE;
+	}
+
+	if (szGameName) {
+		strcpy(szGameFileName, szGameName);
+		strcat(szGameFileName, ".sav");
+		strcpy(szGameFileNameRAM, szGameFileName); 
+		printf("\n\n Save '%s' EEPROM to '%s' ...\n", szGameName, szGameFileName); 	
+	} else {
+		szGameFileName[0] = '\0';
+		printf("\n\n Read EEPROM  ..."); 		
+	}
+
+	nRAMBufferSize = 0;
+	memset(RAMBuffer,0,sizeof(RAMBuffer));
+
+	printf("  Size : %d Byte\n", nSize);
+	if (b32MBROM)	printf("  Special 32 MiB ROM + EEPROM Catridge\n\n");
+
+	printf("write direction IC1 Port A/B (AD0-AD15) to input, default ...\n");
+	I2CWriteWord(fd_X, MCP_Write, 0x0000);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT);
+
+	printf("write direction IC2 Port A (AD16-AD23) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTA, 0x00);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+
+	printf("write direction IC2 Port B (Control) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+	
+	printf("pull-up IC1 Port A,B  activate, default  ...\n");
+	I2CWriteWord(fd_X, MCP_PullUp, MCP_WON);
+	
+	printf("\nSet control byte to default\n");
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+
+	int LED_Duration=0;//ms
+	unsigned int LED_Limit=0;
+	int PercentFinished = 0;
+	fTimePerOperation=0;
+	gettimeofday(&tDumpStart, 0);
+	PercentFinished = 0;
+	for (GBA_Address=0x0000; GBA_Address<GBA_MaxAddress; GBA_Address++) {
+		if (GBA_Address % 0x8 == 0) {
+			int nDataBlock  = ((int)GBA_Address*0x8);
+			if (bConsoleProgress) printf("\n-> [%d0%%] %04d Byte (8 Byte per dot)", PercentFinished, nDataBlock);
+			JSONProgress("eeprom", "byte", GBA_Address*8, GBA_MaxAddress*8, nRetries, &tDumpStart);
+		}
+		if (end) break;
+		if (GPIO_LED) {
+			PercentFinished = (10*GBA_Address)/GBA_MaxAddress;
+			if (0==PercentFinished) {
+				PercentFinished = 1;
+			}
+			LED_Duration=3000-((3000*PercentFinished)/10);//ms
+			if (fTimePerOperation!=0) {
+				LED_Limit=LED_Duration*1000/fTimePerOperation;
+			} else {
+				LED_Limit=2000;
+			}
+			if (GBA_Address%LED_Limit>LED_Limit/2) {
+				if (LEDState!=LOW) {
+					LEDState=LOW;
+					GBxGPIOWrite(GPIO_LED, LEDState);
+				}
+			} else {
+				if (LEDState!=HIGH) {
+					LEDState=HIGH;
+					GBxGPIOWrite(GPIO_LED, LEDState);
+				}
+			}
+		}
+		if (bLog) printf("\n-> Set address %X serial\n", (int)GBA_Address);
+		if (bGetChar) getchar();
+
+		//----------write address start ------------------------------------
+		DWORD wBaseAddress;
+		if (b32MBROM) {
+			wBaseAddress = 0xFFFF80; //A07-A23 High -> EEPROM Enable
+		} else {
+			wBaseAddress = 0x800000; //AD23 High -> EEPROM Enable
+		} 
+		I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT); //Output
+		if (bLog) printf("EEPROM enable on");
+		SetAddress(fd_X, fd_Y, wBaseAddress+0x00, bLog);  //EEPROM enable
+		if (bGetChar) getchar();
+		if (bLog) printf("CD Low");
+		ResetControlBit(fd_Y, CONTROL_CS);		
+		if (bGetChar) getchar();
+
+		if (bLog) printf("\n-> Set address %X serial ... ", (int)GBA_Address);
+		SetAddress(fd_X, fd_Y, wBaseAddress+0x01, bLog);  //AD0 High - 1 - Start 1
+		ResetControlBit(fd_Y, CONTROL_WR);
+		if (bLog) printf(" 1 ");
+		SetControlBit(fd_Y, CONTROL_WR);
+		if (bGetChar) getchar();
+
+		SetAddress(fd_X, fd_Y, wBaseAddress+0x01, bLog);  //AD0 High - 2 - Start 2
+		ResetControlBit(fd_Y, CONTROL_WR);
+		if (bLog) printf(" 1 ");
+		SetControlBit(fd_Y, CONTROL_WR);
+		if (bGetChar) getchar();
+
+		if (512==nSize) {
+			BitLoopStart = 5; //4 KBit - 6 Bit
+		} else {
+			BitLoopStart = 13; //64 KBit - 14 Bit
+		}
+		for (BitLoop = BitLoopStart; BitLoop>=0; BitLoop--) { //4 Kbit or 64 KBit
+			if (GBA_Address & (1<<BitLoop)) {
+				BitValue = 0x01;
+			} else {
+				BitValue = 0x00;
+			}
+			SetAddress(fd_X, fd_Y, wBaseAddress+BitValue, bLog);   //AD0 High/Low - 3-8/3-16 - Data
+			ResetControlBit(fd_Y, CONTROL_WR);
+			if (bLog) printf(" %d ", BitValue);
+			SetControlBit(fd_Y, CONTROL_WR);
+			if (bGetChar) getchar();
+		}
+
+		SetAddress(fd_X, fd_Y, wBaseAddress+0x00, bLog);    //AD0 High - 9/17 - Stop
+		ResetControlBit(fd_Y, CONTROL_WR);
+		if (bLog) printf(" 0 ");
+		SetControlBit(fd_Y, CONTROL_WR);
+
+		if (bLog) printf("\nCS High\n");
+		SetControlBit(fd_Y, CONTROL_CS);
+		if (bGetChar) getchar();
+		//----------write address end --------------------------------------
+		memset(Data, 0, sizeof(Data));	  
+		//----------read address start -------------------------------------
+		if (bLog) printf("-> read address %X serial ... \n", (int)GBA_Address);	
+		ResetControlBit(fd_Y, CONTROL_CS);
+		if (bLog) printf("CS Low\n");
+		I2CWriteWord(fd_X, MCP_Direction , MCP_WINPUT); //Input
+		if (bGetChar) getchar();
+		
+		int ByteNo, BitNo;
+		for (BitLoop = 1; BitLoop<=68; BitLoop++) { //4Kbit = 64 bit reads per address (plus 4 ignore bits)
+			ByteNo = ((BitLoop-5) / 8);
+			BitNo  = 7-((BitLoop-5) % 8);
+			if (bRDviaGIOMode) {
+				GBxGPIOWrite(GPIO_RD, LOW);
+			} else {
+				ResetControlBit(fd_Y, CONTROL_RD);
+			}
+			BitValue = ReadAD0(fd_X, bLog);
+			if (bVerify) {
+				BitValue2 = ReadAD0(fd_X, bLog);
+				if (QualityCheck(QualityBusROM, wBaseAddress, BitValue, BitValue2)) {
+					nRetries++;
+					printf("-> error %hu<>%hu, verify ...", BitValue, BitValue2);
+					VoteInit(&Vote, BitValue, BitValue2);
+					while (!VoteResult(&Vote, &wResult)) {
+						VoteAdd(&Vote, ReadAD0(fd_X, bLog));
+					}
+					BitValue = wResult;
+					printf(" finally use %hu\n", BitValue);
+				} 
+			}
+			if (bGetChar) getchar();
+			if (bRDviaGIOMode) {
+				GBxGPIOWrite(GPIO_RD, HIGH);
+			} else {
+				SetControlBit(fd_Y, CONTROL_RD);
+			}
+			if (bGetChar) getchar();
+			if (BitLoop>4) {
+				if (BitValue) {
+					if (bLog) printf("Set Byte %d:%d (%02X)\n ", (int)ByteNo, (int)BitNo, (int) (0x01<<BitNo));
+					Data[ByteNo] |= (0x01<<BitNo);
+				}
+			} else {
+				if (bLog) printf("Ignore bit %d is %d\n", (int)BitLoop, (int)BitValue);
+			}
+			if (end) break;
+		}
+		if (bLog) printf("Address: %04X", (int)(GBA_Address) );
+		if (bLog) printf("\n%02X,%02X,%02X,%02X,", (int)Data[0], (int)Data[1], (int)Data[2], (int)Data[3]);
+		if (bLog) printf("%02X,%02X,%02X,%02X\n", (int)Data[4], (int)Data[5], (int)Data[6], (int)Data[7]);
+		memcpy(&RAMBuffer[nRAMBufferSize], Data, sizeof(Data));
+		nRAMBufferSize += sizeof(Data);
+		//----------read address end   -------------------------------------
+
+		if (bLog) printf("\nSet control byte to default and EEPROM enable off\n");
+		SetAddress(fd_X, fd_Y, 0x000000, bLog);  //AD0-AD23 Low
+		SetControlBit(fd_Y, ControlByteDefault);
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		}	
+		if (end) break;
+		if (bGetChar) getchar();
+		if (bConsoleProgress) printf(".");
+	}
+	printf("\n");
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tDumpStart.tv_sec)  + (t2.tv_usec - tDumpStart.tv_usec)/1000000.0;
+	ReportPhase("eeprom", "read", elapsedTime);
+
+	if (!end && GBA_Address==GBA_MaxAddress) {
+		int Min, Sec;
+		fTimePerOperation = elapsedTime * 1000000.0f / nRAMBufferSize / 8;
+		Min = elapsedTime/60;
+		Sec = (elapsedTime-60*Min)+0.5;
+		printf("dumping %d byte took %d min and %d sec (%g). (%.0f microsec. per operation)\n", nRAMBufferSize, Min, Sec, elapsedTime, fTimePerOperation);
+		
+		if (szGameFileName[0]!='\0') {
+			if (DumpFileOpen(&File, szGameFileName, GBxDataSave)) {
+				printf("Create RAM (EEPROM) dump to file '%s'", File.szFileName);
+				strcpy(szGameFileName, File.szFileName);
+				strcpy(szGameFileNameRAM, File.szFileName);
+				if (!DumpFileWrite(&File, RAMBuffer, nRAMBufferSize) | !DumpFileClose(&File)) {
+					perror("Error writing to ram dump file\n");
+				} else {
+					DumpFileFinished(&File);
+				}
+			} else {
+				perror("Could not create dump file");
+				ReportResult("eeprom", szGameFileName, nRAMBufferSize, CRC32(0xFFFFFFFF, RAMBuffer, nRAMBufferSize) ^ 0xFFFFFFFF, "failed", elapsedTime, fTimePerOperation, nRetries);
+				return(EXIT_FAILURE);
+			}
+		}
+		ReportResult("eeprom", szGameFileName, nRAMBufferSize, CRC32(0xFFFFFFFF, RAMBuffer, nRAMBufferSize) ^ 0xFFFFFFFF, "ok", elapsedTime, fTimePerOperation, nRetries);
+	} else {
+		ReportResult("eeprom", szGameFileName, nRAMBufferSize, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, nRetries);
+	}
+
+	return(EXIT_SUCCESS);
+}
+
+
+static int DumpGBARAM(int fd_X, int fd_Y, int nSize, const char* szGameName, BYTE nCSPin) {
+
+	struct timeval tDumpStart, t2;
+	DWORD GBA_Address = 0x00000000;
+	// 0xFFFF ... 2x64 KB Flash with bank switch
+	// 0xFFFF ... 64 KB
+	// 0x7FFF ... 32 KB
+	DWORD GBA_MaxAddress = 0;   
+	float fTimePerOperation;
+	double elapsedTime;
+	BYTE nData, nData2, nData3;
+	struct VoteStruct Vote;
+	WORD wResult;
+	struct DumpFileStruct File;
+	int bGetChar = 0;
+	char szGameFileName[12+4+3+1];
+	DWORD nRetries = 0;
+	const char* szArtifact = (nCSPin) ? "ram" : ((szGameName) ? "gb_rom" : "gb_header");
+
+	nRAMBufferSize = 0;
+	if (nSize>0 && nSize<=0x10000) {
+		GBA_MaxAddress = nSize;
+	} else {
+		printf("error invalid size\n");
+		return(EXIT_FAILURE);
+	}
+
+	if (szGameName) {
+		strcpy(szGameFileName, szGameName);
+		strcat(szGameFileName, ".sav");
+		strcpy(szGameFileNameRAM, szGameFileName);
+		printf("\n\n Save '%s' (S|F)RAM to '%s' ...\n", szGameName, szGameFileName); 	
+	}	else {	
+		szGameFileName[0] = '\0';
+		printf("\n\n Read (S|F)RAM  ...\n"); 		
+	}
+	
+	memset(RAMBuffer,0,sizeof(RAMBuffer));
+	printf("  Size : %d Byte\n\n", nSize); 
+
+	printf("write direction IC1 Port A/B (AD0-AD16) to output, default ...\n");
+	I2CWriteWord(fd_X, MCP_Write, 0x0000);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+
+	printf("write direction IC2 Port A (D0-D7) to input, default  ...\n");
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_INPUT);
+	printf("pull-up IC2 Port A (D0-D7) activate, default  ...\n");
+	I2CWrite(fd_Y, MCP_PullUp + MCP_PORTA, MCP_ON);
+
+
+	printf("write direction IC2 Port B (Control) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+
+	printf("Set control byte to default\n");
+	SetControlBit(fd_Y, ControlByteDefault);
+
+
+	int LED_Duration=0;//ms
+	unsigned int LED_Limit=0;
+	int PercentFinished = 0;
+	fTimePerOperation=0;
+	gettimeofday(&tDumpStart, 0);
+	PercentFinished = 0;
+	for (GBA_Address = 0x0000; GBA_Address<GBA_MaxAddress; GBA_Address++) {
+		if (GBA_Address % 0x2000 == 0) {
+			int nDataBlock  = ((int)GBA_Address / 0x400);
+			if (bConsoleProgress) printf("\n-> [%d0%%] %04d KB (1 KB per dot)", PercentFinished, nDataBlock);
+		} 
+		if (end) break;
+		if (GPIO_LED) {
+			PercentFinished = (10*GBA_Address)/GBA_MaxAddress;
+			if (0==PercentFinished) {
+				PercentFinished = 1;
+			}
+			LED_Duration=3000-((3000*PercentFinished)/10);//ms
+			if (fTimePerOperation!=0) {
+				LED_Limit=LED_Duration*1000/fTimePerOperation;
+			} else {
+				LED_Limit=2000;
+			}
+			if (GBA_Address%LED_Limit>LED_Limit/2) {
+				if (LEDState!=LOW) {
+					LEDState=LOW;
+					GBxGPIOWrite(GPIO_LED, LEDState);
+				}
+			} else {
+				if (LEDState!=HIGH) {
+					LEDState=HIGH;
+					GBxGPIOWrite(GPIO_LED, LEDState);
+				}
+			}
+		}
+
+		if (bLog) printf("-> Set address %X ...\n", (int)GBA_Address);
+		if (bGetChar) getchar();
+		SetAddress(fd_X, 0, GBA_Address, bLog);	
+		if (bLog) printf("-> Set CS (Bit %d) Low & RD Low ... ", nCSPin);
+		if (bGetChar) getchar();
+		ResetControlBit(fd_Y, CONTROL_RD | nCSPin);
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, LOW);
+		} 
+		if (!GetRAMData(fd_Y, GBA_Address, &nData, bLog)) {
+			break;
+		}
+		if (bVerify) {
+			if (!GetRAMData(fd_Y, GBA_Address, &nData2, bLog)) {
+				break;
+			}
+			if (QualityCheck(QualityBusByte, GBA_Address, nData, nData2)) {
+				nRetries++;
+				printf("-> error %hu<>%hu, verify ...", nData, nData2);
+				VoteInit(&Vote, nData, nData2);
+				while (!VoteResult(&Vote, &wResult) && GetRAMData(fd_Y, GBA_Address, &nData3, bLog)) {
+					VoteAdd(&Vote, nData3);
+				}
+				if (!VoteResult(&Vote, &wResult)) {
+					break;
+				}
+				nData = wResult;
+				printf(" finally use %hu\n", nData);
+			}
+		}
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		} 
+		SetControlBit(fd_Y, CONTROL_RD | nCSPin);
+		if (bLog) printf("-> Did CS2 High & RD High ... ");
+		if (bGetChar) getchar();
+		
+		RAMBuffer[GBA_Address] = nData;
+		nRAMBufferSize = GBA_Address + 1;
+		
+		if (GBA_Address % 0x400 == 0) {
+			if (GPIO_SW && GBA_Address>0x400 && GBxGPIORead(GPIO_SW)==LOW) {
+				printf("\ncancel dumping\n");
+				fflush(stdout);
+				while (!end && GBxGPIORead(GPIO_SW)==LOW){
+					usleep(500000);
+				} 
+				break;
+			} 
+			if (bConsoleProgress) {
+				printf(".");
+				fflush(stdout);
+			}
+			JSONProgress(szArtifact, "byte", GBA_Address, GBA_MaxAddress, nRetries, &tDumpStart);
+		}
+	}
+	printf("\nSet control byte to default\n");
+	if (bGetChar) getchar();
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tDumpStart.tv_sec)  + (t2.tv_usec - tDumpStart.tv_usec)/1000000.0;
+	ReportPhase(szArtifact, "read", elapsedTime);
+	if (!end && GBA_Address==GBA_MaxAddress) {
+		int Min, Sec;
+		DWORD crc = CRC32(0xFFFFFFFF, RAMBuffer, nRAMBufferSize) ^ 0xFFFFFFFF;
+		fTimePerOperation = elapsedTime * 1000000.0f / GBA_MaxAddress;
+		Min = elapsedTime/60;
+		Sec = (elapsedTime-60*Min)+0.5;
+		printf("dumping %ld KB took %d min and %d sec (%g). (%.0f microsec. per operation)\n", GBA_MaxAddress/1024, Min, Sec, elapsedTime, fTimePerOperation);
+		
+		if (szGameFileName[0]!='\0') {
+			if (DumpFileOpen(&File, szGameFileName, GBxDataSave)) {
+				printf("Create RAM dump to file '%s'", File.szFileName);
+				strcpy(szGameFileName, File.szFileName);
+				strcpy(szGameFileNameRAM, File.szFileName);
+				if (!DumpFileWrite(&File, &RAMBuffer, sizeof(nData)*nRAMBufferSize) | !DumpFileClose(&File)) {
+					perror("Error writing to ram dump file\n");
+				} else {
+					DumpFileFinished(&File);
+				}
+			} else {
+				perror("Could not create dump file");
+				ReportResult(szArtifact, szGameFileName, nRAMBufferSize, crc, "failed", elapsedTime, fTimePerOperation, nRetries);
+				return(EXIT_FAILURE);
+			}
+			ReportResult(szArtifact, szGameFileName, nRAMBufferSize, crc, "ok", elapsedTime, fTimePerOperation, nRetries);
+		}
+		return(EXIT_SUCCESS);
+	}
+	printf("\n");	
+	ReportResult(szArtifact, szGameFileName, nRAMBufferSize, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, nRetries);
+
+	return(EXIT_FAILURE);
+}
+
+//###########################################################
+// Byte bus: AD0-AD15 address, AD16-AD23 data (GBA SRAM/Flash, GB(C))
+
+#define BYTEBUS_READ_BATCH (I2C_RDWR_IOCTL_MAX_MSGS/3) //address, register, data message per byte
+static BYTE ByteBusVerifyBuffer[0x4000];
+
+//without console output for the cartridge polling of --auto-start
+static void ByteBusInitQuiet(int fd_X, int fd_Y) {
+	I2CWriteWord(fd_X, MCP_Write, 0x0000);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+	GBA_Last_LowAddress = 0;
+	GBA_Last_LowAddress_A = 0;
+	GBA_Last_LowAddress_B = 0;
+
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_INPUT);
+	I2CWrite(fd_Y, MCP_PullUp + MCP_PORTA, MCP_ON);
+
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+}
+
+static void ByteBusInit(int fd_X, int fd_Y) {
+	printf("write direction IC1 Port A/B (AD0-AD15) to output, default ...\n");
+	printf("write direction IC2 Port A (D0-D7) to input, pull-up ...\n");
+	printf("write direction IC2 Port B (Control) to output, default  ...\n");
+	ByteBusInitQuiet(fd_X, fd_Y);
+}
+
+//like SetAddress for AD0-AD15, but only queued into a batch
+static int BatchLowAddress(struct I2CBatchStruct* pBatch, WORD wAddress) {
+	BYTE nLow = wAddress & 0xFF;
+	BYTE nHigh = wAddress >> 8;
+	WORD wRaw = EncodeROMWord(wAddress, bAD0_7_swap, bAD8_15_swap, bAD0_7_AD8_15_swap);
+	int bPortA = (bAD0_7_AD8_15_swap) ? (nHigh != GBA_Last_LowAddress_B) : (nLow != GBA_Last_LowAddress_A);
+	int bPortB = (bAD0_7_AD8_15_swap) ? (nLow != GBA_Last_LowAddress_A) : (nHigh != GBA_Last_LowAddress_B);
+	int nRet = 1;
+
+	if (bPortA && bPortB) {
+		nRet = I2CBatchWriteWord(pBatch, SlaveAddr_IC1, MCP_Write, wRaw);
+	} else if (bPortA) {
+		nRet = I2CBatchWrite(pBatch, SlaveAddr_IC1, MCP_Write + MCP_PORTA, wRaw & 0xFF);
+	} else if (bPortB) {
+		nRet = I2CBatchWrite(pBatch, SlaveAddr_IC1, MCP_Write + MCP_PORTB, wRaw >> 8);
+	}
+	GBA_Last_LowAddress = wAddress;
+	GBA_Last_LowAddress_A = nLow;
+	GBA_Last_LowAddress_B = nHigh;
+	return nRet;
+}
+
+//address, data and *WR strobe (with *CS/*CS2) of a whole command sequence in one transfer
+static int ByteBusWrite(int fd_X, const WORD* pwAddress, const BYTE* pnData, int nCount, BYTE nCSPin) {
+	struct I2CBatchStruct Batch;
+	int nPos;
+
+	I2CBatchInit(&Batch);
+	I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+	for (nPos=0; nPos<nCount; nPos++) {
+		BYTE nDataRaw = bAD16_23_swap ? revtable[pnData[nPos]] : pnData[nPos];
+		if (bLog) printf("Write address %04X: Data=%02X\n", (int)pwAddress[nPos], (int)pnData[nPos]);
+		BatchLowAddress(&Batch, pwAddress[nPos]);
+		I2CBatchWriteWord(&Batch, SlaveAddr_IC2, MCP_Write, ((ControlByte & ~(CONTROL_WR | nCSPin))<<8) | nDataRaw);
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte);
+	}
+	I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Direction + MCP_PORTA, MCP_INPUT);
+	return I2CBatchFlush(fd_X, &Batch);
+}
+
+//*RD (and *CS/*CS2) stays low, the memory follows the address asynchronously
+static int ByteBusRead(int fd_X, int fd_Y, WORD wAddress, BYTE* pData, int nCount, BYTE nCSPin) {
+	struct I2CBatchStruct Batch;
+	BYTE* pRead[BYTEBUS_READ_BATCH];
+	int nPos, nBatch, nByte, nRet = 1;
+
+	ResetControlBit(fd_Y, CONTROL_RD | nCSPin);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, LOW);
+	}
+	I2CBatchInit(&Batch);
+	for (nPos=0; nPos<nCount; nPos+=nBatch) {
+		for (nBatch=0; nBatch<BYTEBUS_READ_BATCH && nPos+nBatch<nCount; nBatch++) {
+			BatchLowAddress(&Batch, wAddress+nPos+nBatch);
+			pRead[nBatch] = I2CBatchRead(&Batch, SlaveAddr_IC2, MCP_Read + MCP_PORTA, 1);
+		}
+		if (end || !I2CBatchFlush(fd_X, &Batch)) {
+			nRet = 0;
+			break;
+		}
+		for (nByte=0; nByte<nBatch; nByte++) {
+			pData[nPos+nByte] = bAD16_23_swap ? revtable[*pRead[nByte]] : *pRead[nByte];
+			if (bLog) printf("Address %X: Data=%X\n", (int)wAddress+nPos+nByte, (int)pData[nPos+nByte]);
+		}
+	}
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	SetControlBit(fd_Y, CONTROL_RD | nCSPin);
+	return nRet;
+}
+
+//with option f every block is read twice, differing bytes are read again and voted
+static int ByteBusReadVerified(int fd_X, int fd_Y, WORD wAddress, BYTE* pData, int nCount, BYTE nCSPin, DWORD* pnRetries) {
+	struct VoteStruct Vote;
+	WORD wResult;
+	int nPos;
+
+	if (!ByteBusRead(fd_X, fd_Y, wAddress, pData, nCount, nCSPin)) {
+		return 0;
+	}
+	if (!bVerify) {
+		return 1;
+	}
+	if (!ByteBusRead(fd_X, fd_Y, wAddress, ByteBusVerifyBuffer, nCount, nCSPin)) {
+		return 0;
+	}
+	for (nPos=0; nPos<nCount; nPos++) {
+		if (QualityCheck(QualityBusByte, wAddress+nPos, pData[nPos], ByteBusVerifyBuffer[nPos])) {
+			BYTE nData3;
+			(*pnRetries)++;
+			printf("-> error %hu<>%hu, verify ...", pData[nPos], ByteBusVerifyBuffer[nPos]);
+			VoteInit(&Vote, pData[nPos], ByteBusVerifyBuffer[nPos]);
+			while (!VoteResult(&Vote, &wResult)) {
+				if (!ByteBusRead(fd_X, fd_Y, wAddress+nPos, &nData3, 1, nCSPin)) {
+					return 0;
+				}
+				VoteAdd(&Vote, nData3);
+			}
+			pData[nPos] = wResult;
+			printf(" finally use %hu\n", pData[nPos]);
+		}
+	}
+	return 1;
+}
+
+//###########################################################
+// GBA Flash saves (64 KB, 128 KB with bank switch)
+
+static const struct FlashChipStruct {
+	BYTE nManufacturer;
+	BYTE nDevice;
+	int nSize;
+	const char* szName;
+} FlashChips[] = {
+	{0xBF, 0xD4, 0x10000, "SST 39VF512"},
+	{0xC2, 0x1C, 0x10000, "Macronix MX29L512"},
+	{0x32, 0x1B, 0x10000, "Panasonic MN63F805MNP"},
+	{0x1F, 0x3D, 0x10000, "Atmel AT29LV512"},
+	{0xC2, 0x09, 0x20000, "Macronix MX29L010"},
+	{0x62, 0x13, 0x20000, "Sanyo LE26FV10N1TS"},
+};
+
+static int FlashCommand(int fd_X, BYTE nCommand) {
+	WORD Address[3] = {0x5555, 0x2AAA, 0x5555};
+	BYTE Data[3] = {0xAA, 0x55, nCommand};
+
+	return ByteBusWrite(fd_X, Address, Data, 3, CONTROL_CS2);
+}
+
+static int FlashSelectBank(int fd_X, BYTE nBank) {
+	WORD Address[4] = {0x5555, 0x2AAA, 0x5555, 0x0000};
+	BYTE Data[4] = {0xAA, 0x55, 0xB0, nBank};
+
+	return ByteBusWrite(fd_X, Address, Data, 4, CONTROL_CS2);
+}
+
+static const struct FlashChipStruct* FlashGetChip(int fd_X, int fd_Y) {
+	BYTE ID[2];
+	int nChip;
+
+	FlashCommand(fd_X, 0x90); //enter ID mode
+	ByteBusRead(fd_X, fd_Y, 0x0000, ID, 2, CONTROL_CS2);
+	FlashCommand(fd_X, 0xF0); //exit ID mode
+	printf("  Flash ID: manufacturer 0x%02X, device 0x%02X", (unsigned int)ID[0], (unsigned int)ID[1]);
+	for (nChip=0; nChip<sizeof(FlashChips)/sizeof(FlashChips[0]); nChip++) {
+		if (FlashChips[nChip].nManufacturer==ID[0] && FlashChips[nChip].nDevice==ID[1]) {
+			printf(" (%s, %d KB)\n", FlashChips[nChip].szName, FlashChips[nChip].nSize/1024);
+			return &FlashChips[nChip];
+		}
+	}
+	printf(" (unknown)\n");
+	return NULL;
+}
+
+static int DumpGBAFlash(int fd_X, int fd_Y, int nSize, const char* szGameName) {
+	struct timeval tDumpStart, t2;
+	double elapsedTime;
+	float fTimePerOperation = 0;
+	struct DumpFileStruct File;
+	const struct FlashChipStruct* pChip;
+	char szGameFileName[12+4+3+1];
+	const int cnBlockSize = 0x1000;
+	DWORD nRetries = 0;
+	DWORD nAddress = 0;
+	int nBank, nBanks;
+
+	strcpy(szGameFileName, szGameName);
+	strcat(szGameFileName, ".sav");
+	strcpy(szGameFileNameRAM, szGameFileName);
+	printf("\n\n Save '%s' Flash to '%s' ...\n", szGameName, szGameFileName);
+
+	ByteBusInit(fd_X, fd_Y);
+	pChip = FlashGetChip(fd_X, fd_Y);
+	if (pChip && pChip->nSize!=nSize) {
+		printf("  Flash size %d Byte from chip ID instead of %d Byte\n", pChip->nSize, nSize);
+		nSize = pChip->nSize;
+	}
+	if (nSize!=0x10000 && nSize!=0x20000) {
+		printf("error invalid size\n");
+		return(EXIT_FAILURE);
+	}
+	printf("  Size : %d Byte\n\n", nSize);
+	nBanks = nSize / 0x10000;
+
+	nRAMBufferSize = 0;
+	memset(RAMBuffer,0,sizeof(RAMBuffer));
+	gettimeofday(&tDumpStart, 0);
+	for (nBank=0; nBank<nBanks && !end; nBank++) {
+		if (nBanks>1) {
+			if (bLog) printf("-> Flash bank %d\n", nBank);
+			FlashSelectBank(fd_X, nBank);
+		}
+		for (nAddress=0; nAddress<0x10000; nAddress+=cnBlockSize) {
+			if (nAddress % 0x2000 == 0 && bConsoleProgress) {
+				printf("\n-> [%d0%%] %04d KB (1 KB per dot)", (10*nRAMBufferSize)/nSize, nRAMBufferSize/0x400);
+			}
+			if (!ByteBusReadVerified(fd_X, fd_Y, nAddress, &RAMBuffer[nRAMBufferSize], cnBlockSize, CONTROL_CS2, &nRetries)) {
+				break;
+			}
+			nRAMBufferSize += cnBlockSize;
+			if (bConsoleProgress) {
+				printf("....");
+				fflush(stdout);
+			}
+			JSONProgress("ram", "byte", nRAMBufferSize, nSize, nRetries, &tDumpStart);
+		}
+		if (nAddress<0x10000) {
+			break;
+		}
+	}
+	if (nBanks>1) {
+		FlashSelectBank(fd_X, 0);
+	}
+	SetControlBit(fd_Y, ControlByteDefault);
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tDumpStart.tv_sec)  + (t2.tv_usec - tDumpStart.tv_usec)/1000000.0;
+	ReportPhase("ram", "read", elapsedTime);
+	if (!end && nRAMBufferSize==nSize) {
+		DWORD crc = CRC32(0xFFFFFFFF, RAMBuffer, nRAMBufferSize) ^ 0xFFFFFFFF;
+		int Min, Sec;
+
+		fTimePerOperation = elapsedTime * 1000000.0f / nSize;
+		Min = elapsedTime/60;
+		Sec = (elapsedTime-60*Min)+0.5;
+		printf("\ndumping %d KB took %d min and %d sec (%g). (%.0f microsec. per operation)\n", nSize/1024, Min, Sec, elapsedTime, fTimePerOperation);
+		if (!DumpFileOpen(&File, szGameFileName, GBxDataSave)) {
+			perror("Could not create dump file");
+			ReportResult("ram", szGameFileName, nRAMBufferSize, crc, "failed", elapsedTime, fTimePerOperation, nRetries);
+			return(EXIT_FAILURE);
+		}
+		printf("Create RAM (Flash) dump to file '%s'", File.szFileName);
+		strcpy(szGameFileName, File.szFileName);
+		strcpy(szGameFileNameRAM, File.szFileName);
+		if (!DumpFileWrite(&File, RAMBuffer, nRAMBufferSize) | !DumpFileClose(&File)) {
+			perror("Error writing to ram dump file\n");
+		} else {
+			DumpFileFinished(&File);
+		}
+		ReportResult("ram", szGameFileName, nRAMBufferSize, crc, "ok", elapsedTime, fTimePerOperation, nRetries);
+		return(EXIT_SUCCESS);
+	}
+	printf("\n");
+	ReportResult("ram", szGameFileName, nRAMBufferSize, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, nRetries);
+	return(EXIT_FAILURE);
+}
+
+typedef enum  {
+	RAMTypeUnknown = 0,
+	RAMTypeSRAM,
+	RAMTypeFLASH,
+	RAMTypeFLASH1M,
+	RAMTypeEEPROM,
+} RAMType;
+
+static struct GBAHeaderStruct{
+	DWORD GBA_MaxAddress;
+	DWORD nROMSize;
+	RAMType nRAMType;
+	int nRAMSizeByte;
+	char szGameName[12+1];
+	DWORD crc32;
+	int bListed;
+} GBAHeader;
+
+//Cartridge session: the probe decides GB(C) or GBA once per cycle, headers
+//read on the way are kept and reused by the dump functions
+static struct CartSessionStruct {
+	CartSystem nSystem;
+	BYTE GBHeader[0x150];   // GB(C) header 0x100-0x14F at its cart address
+	DWORD nGBAHeaderWords;  // GBA ROM words already in DumpBuffer
+} Session;
+
+//Save type detection: Nintendo's SDK libraries leave an ID string in the ROM,
+//an Aho-Corasick automaton finds all of them in a single pass over the dump
+static const struct SaveLibraryStruct {
+	const char* szID;
+	RAMType nRAMType;
+	int nRAMSizeByte;
+} SaveLibraries[] = {
+	//in order of priority
+	{"FLASH1M_V",  RAMTypeFLASH1M, 0x20000},
+	{"FLASH512_V", RAMTypeFLASH,   0x10000},
+	{"FLASH_V",    RAMTypeFLASH,   0x10000},
+	{"EEPROM_V",   RAMTypeEEPROM,  0},    //size is not part of the ID, EEPROMDetectSize
+	{"SRAM_F_V",   RAMTypeSRAM,    0x8000},
+	{"SRAM_V",     RAMTypeSRAM,    0x8000},
+};
+#define SAVESCAN_MAX_STATES 64
+static BYTE SaveScanDelta[SAVESCAN_MAX_STATES][256];
+static BYTE SaveScanOutput[SAVESCAN_MAX_STATES];
+static BYTE SaveScanState = 0;
+static BYTE SaveScanFound = 0;
+
+static void SaveScanInit() {
+	BYTE Fail[SAVESCAN_MAX_STATES];
+	BYTE Queue[SAVESCAN_MAX_STATES];
+	int nStates = 1, nHead = 0, nTail = 0;
+	int nPattern, nChar, nState;
+
+	//trie, 0 = no transition yet (state 0 is the root)
+	memset(SaveScanDelta, 0, sizeof(SaveScanDelta));
+	memset(SaveScanOutput, 0, sizeof(SaveScanOutput));
+	for (nPattern=0; nPattern<sizeof(SaveLibraries)/sizeof(SaveLibraries[0]); nPattern++) {
+		const BYTE* pChar = (const BYTE*)SaveLibraries[nPattern].szID;
+		nState = 0;
+		for (; *pChar; pChar++) {
+			if (!SaveScanDelta[nState][*pChar]) {
+				SaveScanDelta[nState][*pChar] = nStates++;
+			}
+			nState = SaveScanDelta[nState][*pChar];
+		}
+		SaveScanOutput[nState] |= 1<<nPattern;
+	}
+	//breadth first: failure links and the complete transition table (DFA)
+	Fail[0] = 0;
+	for (nChar=0; nChar<256; nChar++) {
+		if (SaveScanDelta[0][nChar]) {
+			Fail[SaveScanDelta[0][nChar]] = 0;
+			Queue[nTail++] = SaveScanDelta[0][nChar];
+		}
+	}
+	while (nHead<nTail) {
+		nState = Queue[nHead++];
+		SaveScanOutput[nState] |= SaveScanOutput[Fail[nState]];
+		for (nChar=0; nChar<256; nChar++) {
+			BYTE nNext = SaveScanDelta[nState][nChar];
+			if (nNext) {
+				Fail[nNext] = SaveScanDelta[Fail[nState]][nChar];
+				Queue[nTail++] = nNext;
+			} else {
+				SaveScanDelta[nState][nChar] = SaveScanDelta[Fail[nState]][nChar];
+			}
+		}
+	}
+	SaveScanState = 0;
+	SaveScanFound = 0;
+}
+
+static void SaveScanWord(WORD wData) {
+	SaveScanState = SaveScanDelta[SaveScanState][wData & 0xFF];
+	SaveScanFound |= SaveScanOutput[SaveScanState];
+	SaveScanState = SaveScanDelta[SaveScanState][wData >> 8];
+	SaveScanFound |= SaveScanOutput[SaveScanState];
+}
+
+static int SaveScanResult(RAMType* pnRAMType, int* pnRAMSizeByte) {
+	int nPattern;
+
+	for (nPattern=0; nPattern<sizeof(SaveLibraries)/sizeof(SaveLibraries[0]); nPattern++) {
+		if (SaveScanFound & (1<<nPattern)) {
+			*pnRAMType = SaveLibraries[nPattern].nRAMType;
+			*pnRAMSizeByte = SaveLibraries[nPattern].nRAMSizeByte;
+			return nPattern+1;
+		}
+	}
+	return 0;
+}
+
+
+
+static int DumpGBAROMHeader(int fd_X, int fd_Y) {
+	struct timeval tDumpStart, t2;	
+	DWORD GBA_Address = 0x00000000;
+	double elapsedTime;
+	int nRAMSizeByte = 0;
+	RAMType nRAMType = RAMTypeUnknown;
+	char szCRC32[8+1];
+	BYTE bGetChar = 0;
+	char szGameName[12+1];
+	unsigned int crcvalue = 0;
+	int bLogoValid = 0, bComplementValid = 0;
+	char szJSONName[64], szJSONCode[32];
+	
+	printf("\nreading GBA ROM Header ...\n");
+		
+	printf("write direction IC1 Port A/B (AD0-AD16) to output, default ...\n");
+	I2CWriteWord(fd_X, MCP_Write, 0x0000);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+
+	printf("write direction IC2 Port A (A16-A23) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTA, 0x00);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+
+	printf("write direction IC2 Port B (Control) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write  + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+
+	memset(&GBAHeader, 0, sizeof(GBAHeader));
+	memset(DumpBuffer, 0, sizeof(DumpBuffer));
+	gettimeofday(&tDumpStart, 0);
+	for (GBA_Address = 0x00000000; GBA_Address<cnDumpBufferMaxAddress; GBA_Address++) {	
+		if (end) break;
+		if (!bAutoAddressMode || 0x00000000 == GBA_Address) {
+			if (bLog) printf("-> Set CS,RD high\n");
+			if (bGetChar) getchar();
+			SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);//CS_High, RD_High
+			if (bRDviaGIOMode) {
+				GBxGPIOWrite(GPIO_RD, HIGH); // RD_High
+			}
+			
+			if (bLog) printf("-> set AD Port to output\n");
+			if (bGetChar) getchar();
+			I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT); //SetOutputDirection Address
+
+			if (bLog) printf("-> Set address %X\n", (int)GBA_Address);
+			if (bGetChar) getchar();
+			SetAddress(fd_X, fd_Y, GBA_Address, bLog);
+
+			if (bLog) printf("-> Set CS low\n");
+			if (bGetChar) getchar();
+			ResetControlBit(fd_Y, CONTROL_CS);//CS_Low
+
+			if (bLog) printf("-> set AD Port to input\n");
+			if (bGetChar) getchar();
+			if (!I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT)) {
+				break;
+			}			
+		} else {
+			if (bLog) printf("-> Set RD high\n");
+			if (bGetChar) getchar();
+			if (bRDviaGIOMode) {
+				GBxGPIOWrite(GPIO_RD, HIGH); // RD_High
+			} else {
+				SetControlBit(fd_Y, CONTROL_RD);// RD_High
+			};
+		}
+
+		if (bLog) printf("-> set RD low\n");
+		if (bGetChar) getchar();
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, LOW); // RD_Low
+		} else {
+			ResetControlBit(fd_Y, CONTROL_RD);
+		}
+
+		if (bLog) printf("-> get data\n");
+		if (bGetChar) getchar();
+		WORD wData, wData2;
+		if (!GetROMData(fd_X, GBA_Address, &wData, bLog))
+			break;
+		if (bVerify & !bAutoAddressMode) {
+			if (!GetROMData(fd_X, GBA_Address, &wData2, bLog))
+				break;
+			if (QualityCheck(QualityBusROM, GBA_Address, wData, wData2)) {
+				printf("-> error %hu<>%hu, verify ...", wData, wData2);
+				if (!GetROMDataVoted(fd_X, GBA_Address, wData, wData2, &wData))
+					break;
+				printf(" finally use %hu\n", wData);
+			}
+		}
+		DumpBuffer[GBA_Address] = wData;
+	}
+	gettimeofday(&t2, 0);	
+	printf("\nSet control byte to default\n");
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+
+	if (GBA_Address>=cnDumpBufferMaxAddress-1 && !end) {
+		char GameCode[4+1];
+		char GameCodeEx[9+1];
+
+		memset(szGameName, 0, sizeof(szGameName));
+		memset(GameCodeEx, 0, sizeof(GameCodeEx));
+		strncpy(szGameName, (char*)&pDumpBuffer[0xA0], 12);
+		printf("\n\n  Game  : %s", szGameName); 
+
+		memset(GameCode,0,sizeof(GameCode));
+		strncpy(GameCode, (char*)&pDumpBuffer[0xAC],4);
+		printf("\n  GameCode  : %s", GameCode); 
+		strcpy(GameCodeEx, "AGB-");
+		strcat(GameCodeEx, GameCode);
+		strcat(GameCodeEx, "-");
+
+		printf("\n  Header: ");
+		if (!memcmp(Logo, &pDumpBuffer[0x04], sizeof(Logo)-4)) {
+			bLogoValid = 1;
+			printf("valid ");
+		} else {
+			printf("invalid ");
+		}
+		printf("\n  Header Complement (checksum): ");
+		WORD wChecksum = 0xFF00;
+		int nAddress;
+		for (nAddress=0xA0;  nAddress<=0xBC; nAddress++) {
+			wChecksum-=pDumpBuffer[nAddress];
+		}
+		wChecksum -= 0x19;
+		wChecksum &= 0x00FF;
+		if (wChecksum == pDumpBuffer[0xBD]) {
+			bComplementValid = 1;
+			printf("valid (0x%x)",(unsigned int)wChecksum);
+		} else {
+			printf("invalid (calc 0x%X, found 0x%X)", (unsigned int)wChecksum, (unsigned int)pDumpBuffer[0xBD]);
+		}
+		fflush(stdout);	
+		char* pPos = NULL;
+		if (GBARelaeseListBuffer) {
+			pPos = strstr(GBARelaeseListBuffer, GameCodeEx);
+		}
+		if (pPos) {
+			char szComplement[2+1];
+			char szMemoryType[20+1];
+			char szGameCodeFull[12+1];
+			DWORD GBA_MaxAddress;
+			const char* pSrcBufferMax = &GBARelaeseListBuffer[GBARelaeseListBufferSize];
+
+			GetCVSTextValue(&pPos, pSrcBufferMax, szGameCodeFull, 12);
+			printf("\n\n  Gamecode gbalist: %s ", szGameCodeFull);
+
+			int nROMSizeMBit = GetCVSIntValue(&pPos, pSrcBufferMax);
+			int nROMSizeMB = nROMSizeMBit / 8;
+			GBA_MaxAddress = nROMSizeMB * 1024 * 1024 / 2; //16 bit per Address
+			printf("\n  ROM Size: %d MBit (%d MByte, max dump address 0x%X)", nROMSizeMBit, nROMSizeMB, (int)GBA_MaxAddress);
+			GetCVSTextValue(&pPos, pSrcBufferMax, szComplement, 2);
+			printf("\n  Complement: 0x%s", szComplement);
+
+			GetCVSTextValue(&pPos, pSrcBufferMax, szCRC32, 8);
+			if (szCRC32[0]!='\0') {
+				sscanf(szCRC32,"%x", &crcvalue);
+				printf("\n  CRC32: 0x%s (0x%X)", szCRC32, crcvalue);
+			}
+
+			GetCVSTextValue(&pPos, pSrcBufferMax, szMemoryType, 20);
+			if (!strncmp(szMemoryType, "SRAM", 4)) {
+				nRAMType = RAMTypeSRAM;
+			} else	if (!strncmp(szMemoryType, "FLASH1M", 7)) {
+				nRAMType = RAMTypeFLASH1M; 
+			} else	if (!strncmp(szMemoryType, "FLASH", 5)) {
+				nRAMType = RAMTypeFLASH;
+			} else	if (!strncmp(szMemoryType, "EEPROM", 6)) {
+				nRAMType = RAMTypeEEPROM;
+			} else {
+				nRAMType = RAMTypeUnknown;
+			};
+			printf("\n  RAM type: %s (%d)", szMemoryType, nRAMType);
+
+
+			int nRAMSizeKBit = GetCVSIntValue(&pPos, pSrcBufferMax);
+			int nRAMSizeKB = nRAMSizeKBit / 8;
+			nRAMSizeByte = nRAMSizeKBit * 1024 / 8;
+			if (nRAMSizeKBit>=8) {
+				printf("\n  RAM size: %d kBit (%d KByte)", nRAMSizeKBit, nRAMSizeKB);
+			} else {
+				printf("\n  RAM size: %d kBit (%d Byte)", nRAMSizeKBit, nRAMSizeByte);
+			}
+			
+			GBAHeader.GBA_MaxAddress = GBA_MaxAddress;
+			GBAHeader.nROMSize = nROMSizeMB;
+			GBAHeader.crc32 = crcvalue;
+			GBAHeader.nRAMType = nRAMType;
+			GBAHeader.nRAMSizeByte = nRAMSizeByte;
+			GBAHeader.bListed = 1;
+		} else {
+			printf("gamecode '%s' not found, type and size unknown", GameCodeEx);			
+		}
+		strcpy(GBAHeader.szGameName, (szGameName[0]!='\0') ? szGameName : "UNKNOWN");
+		DatBegin(GBAHeader.szGameName, GameCode);
+		if (GBA_Address==cnDumpBufferMaxAddress) {
+			Session.nSystem = CartSystemGBA;
+			Session.nGBAHeaderWords = cnDumpBufferMaxAddress;
+		}
+		printf("\n");
+		elapsedTime = (t2.tv_sec - tDumpStart.tv_sec)  + (t2.tv_usec - tDumpStart.tv_usec)/1000000.0;
+		printf("dumping header took (%g) sec\n", elapsedTime);		
+		JSONEmit("\"event\":\"header\",\"system\":\"gba\",\"game\":\"%s\",\"code\":\"%s\",\"logo_valid\":%s,\"complement_valid\":%s,\"listed\":%s,\"rom_size\":%lu,\"ram_type\":%d,\"ram_size\":%d,\"crc32_list\":\"%08X\"",
+		  JSONString(szJSONName, sizeof(szJSONName), szGameName), JSONString(szJSONCode, sizeof(szJSONCode), GameCode),
+		  bLogoValid ? "true" : "false", bComplementValid ? "true" : "false", pPos ? "true" : "false",
+		  GBAHeader.GBA_MaxAddress*2, (int)GBAHeader.nRAMType, GBAHeader.nRAMSizeByte, crcvalue);
+		ReportPhase("header", "read", elapsedTime);
+	}
+	fflush(stdout);
+	return (bComplementValid) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+//###########################################################
+
+// Latch dwAddress and read it, the cart stays selected with RD low so
+// auto increment continues with the following address.
+static int ReadROMWordExplicit(int fd_X, int fd_Y, DWORD dwAddress, WORD* pwData) {
+	SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+	SetAddress(fd_X, fd_Y, dwAddress, bLog);
+	ResetControlBit(fd_Y, CONTROL_CS);
+	if (!I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT)) {
+		return 0;
+	}
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, LOW);
+	} else {
+		ResetControlBit(fd_Y, CONTROL_RD);
+	}
+	return GetROMData(fd_X, dwAddress, pwData, bLog);
+}
+
+// Words of the ROM stream that can no longer be read again go to the dump
+// file and the archive
+static int DumpGBAROMCommit(struct DumpFileStruct* pFile, const WORD* pwData, DWORD nWords) {
+	ArchiveWrite((const BYTE*)pwData, nWords*sizeof(WORD));
+	return DumpFileWrite(pFile, pwData, nWords*sizeof(WORD));
+}
+
+static int DumpGBAROM(int fd_X, int fd_Y, const char* szGameName) {
+	struct timeval tDumpStart, t2, t3;	
+	DWORD GBA_Address = 0x00000000;
+	// 0x1000000 ... 32 MB
+	// 0x0800000 ... 16 MB
+	// 0x0400000 ...  8 MB
+	// 0x0200000 ...  4 MB
+	// 0x0080000 ...512 kB
+	DWORD GBA_MaxAddress = 0x2000;   //  8 kB .. include header	
+	float fTimePerOperation;
+	double elapsedTime;
+	DWORD crc = 0xFFFFFFFF;
+	DWORD crc_list = 0x00000000;
+	DWORD nRetries = 0;
+	DWORD nStartAddress;
+	// auto address mode: state after the last word confirmed by a spot check
+	DWORD GoodAddress, GoodCRC;
+	BYTE GoodScanState, GoodScanFound;
+	DWORD RelatchAddress;
+	int nSpotRetries = 0;
+	const int cnSpotCheckRetries = 3;
+	// words not yet written, the last part can still be read again
+	WORD* pPending;
+	DWORD nPending = 0, nPendingMax;
+	int bWriteError;
+	struct DumpFileStruct File;
+	
+	printf("\nreading ROM ...\n");
+		
+	printf("write direction IC1 Port A/B (AD0-AD16) to output, default ...\n");
+	I2CWriteWord(fd_X, MCP_Write, 0x0000);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+
+	printf("write direction IC2 Port A (A16-A23) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTA, 0x00);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+
+	printf("write direction IC2 Port B (Control) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write  + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+
+	if (Force_GBA_MaxAddress) {
+		GBA_MaxAddress = Force_GBA_MaxAddress;
+	} else {
+		AddrOffset = 0;
+		if (GBAHeader.bListed) {
+			GBA_MaxAddress = GBAHeader.GBA_MaxAddress;
+		}
+	}
+	crc_list = GBAHeader.crc32;
+	nStartAddress = AddrOffset;
+
+	int bGetChar = 0;
+	const char cszFilename[] = "game.gba";
+	char szGameFileName[12+4+1];
+
+	strcpy(szGameFileName, szGameName);
+	strcat(szGameFileName, ".gba");
+	strcpy(szGameFileNameROM, szGameFileName);
+	printf("Game  : %s (Save: %s)\n", szGameName, szGameFileName); 
+	if (!GBAHeader.bListed && !Force_GBA_MaxAddress) {
+		//this cartridge only, the next one is dumped as usual
+		ReportResult("rom", szGameFileName, 0, 0, "size_unknown", 0, 0, 0);
+		GBxReportError(GBxErrorCartridge, "gamecode not found in gbalist, size unknown (please set dump size, option z)");
+		return EXIT_FAILURE;
+	}
+	nPendingMax = (SpotCheckInterval) ? SpotCheckInterval : 0x1000;
+	pPending = malloc(nPendingMax*sizeof(WORD));
+	if (!pPending) {
+		GBxReportError(GBxErrorDump, "Could not allocate the spot check buffer");
+		return EXIT_FAILURE;
+	}
+	if (!DumpFileOpen(&File, cszFilename, GBxDataROM)) {
+		GBxReportError(GBxErrorDump, "Could not create file '%s', error %d!", cszFilename, errno);
+		free(pPending);
+		return EXIT_FAILURE;
+	}
+	printf("Write dump to file '%s', ", File.szFileName);
+
+	if (!GBAHeader.bListed) {
+		printf("\ngamecode not found in gbalist, size unknown, using dump size %lu kB\n", Force_GBA_MaxAddress*2/1024);
+	}
+
+	int LED_Duration=0;//ms
+	unsigned int LED_Limit=0;
+	int PercentFinished = 0;
+	fTimePerOperation=0;
+	SaveScanInit();
+	ArchiveBegin();
+	gettimeofday(&tDumpStart, 0);
+	//header words were read by DumpGBAROMHeader, continue after them
+	if (0==AddrOffset && !end) {
+		for (GBA_Address = 0x00000000; GBA_Address<Session.nGBAHeaderWords && GBA_Address<GBA_MaxAddress; GBA_Address++) {
+			crc = CRC32_WORD(crc, DumpBuffer[GBA_Address]);
+			SaveScanWord(DumpBuffer[GBA_Address]);
+		}
+		if (!DumpGBAROMCommit(&File, DumpBuffer, GBA_Address)) {
+			printf("Error wirting to file %s\n", File.szFileName);
+			DumpFileClose(&File);
+			free(pPending);
+			Archive.bActive = 0;
+			ReportResult("rom", File.szFileName, 0, 0, "failed", 0, 0, nRetries);
+			return(EXIT_FAILURE);
+		}
+		nStartAddress = GBA_Address;
+	}
+	RetryRegionReset();
+	GoodAddress = RelatchAddress = nStartAddress;
+	GoodCRC = crc;
+	GoodScanState = SaveScanState;
+	GoodScanFound = SaveScanFound;
+	for (GBA_Address = nStartAddress; GBA_Address<GBA_MaxAddress; GBA_Address++) {
+		// the cart increments only A0-A15, latch again at each 128 KiB boundary
+		int bExplicitRegion = RetryRegionExplicit(GBA_Address);
+		int bLatch = !bAutoAddressMode || bExplicitRegion || RelatchAddress == GBA_Address || 0 == (GBA_Address & 0xFFFF);
+
+		if (GPIO_LED) {
+			PercentFinished = (10*GBA_Address)/GBA_MaxAddress;
+			if (0==PercentFinished) {
+				PercentFinished=1;
+			}
+			LED_Duration=3000-((3000*PercentFinished)/10);//ms
+			if (fTimePerOperation!=0) {
+				LED_Limit=LED_Duration*1000/fTimePerOperation;
+			} else {
+				LED_Limit=2000;
+			}
+			if (GBA_Address%LED_Limit>LED_Limit/2) {
+				if (LEDState!=LOW) {
+					LEDState=LOW;
+					GBxGPIOWrite(GPIO_LED, LEDState);
+				}
+			} else {
+				if (LEDState!=HIGH) {
+					LEDState=HIGH;
+					GBxGPIOWrite(GPIO_LED, LEDState);
+				}
+			}
+		}
+
+		if (GBA_Address % 0x8000 == 0 || nStartAddress == GBA_Address) {
+			if(GBA_Address == 0x8000) {
+				gettimeofday(&t2, 0);
+			}
+			if(GBA_Address == 0x10000) {
+				gettimeofday(&t3, 0);
+				elapsedTime = (t3.tv_sec - t2.tv_sec)  + (t3.tv_usec - t2.tv_usec)/1000000.0;
+				fTimePerOperation = elapsedTime * 1000000.0f / 0x8000;
+				printf("\n  Speed: dumping %d kB took %.1f sec. (%.0f microsec. per operation), full dump will take %.1f min", 0x8000*2/1024, elapsedTime, fTimePerOperation, elapsedTime/0x8000*(GBA_MaxAddress-0x10000)/60);
+			}
+			int nDataBlock  = ((int)GBA_Address / 0x8000)*32*sizeof(WORD);
+			if (bConsoleProgress) {
+				printf("\n-> [%d0%%] %04d KB (%d KB per dot)", PercentFinished, nDataBlock, (int) (0x1000/0x400*sizeof(WORD)) ); 
+				fflush(stdout);
+			}
+		}
+		if (bLatch) {
+			if (end) break;
+			if (bLog) printf("-> Set CS,RD high\n");
+			if (bGetChar) getchar();
+			SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);//CS_High, RD_High
+			if (bRDviaGIOMode) {
+				GBxGPIOWrite(GPIO_RD, HIGH); // RD_High
+			}
+		} else {
+			if (end) break;
+			if (bLog) printf("-> Set RD high\n");
+			if (bGetChar) getchar();
+			if (bRDviaGIOMode) {
+				GBxGPIOWrite(GPIO_RD, HIGH); // RD_High
+				//usleep(1);
+			} else {
+				SetControlBit(fd_Y, CONTROL_RD);// RD_High
+			}
+		}
+		if (bLatch) {
+			if (end) break;
+			if (bLog) printf("-> set AD Port to output\n");
+			if (bGetChar) getchar();
+			I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT); //SetOutputDirection Address
+
+			if (end) break;
+			if (bLog) printf("-> Set address %X\n", (int)GBA_Address);
+			if (bGetChar) getchar();
+			SetAddress(fd_X, fd_Y, GBA_Address, bLog);
+
+			if (end) break;
+			if (bLog) printf("-> Set CS low\n");
+			if (bGetChar) getchar();
+			ResetControlBit(fd_Y, CONTROL_CS);//CS_Low
+
+			if (end) break;
+			if (bLog) printf("-> set AD Port to input\n");
+			if (bGetChar) getchar();
+			if (!I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT)) {
+				break;
+			}
+		}
+
+		if (end) break;
+		if (bLog) printf("-> set RD low\n");
+		if (bGetChar) getchar();
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, LOW); // RD_Low
+		} else {
+			ResetControlBit(fd_Y, CONTROL_RD);
+		}
+
+		if (end) break;
+		if (bLog) printf("-> get data\n");
+		if (bGetChar) getchar();
+		WORD wData, wData2;
+		if (!GetROMData(fd_X, GBA_Address, &wData, bLog)) {
+			break;
+		}
+		//option f: every word, no suspicion needed (see Retry policy)
+		if ((bVerify && !bAutoAddressMode) || bExplicitRegion) {
+			if (!GetROMData(fd_X, GBA_Address, &wData2, bLog)) {
+				break;
+			}
+			if (QualityCheck(QualityBusROM, GBA_Address, wData, wData2)) {
+				nRetries++;
+				printf("-> error %hu<>%hu, verify ...", wData, wData2);
+				if (!GetROMDataVoted(fd_X, GBA_Address, wData, wData2, &wData)) {
+					break;
+				}
+				printf(" finally use %hu\n", wData);
+			}
+		}
+		if (GBA_Address<cnDumpBufferMaxAddress) {
+			DumpBuffer[GBA_Address] = wData;
+		}
+
+		crc = CRC32_WORD(crc, wData);
+		SaveScanWord(wData);
+
+		pPending[nPending++] = wData;
+		if (SpotCheckInterval && 0 == (GBA_Address+1) % SpotCheckInterval) {
+			WORD wCheck = wData;
+			// explicit regions are already verified word by word
+			if (!bExplicitRegion) {
+				if (!ReadROMWordExplicit(fd_X, fd_Y, GBA_Address, &wCheck)) {
+					break;
+				}
+				QualityCheck(QualityBusROM, GBA_Address, wData, wCheck);
+			}
+			if (wCheck != wData && nSpotRetries < cnSpotCheckRetries) {
+				// lost sync (or unstable bits) since the last good check, read that part again
+				nSpotRetries++;
+				nRetries++;
+				printf("\n-> spot check 0x%X failed (0x%04X<>0x%04X), reading again from 0x%X", (int)GBA_Address, (int)wData, (int)wCheck, (int)GoodAddress);
+				RetryRegionError(GoodAddress, GBA_Address);
+				crc = GoodCRC;
+				SaveScanState = GoodScanState;
+				SaveScanFound = GoodScanFound;
+				nPending = 0;
+				RelatchAddress = GoodAddress;
+				GBA_Address = GoodAddress-1;
+				continue;
+			}
+			if (wCheck != wData) {
+				printf("\n-> spot check 0x%X failed %d times, continuing", (int)GBA_Address, nSpotRetries+1);
+			}
+			nSpotRetries = 0;
+			GoodAddress = GBA_Address+1;
+			GoodCRC = crc;
+			GoodScanState = SaveScanState;
+			GoodScanFound = SaveScanFound;
+		}
+		if (nPending==nPendingMax || GoodAddress==GBA_Address+1) {
+			if (!DumpGBAROMCommit(&File, pPending, nPending)) {
+				printf("Error wirting to file %s\n", File.szFileName);
+				break;
+			}
+			nPending = 0;
+		}
+		if (GBA_Address % 0x1000 == 0) {
+			//printf("F: %d0%%, D: %d, L: %d\n", PercentFinished, LED_Duration, LED_Limit );
+			if (GPIO_SW && GBA_Address>0x100 && GBxGPIORead(GPIO_SW)==LOW) {
+				printf("\ncancel dumping\n");
+				fflush(stdout);
+				while (!end && GBxGPIORead(GPIO_SW)==LOW) {
+					usleep(500000);
+				} 
+				break;
+			} 
+
+			if (bConsoleProgress) {
+				printf(".");
+				fflush(stdout);
+			}
+			JSONProgress("rom", "word", GBA_Address-AddrOffset, GBA_MaxAddress-AddrOffset, nRetries, &tDumpStart);
+		}
+	}
+	printf("\nSet control byte to default\n");
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tDumpStart.tv_sec)  + (t2.tv_usec - tDumpStart.tv_usec)/1000000.0;
+	bWriteError = !end && GBA_Address==GBA_MaxAddress && !DumpGBAROMCommit(&File, pPending, nPending);
+	free(pPending);
+	bWriteError |= !DumpFileClose(&File);
+	if (bWriteError) {
+		printf("Error wirting to file %s\n", File.szFileName);
+	}
+	ReportPhase("rom", "read", elapsedTime);
+	if (!end && !bWriteError && GBA_Address==GBA_MaxAddress) {
+		const char* szStatus;
+		crc ^= 0xFFFFFFFF;
+		if(crc_list==crc) {
+			printf("\nCRC32: valid (%X)\n\n",(int)crc); 
+			szStatus = "ok";
+		} else {
+			printf("\nCRC32: no match (%X)\n\n",(int)crc);
+			szStatus = (crc_list) ? "crc_mismatch" : "unverified";
+		}
+
+		int Min, Sec;
+		fTimePerOperation = elapsedTime * 1000000.0f / (GBA_MaxAddress-AddrOffset);
+		Min = elapsedTime/60;
+		Sec = (elapsedTime-60*Min)+0.5;
+		printf("dumping %ld MB took %d min and %d sec (%g). (%.0f microsec. per operation)\n", GBA_MaxAddress*2/1024/1024, Min, Sec, elapsedTime, fTimePerOperation);
+		if (szGameFileName[0]!='\0') {
+			if (!DumpFileRename(&File, szGameFileName, szGameFileNameROM, sizeof(szGameFileNameROM))) {
+				perror("renaming GBA dump file failed");
+				Archive.bActive = 0;
+				ReportResult("rom", File.szFileName, (GBA_MaxAddress-AddrOffset)*2, crc, "failed", elapsedTime, fTimePerOperation, nRetries);
+				return(EXIT_FAILURE);
+			}	
+		}
+		ArchiveEnd(szGameFileName);
+		DumpFileFinished(&File);
+		ReportResult("rom", szGameFileNameROM, (GBA_MaxAddress-AddrOffset)*2, crc, szStatus, elapsedTime, fTimePerOperation, nRetries);
+		return(EXIT_SUCCESS);
+	}
+	Archive.bActive = 0;
+	ReportResult("rom", File.szFileName, (GBA_Address-AddrOffset)*2, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, nRetries);
+
+	return(EXIT_FAILURE);
+}
+
+
+static int DumpGBASave(int fd_X, int fd_Y, RAMType nRAMType, int nRAMSizeByte) {
+	int nROMSize = GBAHeader.nROMSize;
+
+	if (!nROMSize) {
+		nROMSize = Force_GBA_MaxAddress*2/1024/1024;
+	}
+	DatSetSave((RAMTypeEEPROM==nRAMType) ? "EEPROM" : (RAMTypeSRAM==nRAMType) ? "SRAM" : "Flash", nRAMSizeByte);
+	switch((int)nRAMType) {
+		case RAMTypeEEPROM: 
+			return DumpGBAEEPROM(fd_X, fd_Y, nRAMSizeByte, nROMSize, GBAHeader.szGameName);
+		case RAMTypeSRAM:
+			return DumpGBARAM(fd_X, fd_Y, nRAMSizeByte, GBAHeader.szGameName, CONTROL_CS2); 
+		case RAMTypeFLASH:
+		case RAMTypeFLASH1M:		
+			return DumpGBAFlash(fd_X, fd_Y, nRAMSizeByte, GBAHeader.szGameName);
+	}
+	return EXIT_FAILURE;
+}
+
+
+//###########################################################
+// Save restore (option --restore): a save image is written back to SRAM,
+// Flash or EEPROM. The cart is read first and only differing blocks are
+// written, as combined I2C transfers, a read-back with CRC32 follows.
+
+#define BYTEBUS_WRITE_BATCH ((I2C_RDWR_IOCTL_MAX_MSGS-2)/3) //address, data with *WR low, *WR high per byte
+#define RESTORE_BLOCK 0x1000                                //compare unit, Flash sector
+#define EEPROM_READ_BATCH (I2C_RDWR_IOCTL_MAX_MSGS/4)       //*RD low, register, data, *RD high per bit
+
+static BYTE RestoreImage[0x20000];
+
+//---------- EEPROM serial protocol, AD0 is the data line ----------
+
+static BYTE EEPROMAD0(BYTE nPort) {
+	int bSwap = (bAD0_7_AD8_15_swap) ? bAD8_15_swap : bAD0_7_swap;
+
+	return (bSwap) ? (nPort >> 7) & 1 : nPort & 1;
+}
+
+// Request bits on *WR strobes, *CS low for the whole request
+static int EEPROMSendBits(int fd_X, int fd_Y, DWORD dwBase, const BYTE* pBits, int nBits) {
+	struct I2CBatchStruct Batch;
+	int nBit;
+
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+	SetAddress(fd_X, fd_Y, dwBase, bLog);
+	ResetControlBit(fd_Y, CONTROL_CS);
+	I2CBatchInit(&Batch);
+	for (nBit=0; nBit<nBits; nBit++) {
+		if (Batch.nMsgs > I2C_RDWR_IOCTL_MAX_MSGS-3 && !I2CBatchFlush(fd_X, &Batch)) {
+			return 0;
+		}
+		BatchLowAddress(&Batch, (dwBase & GBA_Low_Address_Mask) | pBits[nBit]);
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte & ~CONTROL_WR);
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte);
+	}
+	if (!I2CBatchFlush(fd_X, &Batch)) {
+		return 0;
+	}
+	SetControlBit(fd_Y, CONTROL_CS);
+	return 1;
+}
+
+// Bits on *RD strobes, the cart is selected and IC1 is input. *RD via GPIO
+// can not be part of a transfer, then bit by bit.
+static int EEPROMReadBits(int fd_X, int fd_Y, BYTE* pBits, int nBits) {
+	struct I2CBatchStruct Batch;
+	BYTE* pRead[EEPROM_READ_BATCH];
+	BYTE nPortRegister = MCP_Read + ((bAD0_7_AD8_15_swap) ? MCP_PORTB : MCP_PORTA);
+	int nBit, nBatch, nPos;
+
+	if (bRDviaGIOMode) {
+		for (nBit=0; nBit<nBits; nBit++) {
+			GBxGPIOWrite(GPIO_RD, LOW);
+			pBits[nBit] = ReadAD0(fd_X, bLog);
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		}
+		return 1;
+	}
+	I2CBatchInit(&Batch);
+	for (nBit=0; nBit<nBits; nBit+=nBatch) {
+		for (nBatch=0; nBatch<EEPROM_READ_BATCH && nBit+nBatch<nBits; nBatch++) {
+			I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte & ~CONTROL_RD);
+			pRead[nBatch] = I2CBatchRead(&Batch, SlaveAddr_IC1, nPortRegister, 1);
+			I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte);
+		}
+		if (!I2CBatchFlush(fd_X, &Batch)) {
+			return 0;
+		}
+		for (nPos=0; nPos<nBatch; nPos++) {
+			pBits[nBit+nPos] = EEPROMAD0(*pRead[nPos]);
+		}
+	}
+	return 1;
+}
+
+static int EEPROMRequest(BYTE* pBits, BYTE nCommand, int nAddressBits, DWORD nBlock) {
+	int nBits = 0, nBit;
+
+	pBits[nBits++] = 1;
+	pBits[nBits++] = nCommand;   //1 read, 0 write
+	for (nBit=nAddressBits-1; nBit>=0; nBit--) {
+		pBits[nBits++] = (nBlock >> nBit) & 1;
+	}
+	return nBits;
+}
+
+static int EEPROMReadBlock(int fd_X, int fd_Y, DWORD dwBase, int nAddressBits, DWORD nBlock, BYTE* pData) {
+	BYTE Bits[2+14+1+68];
+	int nBits, nBit;
+
+	nBits = EEPROMRequest(Bits, 1, nAddressBits, nBlock);
+	Bits[nBits++] = 0;
+	if (!EEPROMSendBits(fd_X, fd_Y, dwBase, Bits, nBits)) {
+		return 0;
+	}
+	ResetControlBit(fd_Y, CONTROL_CS);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT);
+	if (!EEPROMReadBits(fd_X, fd_Y, Bits, 68)) {
+		return 0;
+	}
+	SetControlBit(fd_Y, CONTROL_CS);
+	//4 bits to ignore, then 64 data bits MSB first
+	memset(pData, 0, 8);
+	for (nBit=0; nBit<64; nBit++) {
+		if (Bits[4+nBit]) {
+			pData[nBit/8] |= 0x80 >> (nBit%8);
+		}
+	}
+	return 1;
+}
+
+// Write request, then AD0 reads 0 until the block is programmed
+static int EEPROMWriteBlock(int fd_X, int fd_Y, DWORD dwBase, int nAddressBits, DWORD nBlock, const BYTE* pData) {
+	BYTE Bits[2+14+64+1];
+	BYTE nReady = 0;
+	struct timeval tStart, tNow;
+	int nBits, nBit;
+
+	nBits = EEPROMRequest(Bits, 0, nAddressBits, nBlock);
+	for (nBit=0; nBit<64; nBit++) {
+		Bits[nBits++] = (pData[nBit/8] >> (7-nBit%8)) & 1;
+	}
+	Bits[nBits++] = 0;
+	if (!EEPROMSendBits(fd_X, fd_Y, dwBase, Bits, nBits)) {
+		return 0;
+	}
+	ResetControlBit(fd_Y, CONTROL_CS);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT);
+	gettimeofday(&tStart, 0);
+	do {
+		if (!EEPROMReadBits(fd_X, fd_Y, &nReady, 1)) {
+			break;
+		}
+		gettimeofday(&tNow, 0);
+	} while (!nReady && (tNow.tv_sec-tStart.tv_sec)*1000000 + (tNow.tv_usec-tStart.tv_usec) < 50000);
+	SetControlBit(fd_Y, CONTROL_CS);
+	return nReady;
+}
+
+// 4 or 64 kibibit: a 4 kibibit chip takes the first 6 of 14 address bits,
+// 0 for the first blocks, so all of them read as block 0. A 64 kibibit chip
+// does not answer a 6 bit request. Blank chips look the same in both widths
+// and are read as 64 kibibit.
+#define EEPROM_PROBE_BLOCKS 8
+static int EEPROMDetectSize(int fd_X, int fd_Y, int nROMSize) {
+	BYTE Data6[EEPROM_PROBE_BLOCKS][8], Data14[EEPROM_PROBE_BLOCKS][8];
+	DWORD dwBase = (32==nROMSize) ? 0xFFFF80 : 0x800000;
+	int nBlock, bMirror6 = 1, bMirror14 = 1, bOK = 1;
+
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTA, 0x00);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+	I2CWriteWord(fd_X, MCP_PullUp, MCP_WON);
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	for (nBlock=0; nBlock<EEPROM_PROBE_BLOCKS && bOK; nBlock++) {
+		bOK = EEPROMReadBlock(fd_X, fd_Y, dwBase, 6, nBlock, Data6[nBlock])
+		  && EEPROMReadBlock(fd_X, fd_Y, dwBase, 14, nBlock, Data14[nBlock]);
+		if (bOK && nBlock>0) {
+			bMirror6 &= !memcmp(Data6[nBlock], Data6[0], 8);
+			bMirror14 &= !memcmp(Data14[nBlock], Data14[0], 8);
+		}
+	}
+	SetAddress(fd_X, fd_Y, 0x000000, bLog);
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (!bOK) {
+		printf("EEPROM size probe failed, using 64 kibibit\n");
+		return 8192;
+	}
+	printf("EEPROM size probe: %s\n", (bMirror14 && !bMirror6) ? "4 kibibit" : "64 kibibit");
+	return (bMirror14 && !bMirror6) ? 512 : 8192;
+}
+
+//---------- Flash ----------
+
+// Data polling: the programmed byte (0xFF after erase) is read back
+static int FlashWaitByte(int fd_X, int fd_Y, WORD wAddress, BYTE nData, int nTimeout_ms) {
+	struct timeval tStart, tNow;
+	BYTE nRead;
+
+	gettimeofday(&tStart, 0);
+	do {
+		if (!ByteBusRead(fd_X, fd_Y, wAddress, &nRead, 1, CONTROL_CS2)) {
+			return 0;
+		}
+		if (nRead==nData) {
+			return 1;
+		}
+		gettimeofday(&tNow, 0);
+	} while ((tNow.tv_sec-tStart.tv_sec)*1000 + (tNow.tv_usec-tStart.tv_usec)/1000 < nTimeout_ms && !end);
+	return 0;
+}
+
+static int FlashEraseSector(int fd_X, int fd_Y, WORD wSector) {
+	WORD Address[6] = {0x5555, 0x2AAA, 0x5555, 0x5555, 0x2AAA, 0x0000};
+	BYTE Data[6] = {0xAA, 0x55, 0x80, 0xAA, 0x55, 0x30};
+
+	Address[5] = wSector;
+	if (!ByteBusWrite(fd_X, Address, Data, 6, CONTROL_CS2)) {
+		return 0;
+	}
+	return FlashWaitByte(fd_X, fd_Y, wSector, 0xFF, 1000);
+}
+
+// Program command per byte, several bytes per transfer (a byte program is
+// done before the next command arrives over I2C). Bytes that do not read
+// back are programmed again one at a time with data polling.
+static int FlashProgram(int fd_X, int fd_Y, WORD wStart, const BYTE* pData, const BYTE* pCurrent, int nCount) {
+	WORD Address[BYTEBUS_WRITE_BATCH];
+	BYTE Data[BYTEBUS_WRITE_BATCH];
+	BYTE Check[RESTORE_BLOCK];
+	int nPos, nEntries = 0, nTry;
+
+	for (nPos=0; nPos<nCount; nPos++) {
+		if (pData[nPos]==pCurrent[nPos]) {
+			continue;
+		}
+		Address[nEntries] = 0x5555; Data[nEntries++] = 0xAA;
+		Address[nEntries] = 0x2AAA; Data[nEntries++] = 0x55;
+		Address[nEntries] = 0x5555; Data[nEntries++] = 0xA0;
+		Address[nEntries] = wStart+nPos; Data[nEntries++] = pData[nPos];
+		if (nEntries+4>BYTEBUS_WRITE_BATCH) {
+			if (!ByteBusWrite(fd_X, Address, Data, nEntries, CONTROL_CS2)) {
+				return 0;
+			}
+			nEntries = 0;
+		}
+	}
+	if (nEntries && !ByteBusWrite(fd_X, Address, Data, nEntries, CONTROL_CS2)) {
+		return 0;
+	}
+	if (!ByteBusRead(fd_X, fd_Y, wStart, Check, nCount, CONTROL_CS2)) {
+		return 0;
+	}
+	for (nPos=0; nPos<nCount; nPos++) {
+		for (nTry=0; Check[nPos]!=pData[nPos] && nTry<3; nTry++) {
+			WORD ProgramAddress[4] = {0x5555, 0x2AAA, 0x5555, 0x0000};
+			BYTE ProgramData[4] = {0xAA, 0x55, 0xA0, 0x00};
+
+			ProgramAddress[3] = wStart+nPos;
+			ProgramData[3] = pData[nPos];
+			printf("\n-> 0x%04X reads 0x%02X, programming 0x%02X again", (unsigned int)(wStart+nPos), (unsigned int)Check[nPos], (unsigned int)pData[nPos]);
+			if (!ByteBusWrite(fd_X, ProgramAddress, ProgramData, 4, CONTROL_CS2)) {
+				return 0;
+			}
+			if (FlashWaitByte(fd_X, fd_Y, wStart+nPos, pData[nPos], 10)) {
+				Check[nPos] = pData[nPos];
+			}
+		}
+		if (Check[nPos]!=pData[nPos]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+//---------- restore ----------
+
+// Current cart content into pBuffer (SRAM/Flash 64 KiB banks, EEPROM blocks)
+static int RestoreRead(int fd_X, int fd_Y, RAMType nRAMType, DWORD dwBase, int nSize, BYTE* pBuffer) {
+	int nPos;
+
+	if (RAMTypeEEPROM==nRAMType) {
+		int nAddressBits = (512==nSize) ? 6 : 14;
+		for (nPos=0; nPos<nSize && !end; nPos+=8) {
+			if (!EEPROMReadBlock(fd_X, fd_Y, dwBase, nAddressBits, nPos/8, &pBuffer[nPos])) {
+				return 0;
+			}
+		}
+		return !end;
+	}
+	for (nPos=0; nPos<nSize && !end; nPos+=RESTORE_BLOCK) {
+		if (nSize>0x10000 && 0==nPos%0x10000) {
+			FlashSelectBank(fd_X, nPos/0x10000);
+		}
+		if (!ByteBusRead(fd_X, fd_Y, nPos & 0xFFFF, &pBuffer[nPos], RESTORE_BLOCK, CONTROL_CS2)) {
+			return 0;
+		}
+	}
+	return !end;
+}
+
+static int RestoreLoadImage(const char* szFileName) {
+	gzFile gzImage = gzopen(szFileName, "rb");
+	int nSize;
+
+	if (!gzImage) {
+		perror(szFileName);
+		return -1;
+	}
+	nSize = gzread(gzImage, RestoreImage, sizeof(RestoreImage));
+	if (nSize==sizeof(RestoreImage) && gzgetc(gzImage)>=0) {
+		nSize = -1;
+	}
+	gzclose(gzImage);
+	return nSize;
+}
+
+static int RestoreGBASave(int fd_X, int fd_Y, RAMType nRAMType, int nRAMSizeByte, int nROMSize, const char* szFileName) {
+	const char* szType[] = {"unknown", "SRAM", "Flash", "Flash 1M", "EEPROM"};
+	struct timeval tStart, t2;
+	double elapsedTime;
+	DWORD dwBase = (32==nROMSize) ? 0xFFFF80 : 0x800000;
+	WORD Address[BYTEBUS_WRITE_BATCH];
+	BYTE Data[BYTEBUS_WRITE_BATCH];
+	DWORD nWritten = 0, crc;
+	int nSize, nPos, nByte, nBlockSize, nBank = -1, bOK = 1;
+
+	nSize = RestoreLoadImage(szFileName);
+	if (nSize<=0) {
+		printf("restore: '%s' is empty, too large or not readable\n", szFileName);
+		return EXIT_FAILURE;
+	}
+	//save type not in gbalist: from the image size
+	if (RAMTypeUnknown==nRAMType) {
+		nRAMType = (512==nSize || 8192==nSize) ? RAMTypeEEPROM : (0x8000==nSize) ? RAMTypeSRAM : (0x10000==nSize) ? RAMTypeFLASH : (0x20000==nSize) ? RAMTypeFLASH1M : RAMTypeUnknown;
+		nRAMSizeByte = nSize;
+	}
+	if (RAMTypeEEPROM==nRAMType && (512==nSize || 8192==nSize)) {
+		nRAMSizeByte = nSize; //4 or 64 kibibit, the header list does not know
+	}
+	if (RAMTypeUnknown==nRAMType) {
+		printf("restore: no save type for an image of %d Byte\n", nSize);
+		return EXIT_FAILURE;
+	}
+
+	if (RAMTypeEEPROM==nRAMType) {
+		I2CWrite(fd_Y, MCP_Write + MCP_PORTA, 0x00);
+		I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+		I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByte);
+		I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+		I2CWriteWord(fd_X, MCP_PullUp, MCP_WON);
+		SetControlBit(fd_Y, ControlByteDefault);
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		}
+	} else {
+		ByteBusInit(fd_X, fd_Y);
+		if (RAMTypeSRAM!=nRAMType) {
+			const struct FlashChipStruct* pChip = FlashGetChip(fd_X, fd_Y);
+
+			if (pChip && 0x1F==pChip->nManufacturer) {
+				//page write needs 128 bytes within 150 us, not possible over I2C
+				printf("restore: %s is not supported\n", pChip->szName);
+				return EXIT_FAILURE;
+			}
+			if (pChip) {
+				nRAMSizeByte = pChip->nSize;
+			}
+		}
+	}
+	if (nSize!=nRAMSizeByte) {
+		printf("restore: image has %d Byte, cartridge %s has %d Byte\n", nSize, szType[nRAMType], nRAMSizeByte);
+		return EXIT_FAILURE;
+	}
+	crc = CRC32(0xFFFFFFFF, RestoreImage, nSize) ^ 0xFFFFFFFF;
+	printf("\n\n Restore '%s' (%d Byte, CRC32 %08lX) to %s ...\n", szFileName, nSize, crc, szType[nRAMType]);
+
+	gettimeofday(&tStart, 0);
+	if (!RestoreRead(fd_X, fd_Y, nRAMType, dwBase, nSize, RAMBuffer)) {
+		bOK = 0;
+	}
+
+	//write the blocks that differ
+	nBlockSize = (RAMTypeEEPROM==nRAMType) ? 8 : RESTORE_BLOCK;
+	for (nPos=0; nPos<nSize && bOK && !end; nPos+=nBlockSize) {
+		BYTE* pCurrent = &RAMBuffer[nPos];
+		const BYTE* pData = &RestoreImage[nPos];
+		WORD wBlock = nPos & 0xFFFF;
+
+		if (0==nPos%0x2000) {
+			if (bConsoleProgress) printf("\n-> [%d0%%] %04d KB (dot per written block)", 10*nPos/nSize, nPos/0x400);
+			JSONProgress("save_restore", "byte", nPos, nSize, 0, &tStart);
+		}
+		if (!memcmp(pCurrent, pData, nBlockSize)) {
+			continue;
+		}
+		if (bConsoleProgress) printf(".");
+		nWritten += nBlockSize;
+		if (RAMTypeEEPROM==nRAMType) {
+			bOK = EEPROMWriteBlock(fd_X, fd_Y, dwBase, (512==nSize) ? 6 : 14, nPos/8, pData);
+			continue;
+		}
+		if (RAMTypeSRAM==nRAMType) {
+			int nEntries = 0;
+
+			for (nByte=0; nByte<nBlockSize && bOK; nByte++) {
+				if (pCurrent[nByte]==pData[nByte]) {
+					continue;
+				}
+				Address[nEntries] = wBlock+nByte;
+				Data[nEntries++] = pData[nByte];
+				if (nEntries==BYTEBUS_WRITE_BATCH) {
+					bOK = ByteBusWrite(fd_X, Address, Data, nEntries, CONTROL_CS2);
+					nEntries = 0;
+				}
+			}
+			if (nEntries && bOK) {
+				bOK = ByteBusWrite(fd_X, Address, Data, nEntries, CONTROL_CS2);
+			}
+			continue;
+		}
+		//Flash: bits only go from 1 to 0, otherwise the sector is erased first
+		if (nSize>0x10000 && nPos/0x10000!=nBank) {
+			nBank = nPos/0x10000;
+			FlashSelectBank(fd_X, nBank);
+		}
+		for (nByte=0; nByte<nBlockSize; nByte++) {
+			if ((pCurrent[nByte] & pData[nByte]) != pData[nByte]) {
+				bOK = FlashEraseSector(fd_X, fd_Y, wBlock);
+				memset(pCurrent, 0xFF, nBlockSize);
+				break;
+			}
+		}
+		if (bOK) {
+			bOK = FlashProgram(fd_X, fd_Y, wBlock, pData, pCurrent, nBlockSize);
+		}
+	}
+
+	//read-back of the whole save
+	if (bOK && !end) {
+		printf("\nverify ...\n");
+		bOK = RestoreRead(fd_X, fd_Y, nRAMType, dwBase, nSize, RAMBuffer) && crc==(CRC32(0xFFFFFFFF, RAMBuffer, nSize) ^ 0xFFFFFFFF);
+	}
+	if (RAMTypeFLASH1M==nRAMType || nSize>0x10000) {
+		FlashSelectBank(fd_X, 0);
+	}
+	SetAddress(fd_X, fd_Y, 0x000000, bLog);
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tStart.tv_sec) + (t2.tv_usec - tStart.tv_usec)/1000000.0;
+	ReportPhase("save_restore", "write", elapsedTime);
+	if (end || !bOK) {
+		printf("restore %s after %g sec\n", (end) ? "cancelled" : "failed", elapsedTime);
+		ReportResult("save_restore", szFileName, nSize, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, 0);
+		return EXIT_FAILURE;
+	}
+	printf("restore verified: %lu of %d Byte written, CRC32 %08lX, took %g sec\n", nWritten, nSize, crc, elapsedTime);
+	ReportResult("save_restore", szFileName, nSize, crc, "ok", elapsedTime, elapsedTime*1000000.0f/nSize, 0);
+	return EXIT_SUCCESS;
+}
+
+
+//###########################################################
+// Known-good library (option --library): header and sampled blocks
+// identify a cart that was dumped and verified before
+
+#define LIBRARY_SAMPLES 16
+#define LIBRARY_SAMPLE_WORDS 0x100
+
+struct LibraryEntryStruct {
+	char szGameCode[4+1];
+	DWORD nSize;                          // bytes
+	DWORD crc32;                          // full image, image file is <crc32>.gba
+	DWORD Samples[1+LIBRARY_SAMPLES];     // CRC32 of header, then of each block
+};
+
+// Blocks sit in the middle of 16 equal parts of the ROM, aligned so that no
+// block crosses an auto increment boundary.
+static DWORD LibrarySampleAddress(DWORD dwMaxAddress, int nSample) {
+	return ((2*nSample+1) * (dwMaxAddress/(2*LIBRARY_SAMPLES))) & ~(DWORD)(LIBRARY_SAMPLE_WORDS-1);
+}
+
+static int LibraryParseEntry(char* szLine, struct LibraryEntryStruct* pEntry) {
+	char* pSave = NULL;
+	char* pField[4];
+	char* pSample;
+	int nPos;
+
+	for (nPos=0; nPos<4; nPos++) {
+		pField[nPos] = strtok_r(nPos ? NULL : szLine, "\t\r\n", &pSave);
+		if (!pField[nPos]) {
+			return 0;
+		}
+	}
+	if (strlen(pField[0])!=4) {
+		return 0; // column titles
+	}
+	strcpy(pEntry->szGameCode, pField[0]);
+	pEntry->nSize = strtoul(pField[1], NULL, 10);
+	pEntry->crc32 = strtoul(pField[2], NULL, 16);
+	pSample = pField[3];
+	for (nPos=0; nPos<1+LIBRARY_SAMPLES; nPos++) {
+		pEntry->Samples[nPos] = strtoul(pSample, &pSample, 16);
+		if (*pSample==',') {
+			pSample++;
+		} else if (nPos<LIBRARY_SAMPLES) {
+			return 0;
+		}
+	}
+	return (pEntry->nSize >= 2*LIBRARY_SAMPLES*LIBRARY_SAMPLE_WORDS*sizeof(WORD));
+}
+
+static int LibraryFind(const char* szGameCode, DWORD crc) {
+	char szIndex[PATH_MAX+1];
+	char szLine[256];
+	struct LibraryEntryStruct Entry;
+	int bFound = 0;
+	FILE* fp;
+
+	snprintf(szIndex, sizeof(szIndex), "%s/index.csv", szLibraryDir);
+	fp = fopen(szIndex, "r");
+	if (!fp) {
+		return 0;
+	}
+	while (!bFound && fgets(szLine, sizeof(szLine), fp)) {
+		bFound = LibraryParseEntry(szLine, &Entry) && !strcmp(Entry.szGameCode, szGameCode) && Entry.crc32==crc;
+	}
+	fclose(fp);
+	return bFound;
+}
+
+// Read nCount words from dwAddress, without bLatch the cart continues with
+// the address after the previous run (auto address mode)
+static int ReadROMRun(int fd_X, int fd_Y, DWORD dwAddress, WORD* pwData, int nCount, int bLatch) {
+	int nPos;
+
+	for (nPos=0; nPos<nCount; nPos++) {
+		if ((0==nPos && bLatch) || !bAutoAddressMode || 0 == ((dwAddress+nPos) & 0xFFFF)) {
+			if (!ReadROMWordExplicit(fd_X, fd_Y, dwAddress+nPos, &pwData[nPos])) {
+				return 0;
+			}
+			continue;
+		}
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+			GBxGPIOWrite(GPIO_RD, LOW);
+		} else {
+			SetControlBit(fd_Y, CONTROL_RD);
+			ResetControlBit(fd_Y, CONTROL_RD);
+		}
+		if (!GetROMData(fd_X, dwAddress+nPos, &pwData[nPos], bLog)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Read nCount words from dwAddress, one latch per block in auto address mode
+static int ReadROMBlock(int fd_X, int fd_Y, DWORD dwAddress, WORD* pwData, int nCount) {
+	return ReadROMRun(fd_X, fd_Y, dwAddress, pwData, nCount, 1);
+}
+
+// Copy the library image to the dump file name, check it against the index
+// CRC32 and feed the save type scanner like a ROM dump would
+static int LibraryEmitImage(const struct LibraryEntryStruct* pEntry, const char* szGameName, double fSampleTime) {
+	char szImage[PATH_MAX+1];
+	const char cszFilename[] = "game.gba";
+	char szGameFileName[12+4+3+1];
+	FILE* fpImage;
+	struct DumpFileStruct File;
+	int bWriteError = 0;
+	DWORD crc = 0xFFFFFFFF;
+	DWORD nSize = 0;
+	size_t nRead, nPos;
+
+	snprintf(szImage, sizeof(szImage), "%s/%08X.gba", szLibraryDir, (unsigned int)pEntry->crc32);
+	fpImage = fopen(szImage, "rb");
+	if (!fpImage) {
+		printf("library image '%s' missing\n", szImage);
+		return EXIT_FAILURE;
+	}
+	if (!DumpFileOpen(&File, cszFilename, GBxDataROM)) {
+		GBxReportError(GBxErrorDump, "Could not create file '%s', error %d!", cszFilename, errno);
+		fclose(fpImage);
+		return EXIT_FAILURE;
+	}
+	SaveScanInit();
+	while ((nRead = fread(RAMBuffer, 1, sizeof(RAMBuffer), fpImage)) > 0) {
+		WORD* pwData = (WORD*)RAMBuffer;
+		for (nPos=0; nPos<nRead/sizeof(WORD); nPos++) {
+			crc = CRC32_WORD(crc, pwData[nPos]);
+			SaveScanWord(pwData[nPos]);
+		}
+		if (!DumpFileWrite(&File, RAMBuffer, nRead)) {
+			printf("Error wirting to file %s\n", File.szFileName);
+			bWriteError = 1;
+			break;
+		}
+		nSize += nRead;
+	}
+	fclose(fpImage);
+	bWriteError |= !DumpFileClose(&File);
+	crc ^= 0xFFFFFFFF;
+	if (bWriteError || nSize!=pEntry->nSize || crc!=pEntry->crc32) {
+		if (!bWriteError) {
+			printf("library image '%s' damaged (CRC32 %X)\n", szImage, (unsigned int)crc);
+		}
+		DumpFileRemove(&File);
+		return EXIT_FAILURE;
+	}
+	strcpy(szGameFileName, szGameName);
+	strcat(szGameFileName, ".gba");
+	if (!DumpFileRename(&File, szGameFileName, szGameFileNameROM, sizeof(szGameFileNameROM))) {
+		perror("renaming GBA dump file failed");
+		return EXIT_FAILURE;
+	}
+	printf("\nCRC32: valid (%X), ROM taken from library\n\n", (unsigned int)crc);
+	ArchiveFile(szGameFileNameROM);
+	DumpFileFinished(&File);
+	ReportResult("rom", szGameFileNameROM, nSize, crc, "known_good", fSampleTime, 0, 0);
+	return EXIT_SUCCESS;
+}
+
+// Needs the header words from DumpGBAROMHeader. Every sample of an entry
+// with the same game code has to match, the first mismatch ends the entry.
+static int LibraryIdentify(int fd_X, int fd_Y) {
+	struct timeval tStart, t2;
+	char szIndex[PATH_MAX+1];
+	char szLine[256];
+	char szGameCode[4+1];
+	struct LibraryEntryStruct Entry;
+	WORD Block[LIBRARY_SAMPLE_WORDS];
+	DWORD Samples[1+LIBRARY_SAMPLES];
+	DWORD nSamplesSize = 0;
+	int nSamplesRead = 0;
+	int nMatched = 0, nPos, bFound = 0, nReturn = EXIT_FAILURE;
+	DWORD crc;
+	double elapsedTime;
+	FILE* fp;
+
+	if (Session.nGBAHeaderWords<cnDumpBufferMaxAddress || end) {
+		return EXIT_FAILURE;
+	}
+	snprintf(szIndex, sizeof(szIndex), "%s/index.csv", szLibraryDir);
+	fp = fopen(szIndex, "r");
+	if (!fp) {
+		printf("library index '%s' not found\n", szIndex);
+		return EXIT_FAILURE;
+	}
+	memset(szGameCode, 0, sizeof(szGameCode));
+	strncpy(szGameCode, (char*)&pDumpBuffer[0xAC], 4);
+	crc = 0xFFFFFFFF;
+	for (nPos=0; nPos<cnDumpBufferMaxAddress; nPos++) {
+		crc = CRC32_WORD(crc, DumpBuffer[nPos]);
+	}
+	Samples[0] = crc ^ 0xFFFFFFFF;
+
+	printf("\nlooking up '%s' in library ...\n", szGameCode);
+	gettimeofday(&tStart, 0);
+	while (!bFound && !end && fgets(szLine, sizeof(szLine), fp)) {
+		if (!LibraryParseEntry(szLine, &Entry) || strcmp(Entry.szGameCode, szGameCode) || Entry.Samples[0]!=Samples[0]) {
+			continue;
+		}
+		if (GBAHeader.bListed && Entry.nSize!=GBAHeader.GBA_MaxAddress*sizeof(WORD)) {
+			continue;
+		}
+		if (Entry.nSize!=nSamplesSize) {
+			nSamplesSize = Entry.nSize;
+			nSamplesRead = 0;
+		}
+		for (nMatched=1; nMatched<1+LIBRARY_SAMPLES; nMatched++) {
+			if (nMatched>nSamplesRead) {
+				DWORD dwAddress = LibrarySampleAddress(nSamplesSize/sizeof(WORD), nMatched-1);
+				if (!ReadROMBlock(fd_X, fd_Y, dwAddress, Block, LIBRARY_SAMPLE_WORDS)) {
+					break;
+				}
+				crc = 0xFFFFFFFF;
+				for (nPos=0; nPos<LIBRARY_SAMPLE_WORDS; nPos++) {
+					crc = CRC32_WORD(crc, Block[nPos]);
+				}
+				Samples[nMatched] = crc ^ 0xFFFFFFFF;
+				nSamplesRead = nMatched;
+			}
+			if (Samples[nMatched]!=Entry.Samples[nMatched]) {
+				break;
+			}
+		}
+		bFound = (nMatched==1+LIBRARY_SAMPLES);
+	}
+	fclose(fp);
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tStart.tv_sec)  + (t2.tv_usec - tStart.tv_usec)/1000000.0;
+	ReportPhase("rom", "fingerprint", elapsedTime);
+
+	if (bFound) {
+		printf("known-good dump %08X found (%d of %d samples match, %g sec.)\n", (unsigned int)Entry.crc32, nMatched, 1+LIBRARY_SAMPLES, elapsedTime);
+		nReturn = LibraryEmitImage(&Entry, GBAHeader.szGameName, elapsedTime);
+	} else {
+		printf("no known-good dump found (%g sec.)\n", elapsedTime);
+	}
+	JSONEmit("\"event\":\"fingerprint\",\"code\":\"%s\",\"found\":%s,\"crc32\":\"%08X\",\"samples\":%d,\"matched\":%d,\"sampled_words\":%d",
+	  szGameCode, (EXIT_SUCCESS==nReturn) ? "true" : "false", bFound ? (unsigned int)Entry.crc32 : 0,
+	  1+LIBRARY_SAMPLES, bFound ? nMatched : 0, cnDumpBufferMaxAddress+nSamplesRead*LIBRARY_SAMPLE_WORDS);
+	return nReturn;
+}
+
+// Only dumps matching the gbalist CRC32 are known-good and added to the library
+static int LibraryAdd(const char* szFileName) {
+	char szIndex[PATH_MAX+1];
+	char szImage[PATH_MAX+1];
+	char szTmpFile[PATH_MAX+1];
+	char szGameCode[4+1];
+	struct LibraryEntryStruct Entry;
+	gzFile gzDump;
+	FILE* fpImage;
+	FILE* fp;
+	DWORD crc = 0xFFFFFFFF;
+	DWORD nWords;
+	struct stat Stat;
+	size_t nPos;
+	int nRead;
+	int bImageExists;
+
+	if (!GBAHeader.bListed || !GBAHeader.crc32) {
+		return 0;
+	}
+	// the dump may be compressed (--gzip), gzread handles both
+	gzDump = gzopen(szFileName, "rb");
+	if (!gzDump) {
+		return 0;
+	}
+	memset(&Entry, 0, sizeof(Entry));
+	memset(szGameCode, 0, sizeof(szGameCode));
+	strncpy(szGameCode, (char*)&pDumpBuffer[0xAC], 4);
+	strcpy(Entry.szGameCode, szGameCode);
+	if (LibraryFind(szGameCode, GBAHeader.crc32)) {
+		gzclose(gzDump);
+		return 1;
+	}
+	snprintf(szImage, sizeof(szImage), "%s/%08X.gba", szLibraryDir, (unsigned int)GBAHeader.crc32);
+	snprintf(szTmpFile, sizeof(szTmpFile), "%s/%08X.tmp", szLibraryDir, (unsigned int)GBAHeader.crc32);
+	// the image may already be there for another game code
+	bImageExists = (0==stat(szImage, &Stat));
+	fpImage = bImageExists ? NULL : fopen(szTmpFile, "wb");
+	if (!bImageExists && !fpImage) {
+		perror("Could not create library image");
+		gzclose(gzDump);
+		return 0;
+	}
+	while ((nRead = gzread(gzDump, RAMBuffer, sizeof(RAMBuffer))) > 0) {
+		WORD* pwData = (WORD*)RAMBuffer;
+		for (nPos=0; nPos<nRead/sizeof(WORD); nPos++) {
+			crc = CRC32_WORD(crc, pwData[nPos]);
+		}
+		if (fpImage && nRead!=fwrite(RAMBuffer, 1, nRead, fpImage)) {
+			break;
+		}
+		Entry.nSize += nRead;
+	}
+	Entry.crc32 = crc ^ 0xFFFFFFFF;
+	nWords = Entry.nSize/sizeof(WORD);
+	for (nPos=0; nPos<1+LIBRARY_SAMPLES; nPos++) {
+		DWORD dwAddress = nPos ? LibrarySampleAddress(nWords, nPos-1) : 0;
+		int nCount = nPos ? LIBRARY_SAMPLE_WORDS : cnDumpBufferMaxAddress;
+		WORD* pwData = (WORD*)RAMBuffer;
+		int nWord;
+
+		crc = 0xFFFFFFFF;
+		if (gzseek(gzDump, dwAddress*sizeof(WORD), SEEK_SET)<0 || gzread(gzDump, pwData, nCount*sizeof(WORD))!=(int)(nCount*sizeof(WORD))) {
+			break;
+		}
+		for (nWord=0; nWord<nCount; nWord++) {
+			crc = CRC32_WORD(crc, pwData[nWord]);
+		}
+		Entry.Samples[nPos] = crc ^ 0xFFFFFFFF;
+	}
+	gzclose(gzDump);
+	if (fpImage) {
+		fflush(fpImage);
+		fsync(fileno(fpImage));
+		if (fclose(fpImage)!=0 || Entry.crc32!=GBAHeader.crc32 || nPos<1+LIBRARY_SAMPLES || rename(szTmpFile, szImage)!=0) {
+			unlink(szTmpFile);
+			return 0;
+		}
+	} else if (Entry.crc32!=GBAHeader.crc32 || nPos<1+LIBRARY_SAMPLES) {
+		return 0;
+	}
+
+	snprintf(szIndex, sizeof(szIndex), "%s/index.csv", szLibraryDir);
+	fp = fopen(szIndex, "a");
+	if (!fp) {
+		perror("Could not write library index");
+		return 0;
+	}
+	if (0==ftell(fp)) {
+		fprintf(fp, "Game code\tROM size (Byte)\tCRC32\tSamples (CRC32 header, blocks)\n");
+	}
+	fprintf(fp, "%s\t%lu\t%08X\t", Entry.szGameCode, Entry.nSize, (unsigned int)Entry.crc32);
+	for (nPos=0; nPos<1+LIBRARY_SAMPLES; nPos++) {
+		fprintf(fp, nPos ? ",%08X" : "%08X", (unsigned int)Entry.Samples[nPos]);
+	}
+	fprintf(fp, "\n");
+	fflush(fp);
+	fsync(fileno(fp));
+	fclose(fp);
+	printf("dump %08X added to library\n", (unsigned int)Entry.crc32);
+	return 1;
+}
+
+
+//###########################################################
+// Flash cart programming (option --program): repro and flash carts with a
+// CFI NOR flash on the ROM bus (AMD/Spansion/Macronix or Intel/Sharp command
+// set). Only the blocks covered by the image are erased, data goes in with
+// the buffered write command (auto address mode: one latch per buffer, the
+// cart counter follows *WR), a CRC32 read-back ends the run.
+
+#define ROMBUS_WRITE_BATCH ((I2C_RDWR_IOCTL_MAX_MSGS-1)/7) //address, *CS, data, *WR low/high, *CS high per word
+#define FLASHCART_MAX_BUFFER 256                            //words
+#define FLASHCART_MAX_SIZE 0x2000000
+
+typedef enum {
+	FlashCartIntel = 1,     // CFI primary command set 0x0001/0x0003
+	FlashCartAMD = 2        // CFI primary command set 0x0002
+} FlashCartCommandSet;
+
+static struct FlashCartStruct {
+	FlashCartCommandSet nCommandSet;
+	int bSwapD0D1;              // D0/D1 swapped on the cart PCB, commands have to follow
+	WORD wManufacturer;
+	WORD wDevice;
+	DWORD nSizeWords;
+	int nBufferWords;           // 0: no buffered write, single word program
+	int nRegions;
+	DWORD RegionBlocks[4];
+	DWORD RegionBlockWords[4];
+} FlashCart;
+
+// Command and parameter words as the chip sees them
+static WORD FlashCartCmd(WORD wCommand) {
+	if (!FlashCart.bSwapD0D1) {
+		return wCommand;
+	}
+	return (wCommand & ~0x0003) | ((wCommand & 0x0001) << 1) | ((wCommand & 0x0002) >> 1);
+}
+
+// AD0-AD23 and control to output, for ROM bus writes and reads
+static void ROMBusInit(int fd_X, int fd_Y) {
+	printf("write direction IC1 Port A/B (AD0-AD15) to output, default ...\n");
+	I2CWriteWord(fd_X, MCP_Write, 0x0000);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+	printf("write direction IC2 Port A (A16-A23) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTA, 0x00);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+	printf("write direction IC2 Port B (Control) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	GBA_Last_LowAddress = 0;
+	GBA_Last_LowAddress_A = 0;
+	GBA_Last_LowAddress_B = 0;
+	GBA_Last_HighAddress = 0;
+}
+
+//like SetAddress for A16-A23, but only queued into a batch
+static int BatchHighAddress(struct I2CBatchStruct* pBatch, DWORD dwAddress) {
+	BYTE nHigh = (dwAddress & GBA_High_Address_Mask) >> 16;
+
+	if (nHigh == GBA_Last_HighAddress) {
+		return 1;
+	}
+	GBA_Last_HighAddress = nHigh;
+	return I2CBatchWrite(pBatch, SlaveAddr_IC2, MCP_Write + MCP_PORTA, bAD16_23_swap ? revtable[nHigh] : nHigh);
+}
+
+// Latch each address with *CS, data on AD0-AD15 with a *WR strobe. The data
+// word goes through BatchLowAddress, so the address cache knows the port state.
+static int ROMBusWrite(int fd_X, const DWORD* pdwAddress, const WORD* pwData, int nCount) {
+	struct I2CBatchStruct Batch;
+	int nPos;
+
+	I2CBatchInit(&Batch);
+	I2CBatchWriteWord(&Batch, SlaveAddr_IC1, MCP_Direction, MCP_WOUTPUT);
+	for (nPos=0; nPos<nCount; nPos++) {
+		if (bLog) printf("Write ROM address %06lX: Data=%04X\n", pdwAddress[nPos], (unsigned int)pwData[nPos]);
+		if (Batch.nMsgs > I2C_RDWR_IOCTL_MAX_MSGS-7 && !I2CBatchFlush(fd_X, &Batch)) {
+			return 0;
+		}
+		BatchHighAddress(&Batch, pdwAddress[nPos]);
+		BatchLowAddress(&Batch, pdwAddress[nPos] & GBA_Low_Address_Mask);
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte & ~CONTROL_CS);
+		BatchLowAddress(&Batch, pwData[nPos]);
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte & ~(CONTROL_CS | CONTROL_WR));
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte & ~CONTROL_CS);
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte);
+	}
+	return I2CBatchFlush(fd_X, &Batch);
+}
+
+// One latch, then consecutive words on *WR strobes (auto address mode)
+static int ROMBusWriteBurst(int fd_X, DWORD dwAddress, const WORD* pwData, int nCount) {
+	struct I2CBatchStruct Batch;
+	int nPos;
+
+	I2CBatchInit(&Batch);
+	I2CBatchWriteWord(&Batch, SlaveAddr_IC1, MCP_Direction, MCP_WOUTPUT);
+	BatchHighAddress(&Batch, dwAddress);
+	BatchLowAddress(&Batch, dwAddress & GBA_Low_Address_Mask);
+	I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte & ~CONTROL_CS);
+	for (nPos=0; nPos<nCount; nPos++) {
+		if (Batch.nMsgs > I2C_RDWR_IOCTL_MAX_MSGS-4 && !I2CBatchFlush(fd_X, &Batch)) {
+			return 0;
+		}
+		BatchLowAddress(&Batch, pwData[nPos]);
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte & ~(CONTROL_CS | CONTROL_WR));
+		I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte & ~CONTROL_CS);
+	}
+	I2CBatchWrite(&Batch, SlaveAddr_IC2, MCP_Write + MCP_PORTB, ControlByte);
+	return I2CBatchFlush(fd_X, &Batch);
+}
+
+static int FlashCartCommand(int fd_X, DWORD dwAddress, WORD wCommand) {
+	WORD wData = FlashCartCmd(wCommand);
+
+	return ROMBusWrite(fd_X, &dwAddress, &wData, 1);
+}
+
+// AMD unlock cycles and the command, dwAddress 0 for commands at 0x555
+static int FlashCartAMDCommand(int fd_X, DWORD dwAddress, WORD wCommand) {
+	DWORD Address[3] = {0x555, 0x2AA, 0x555};
+	WORD Data[3];
+
+	Data[0] = FlashCartCmd(0xAA);
+	Data[1] = FlashCartCmd(0x55);
+	Data[2] = FlashCartCmd(wCommand);
+	if (dwAddress) {
+		Address[2] = dwAddress;
+	}
+	return ROMBusWrite(fd_X, Address, Data, 3);
+}
+
+// Explicit read, the bus is released for the next write afterwards
+static int FlashCartRead(int fd_X, int fd_Y, DWORD dwAddress, WORD* pwData) {
+	int nRet = ReadROMWordExplicit(fd_X, fd_Y, dwAddress, pwData);
+
+	SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	return nRet;
+}
+
+static int FlashCartReadCFI(int fd_X, int fd_Y, DWORD dwOffset) {
+	WORD wData = 0;
+
+	FlashCartRead(fd_X, fd_Y, dwOffset, &wData);
+	return FlashCartCmd(wData) & 0xFF;
+}
+
+// Back to read array, Intel also clears the status register
+static void FlashCartReset(int fd_X) {
+	if (FlashCartAMD==FlashCart.nCommandSet) {
+		FlashCartCommand(fd_X, 0, 0xF0);
+		return;
+	}
+	FlashCartCommand(fd_X, 0, 0x50);
+	FlashCartCommand(fd_X, 0, 0xFF);
+}
+
+// CFI query (0x98 at 0x55): command set, size, write buffer and erase block
+// regions. "RQZ" instead of "QRY" means D0/D1 are swapped.
+static int FlashCartDetect(int fd_X, int fd_Y) {
+	BYTE QRY[3];
+	int nRegion, nPos;
+
+	memset(&FlashCart, 0, sizeof(FlashCart));
+	FlashCartCommand(fd_X, 0, 0xF0);
+	FlashCartCommand(fd_X, 0, 0xFF);
+	FlashCartCommand(fd_X, 0x55, 0x98);
+	for (nPos=0; nPos<3; nPos++) {
+		QRY[nPos] = FlashCartReadCFI(fd_X, fd_Y, 0x10+nPos);
+	}
+	if (!memcmp(QRY, "RQZ", 3)) {
+		FlashCart.bSwapD0D1 = 1;
+		printf("  Flash cart: D0/D1 swapped\n");
+	} else if (memcmp(QRY, "QRY", 3)) {
+		FlashCartCommand(fd_X, 0, 0xF0);
+		FlashCartCommand(fd_X, 0, 0xFF);
+		printf("  no CFI flash found (read %02X %02X %02X)\n", (unsigned int)QRY[0], (unsigned int)QRY[1], (unsigned int)QRY[2]);
+		return 0;
+	}
+	FlashCart.nCommandSet = FlashCartReadCFI(fd_X, fd_Y, 0x13);
+	FlashCart.nSizeWords = 1UL << (FlashCartReadCFI(fd_X, fd_Y, 0x27) - 1);
+	nPos = FlashCartReadCFI(fd_X, fd_Y, 0x2A);
+	FlashCart.nBufferWords = (nPos>1) ? (1 << (nPos-1)) : 0;
+	if (FlashCart.nBufferWords > FLASHCART_MAX_BUFFER) {
+		FlashCart.nBufferWords = FLASHCART_MAX_BUFFER;
+	}
+	FlashCart.nRegions = FlashCartReadCFI(fd_X, fd_Y, 0x2C);
+	if (FlashCart.nRegions > 4) {
+		FlashCart.nRegions = 4;
+	}
+	for (nRegion=0; nRegion<FlashCart.nRegions; nRegion++) {
+		DWORD dwInfo = 0x2D + 4*nRegion;
+		FlashCart.RegionBlocks[nRegion] = (FlashCartReadCFI(fd_X, fd_Y, dwInfo) | (FlashCartReadCFI(fd_X, fd_Y, dwInfo+1) << 8)) + 1;
+		FlashCart.RegionBlockWords[nRegion] = (FlashCartReadCFI(fd_X, fd_Y, dwInfo+2) | (FlashCartReadCFI(fd_X, fd_Y, dwInfo+3) << 8)) * 128;
+		if (0==FlashCart.RegionBlockWords[nRegion]) {
+			FlashCart.RegionBlockWords[nRegion] = 64;
+		}
+	}
+	if (FlashCartIntel!=FlashCart.nCommandSet && FlashCartAMD!=FlashCart.nCommandSet) {
+		FlashCart.nCommandSet = (3==FlashCart.nCommandSet) ? FlashCartIntel : 0;
+	}
+	if (!FlashCart.nCommandSet || !FlashCart.nRegions) {
+		FlashCartCommand(fd_X, 0, 0xF0);
+		FlashCartCommand(fd_X, 0, 0xFF);
+		printf("  unsupported CFI flash (command set %d, %d erase regions)\n", (int)FlashCart.nCommandSet, FlashCart.nRegions);
+		return 0;
+	}
+	FlashCartReset(fd_X);
+
+	//ID for the console, not needed for programming
+	if (FlashCartAMD==FlashCart.nCommandSet) {
+		FlashCartAMDCommand(fd_X, 0, 0x90);
+	} else {
+		FlashCartCommand(fd_X, 0, 0x90);
+	}
+	FlashCartRead(fd_X, fd_Y, 0x00, &FlashCart.wManufacturer);
+	FlashCartRead(fd_X, fd_Y, 0x01, &FlashCart.wDevice);
+	FlashCart.wManufacturer = FlashCartCmd(FlashCart.wManufacturer);
+	FlashCart.wDevice = FlashCartCmd(FlashCart.wDevice);
+	FlashCartReset(fd_X);
+
+	printf("  Flash cart: %s command set, manufacturer 0x%02X, device 0x%04X, %lu KB, write buffer %d words\n",
+	  (FlashCartAMD==FlashCart.nCommandSet) ? "AMD" : "Intel", (unsigned int)FlashCart.wManufacturer & 0xFF, (unsigned int)FlashCart.wDevice,
+	  FlashCart.nSizeWords*2/1024, FlashCart.nBufferWords);
+	for (nRegion=0; nRegion<FlashCart.nRegions; nRegion++) {
+		printf("    erase region %d: %lu blocks of %lu KB\n", nRegion, FlashCart.RegionBlocks[nRegion], FlashCart.RegionBlockWords[nRegion]*2/1024);
+	}
+	JSONEmit("\"event\":\"flash_cart\",\"command_set\":\"%s\",\"manufacturer\":%u,\"device\":%u,\"size\":%lu,\"buffer_words\":%d,\"swap_d0_d1\":%s",
+	  (FlashCartAMD==FlashCart.nCommandSet) ? "amd" : "intel", (unsigned int)FlashCart.wManufacturer & 0xFF, (unsigned int)FlashCart.wDevice,
+	  FlashCart.nSizeWords*2, FlashCart.nBufferWords, FlashCart.bSwapD0D1 ? "true" : "false");
+	return 1;
+}
+
+// Intel status register: bit 7 ready, bits 1, 3-5 errors
+static int FlashCartIntelWait(int fd_X, int fd_Y, DWORD dwAddress, int nTimeout_ms) {
+	struct timeval tStart, tNow;
+	WORD wStatus = 0;
+
+	gettimeofday(&tStart, 0);
+	do {
+		if (!FlashCartRead(fd_X, fd_Y, dwAddress, &wStatus)) {
+			return 0;
+		}
+		if (wStatus & 0x80) {
+			if (wStatus & 0x3A) {
+				printf("\n-> flash status 0x%02X at %06lX", (unsigned int)wStatus & 0xFF, dwAddress);
+				FlashCartCommand(fd_X, dwAddress, 0x50);
+				return 0;
+			}
+			return 1;
+		}
+		gettimeofday(&tNow, 0);
+	} while ((tNow.tv_sec-tStart.tv_sec)*1000 + (tNow.tv_usec-tStart.tv_usec)/1000 < nTimeout_ms);
+	return 0;
+}
+
+// AMD data polling: the word reads as written (0xFFFF after erase) when done,
+// DQ5 set while it is still busy means the chip gave up
+static int FlashCartAMDWait(int fd_X, int fd_Y, DWORD dwAddress, WORD wExpected, int nTimeout_ms) {
+	struct timeval tStart, tNow;
+	WORD wRead = 0;
+
+	gettimeofday(&tStart, 0);
+	do {
+		if (!FlashCartRead(fd_X, fd_Y, dwAddress, &wRead)) {
+			return 0;
+		}
+		if (wRead == wExpected) {
+			return 1;
+		}
+		if (wRead & 0x20) {
+			if (!FlashCartRead(fd_X, fd_Y, dwAddress, &wRead) || wRead != wExpected) {
+				printf("\n-> flash error at %06lX (read 0x%04X)", dwAddress, (unsigned int)wRead);
+				FlashCartReset(fd_X);
+				return 0;
+			}
+			return 1;
+		}
+		gettimeofday(&tNow, 0);
+	} while ((tNow.tv_sec-tStart.tv_sec)*1000 + (tNow.tv_usec-tStart.tv_usec)/1000 < nTimeout_ms);
+	FlashCartReset(fd_X);
+	return 0;
+}
+
+static int FlashCartEraseBlock(int fd_X, int fd_Y, DWORD dwBlock) {
+	if (FlashCartAMD==FlashCart.nCommandSet) {
+		DWORD Address[3] = {0x555, 0x2AA, 0x000000};
+		WORD Data[3];
+
+		Data[0] = FlashCartCmd(0xAA);
+		Data[1] = FlashCartCmd(0x55);
+		Data[2] = FlashCartCmd(0x30);
+		Address[2] = dwBlock;
+		return FlashCartAMDCommand(fd_X, 0, 0x80) && ROMBusWrite(fd_X, Address, Data, 3) && FlashCartAMDWait(fd_X, fd_Y, dwBlock, 0xFFFF, 10000);
+	}
+	//Intel: clear lock bit, erase
+	FlashCartCommand(fd_X, dwBlock, 0x60);
+	FlashCartCommand(fd_X, dwBlock, 0xD0);
+	FlashCartCommand(fd_X, dwBlock, 0x20);
+	FlashCartCommand(fd_X, dwBlock, 0xD0);
+	if (!FlashCartIntelWait(fd_X, fd_Y, dwBlock, 10000)) {
+		return 0;
+	}
+	FlashCartCommand(fd_X, dwBlock, 0xFF);
+	return 1;
+}
+
+// Words in the write buffer of the chip, or single word program without buffer
+static int FlashCartProgram(int fd_X, int fd_Y, DWORD dwBlock, DWORD dwAddress, const WORD* pwData, int nCount) {
+	DWORD Address[3*ROMBUS_WRITE_BATCH];
+	WORD Data[3*ROMBUS_WRITE_BATCH];
+	int nPos, nEntries = 0;
+
+	if (FlashCart.nBufferWords) {
+		if (FlashCartAMD==FlashCart.nCommandSet) {
+			Address[0] = 0x555; Data[0] = FlashCartCmd(0xAA);
+			Address[1] = 0x2AA; Data[1] = FlashCartCmd(0x55);
+			Address[2] = dwBlock; Data[2] = FlashCartCmd(0x25);
+			Address[3] = dwBlock; Data[3] = FlashCartCmd(nCount-1);
+			if (!ROMBusWrite(fd_X, Address, Data, 4)) {
+				return 0;
+			}
+		} else {
+			FlashCartCommand(fd_X, dwBlock, 0xE8);
+			if (!FlashCartIntelWait(fd_X, fd_Y, dwBlock, 100)) {
+				return 0;
+			}
+			FlashCartCommand(fd_X, dwBlock, nCount-1);
+		}
+		if (bAutoAddressMode) {
+			if (!ROMBusWriteBurst(fd_X, dwAddress, pwData, nCount)) {
+				return 0;
+			}
+		} else {
+			for (nPos=0; nPos<nCount; nPos++) {
+				Address[nEntries] = dwAddress+nPos; Data[nEntries++] = pwData[nPos];
+				if (nEntries==ROMBUS_WRITE_BATCH || nPos==nCount-1) {
+					if (!ROMBusWrite(fd_X, Address, Data, nEntries)) {
+						return 0;
+					}
+					nEntries = 0;
+				}
+			}
+		}
+		if (FlashCartAMD==FlashCart.nCommandSet) {
+			return FlashCartCommand(fd_X, dwBlock, 0x29) && FlashCartAMDWait(fd_X, fd_Y, dwAddress+nCount-1, pwData[nCount-1], 100);
+		}
+		FlashCartCommand(fd_X, dwBlock, 0xD0);
+		if (!FlashCartIntelWait(fd_X, fd_Y, dwBlock, 100)) {
+			return 0;
+		}
+		return FlashCartCommand(fd_X, dwBlock, 0xFF);
+	}
+	//single word program, the chip finishes a word before the next one is on the bus
+	for (nPos=0; nPos<nCount; nPos++) {
+		if (FlashCartAMD==FlashCart.nCommandSet) {
+			Address[nEntries] = 0x555; Data[nEntries++] = FlashCartCmd(0xAA);
+			Address[nEntries] = 0x2AA; Data[nEntries++] = FlashCartCmd(0x55);
+			Address[nEntries] = 0x555; Data[nEntries++] = FlashCartCmd(0xA0);
+		} else {
+			Address[nEntries] = dwAddress+nPos; Data[nEntries++] = FlashCartCmd(0x40);
+		}
+		Address[nEntries] = dwAddress+nPos; Data[nEntries++] = pwData[nPos];
+		if (nEntries+4 > 3*ROMBUS_WRITE_BATCH || nPos==nCount-1) {
+			if (!ROMBusWrite(fd_X, Address, Data, nEntries)) {
+				return 0;
+			}
+			nEntries = 0;
+		}
+	}
+	if (FlashCartAMD==FlashCart.nCommandSet) {
+		return FlashCartAMDWait(fd_X, fd_Y, dwAddress+nCount-1, pwData[nCount-1], 100);
+	}
+	if (!FlashCartIntelWait(fd_X, fd_Y, dwAddress+nCount-1, 100)) {
+		return 0;
+	}
+	return FlashCartCommand(fd_X, dwBlock, 0xFF);
+}
+
+// Start and size (words) of the erase block around dwAddress
+static DWORD FlashCartBlock(DWORD dwAddress, DWORD* pnBlockWords) {
+	DWORD dwRegionStart = 0;
+	int nRegion;
+
+	for (nRegion=0; nRegion<FlashCart.nRegions; nRegion++) {
+		DWORD nRegionWords = FlashCart.RegionBlocks[nRegion] * FlashCart.RegionBlockWords[nRegion];
+		if (dwAddress < dwRegionStart + nRegionWords) {
+			*pnBlockWords = FlashCart.RegionBlockWords[nRegion];
+			return dwRegionStart + (dwAddress-dwRegionStart) / *pnBlockWords * *pnBlockWords;
+		}
+		dwRegionStart += nRegionWords;
+	}
+	*pnBlockWords = 0;
+	return dwAddress;
+}
+
+static int ProgramGBAROM(int fd_X, int fd_Y, const char* szFileName) {
+	struct timeval tStart, tPhase, t2;
+	double elapsedTime, phaseTime;
+	float fTimePerOperation = 0;
+	gzFile gzImage;
+	WORD* pwImage;
+	WORD wBlank[FLASHCART_MAX_BUFFER];
+	WORD wRead[0x1000];
+	DWORD nWords, dwAddress, dwBlock, nBlockWords, nChunk, nCount, nRetries = 0, crc, crcRead = 0xFFFFFFFF;
+	int nSize, nTry, Min, Sec, bOK = 1;
+
+	pwImage = (WORD*)malloc(FLASHCART_MAX_SIZE+1);
+	gzImage = gzopen(szFileName, "rb");
+	if (!pwImage || !gzImage) {
+		perror(szFileName);
+		free(pwImage);
+		return EXIT_FAILURE;
+	}
+	nSize = gzread(gzImage, pwImage, FLASHCART_MAX_SIZE+1);
+	gzclose(gzImage);
+	if (nSize<=0 || nSize>FLASHCART_MAX_SIZE) {
+		printf("program: '%s' is empty or larger than 32 MiB\n", szFileName);
+		free(pwImage);
+		return EXIT_FAILURE;
+	}
+	if (nSize & 1) {
+		((BYTE*)pwImage)[nSize++] = 0xFF;
+	}
+	nWords = nSize/2;
+	crc = CRC32(0xFFFFFFFF, (BYTE*)pwImage, nSize) ^ 0xFFFFFFFF;
+	printf("\n\n Program '%s' (%d Byte, CRC32 %08lX) to flash cart ...\n", szFileName, nSize, crc);
+
+	ROMBusInit(fd_X, fd_Y);
+	if (!FlashCartDetect(fd_X, fd_Y)) {
+		free(pwImage);
+		return EXIT_FAILURE;
+	}
+	if (nWords > FlashCart.nSizeWords) {
+		printf("program: image is larger than the flash (%lu KB)\n", FlashCart.nSizeWords*2/1024);
+		free(pwImage);
+		return EXIT_FAILURE;
+	}
+	memset(wBlank, 0xFF, sizeof(wBlank));
+
+	//erase the blocks covered by the image
+	gettimeofday(&tStart, 0);
+	tPhase = tStart;
+	printf("\nerase ...");
+	for (dwAddress=0; dwAddress<nWords && bOK && !end; dwAddress=dwBlock+nBlockWords) {
+		dwBlock = FlashCartBlock(dwAddress, &nBlockWords);
+		if (!nBlockWords) {
+			bOK = 0;
+			break;
+		}
+		if (bConsoleProgress) {
+			printf(".");
+			fflush(stdout);
+		}
+		bOK = FlashCartEraseBlock(fd_X, fd_Y, dwBlock);
+		JSONProgress("rom_program", "word", 0, nWords, nRetries, &tStart);
+	}
+	gettimeofday(&t2, 0);
+	phaseTime = (t2.tv_sec - tPhase.tv_sec) + (t2.tv_usec - tPhase.tv_usec)/1000000.0;
+	ReportPhase("rom_program", "erase", phaseTime);
+
+	//write buffers, all 0xFFFF stays erased
+	tPhase = t2;
+	nChunk = (FlashCart.nBufferWords) ? FlashCart.nBufferWords : 0x100;
+	for (dwAddress=0; dwAddress<nWords && bOK && !end; dwAddress+=nCount) {
+		nCount = (nWords-dwAddress < nChunk) ? nWords-dwAddress : nChunk;
+
+		if (0 == dwAddress % 0x8000) {
+			if (bConsoleProgress) printf("\n-> [%lu0%%] %05lu KB (64 KB per line)", 10*dwAddress/nWords, dwAddress*2/1024);
+			JSONProgress("rom_program", "word", dwAddress, nWords, nRetries, &tStart);
+		}
+		if (!memcmp(&pwImage[dwAddress], wBlank, nCount*2)) {
+			continue;
+		}
+		dwBlock = FlashCartBlock(dwAddress, &nBlockWords);
+		for (nTry=0; nTry<3; nTry++) {
+			if (FlashCartProgram(fd_X, fd_Y, dwBlock, dwAddress, &pwImage[dwAddress], nCount)) {
+				break;
+			}
+			nRetries++;
+			printf("\n-> programming %06lX failed, again ...", dwAddress);
+			FlashCartReset(fd_X);
+		}
+		bOK = (nTry<3);
+	}
+	FlashCartReset(fd_X);
+	gettimeofday(&t2, 0);
+	phaseTime = (t2.tv_sec - tPhase.tv_sec) + (t2.tv_usec - tPhase.tv_usec)/1000000.0;
+	ReportPhase("rom_program", "write", phaseTime);
+
+	//read-back, one latch per block in auto address mode
+	tPhase = t2;
+	if (bOK && !end) {
+		printf("\nverify ...\n");
+	}
+	for (dwAddress=0; dwAddress<nWords && bOK && !end; dwAddress+=nCount) {
+		nCount = (nWords-dwAddress < 0x1000) ? nWords-dwAddress : 0x1000;
+		bOK = ReadROMBlock(fd_X, fd_Y, dwAddress, wRead, nCount);
+		SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		}
+		crcRead = CRC32(crcRead, (BYTE*)wRead, nCount*2);
+		if (bOK && memcmp(wRead, &pwImage[dwAddress], nCount*2)) {
+			DWORD nPos;
+			for (nPos=0; wRead[nPos]==pwImage[dwAddress+nPos]; nPos++);
+			printf("-> %06lX reads 0x%04X instead of 0x%04X\n", dwAddress+nPos, (unsigned int)wRead[nPos], (unsigned int)pwImage[dwAddress+nPos]);
+			bOK = 0;
+		}
+	}
+	crcRead ^= 0xFFFFFFFF;
+	gettimeofday(&t2, 0);
+	phaseTime = (t2.tv_sec - tPhase.tv_sec) + (t2.tv_usec - tPhase.tv_usec)/1000000.0;
+	ReportPhase("rom_program", "verify", phaseTime);
+	SetAddress(fd_X, fd_Y, 0x000000, bLog);
+	SetControlBit(fd_Y, ControlByteDefault);
+	free(pwImage);
+
+	elapsedTime = (t2.tv_sec - tStart.tv_sec) + (t2.tv_usec - tStart.tv_usec)/1000000.0;
+	if (end || !bOK || crcRead!=crc) {
+		printf("programming %s after %g sec\n", (end) ? "cancelled" : "failed", elapsedTime);
+		ReportResult("rom_program", szFileName, nSize, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, nRetries);
+		return EXIT_FAILURE;
+	}
+	fTimePerOperation = elapsedTime * 1000000.0f / nWords;
+	Min = elapsedTime/60;
+	Sec = (elapsedTime-60*Min)+0.5;
+	printf("programming %d KB took %d min and %d sec (%g). (%.0f microsec. per operation)\n", nSize/1024, Min, Sec, elapsedTime, fTimePerOperation);
+	printf("verified: CRC32 %08lX\n", crc);
+	ReportResult("rom_program", szFileName, nSize, crc, "ok", elapsedTime, fTimePerOperation, nRetries);
+	return EXIT_SUCCESS;
+}
+
+
+//###########################################################
+// Range dumps (option --ranges): only the listed ROM ranges are read, in
+// address order, with one latch per range (and per 64 Ki words). Each range
+// goes to its own offset of <game>.part.gba, the rest of a new file stays a
+// hole. <game>.part.txt lists what was read, it can be given to --ranges.
+
+#define RANGES_MAX 256
+#define RANGES_BLOCK 0x1000 //words
+
+static struct RangeStruct {
+	DWORD dwStart;          // words
+	DWORD dwEnd;            // words, exclusive
+} Ranges[RANGES_MAX];
+static int nRanges = 0;
+static WORD RangeBuffer[RANGES_BLOCK];
+static WORD RangeVerifyBuffer[RANGES_BLOCK];
+
+// "<start>-<end>" (end included) or "<start>+<length>", bytes or with "w:" words
+static int RangesAdd(const char* szRange, int bWords) {
+	char* pEnd;
+	unsigned long nStart, nEnd;
+
+	while (isspace((unsigned char)*szRange)) {
+		szRange++;
+	}
+	if (!strncmp(szRange, "w:", 2)) {
+		bWords = 1;
+		szRange += 2;
+	}
+	nStart = strtoul(szRange, &pEnd, 0);
+	if (pEnd==szRange || (*pEnd!='-' && *pEnd!='+')) {
+		return 0;
+	}
+	nEnd = strtoul(pEnd+1, NULL, 0);
+	nEnd = ('+'==*pEnd) ? nStart+nEnd : nEnd+1;
+	if (nEnd<=nStart) {
+		return 0;
+	}
+	if (!bWords) {
+		nStart /= 2;
+		nEnd = (nEnd+1) / 2;
+	}
+	if (nEnd>0x1000000 || nRanges>=RANGES_MAX) {
+		return 0;
+	}
+	Ranges[nRanges].dwStart = nStart;
+	Ranges[nRanges].dwEnd = nEnd;
+	nRanges++;
+	return 1;
+}
+
+static int RangesCompare(const void* p1, const void* p2) {
+	const struct RangeStruct* pRange1 = p1;
+	const struct RangeStruct* pRange2 = p2;
+
+	return (pRange1->dwStart > pRange2->dwStart) - (pRange1->dwStart < pRange2->dwStart);
+}
+
+// Comma separated list or a file with one range per line (a manifest),
+// sorted and merged
+static int RangesParse(const char* szList) {
+	char szLine[256];
+	FILE* fp;
+	int nRange, nMerged;
+
+	nRanges = 0;
+	fp = fopen(szList, "r");
+	if (fp) {
+		while (fgets(szLine, sizeof(szLine), fp)) {
+			szLine[strcspn(szLine, " \t\r\n#")] = '\0';
+			if (szLine[0]!='\0' && !RangesAdd(szLine, 0)) {
+				printf("invalid range '%s' in '%s'\n", szLine, szList);
+				fclose(fp);
+				return 0;
+			}
+		}
+		fclose(fp);
+	} else {
+		const char* pPos = szList;
+		int bWords = !strncmp(pPos, "w:", 2);
+
+		while (*pPos) {
+			size_t nLen = strcspn(pPos, ",");
+			snprintf(szLine, sizeof(szLine), "%.*s", (int)nLen, pPos);
+			if (!RangesAdd(szLine, bWords)) {
+				printf("invalid range '%s'\n", szLine);
+				return 0;
+			}
+			pPos += nLen;
+			pPos += (*pPos==',');
+		}
+	}
+	qsort(Ranges, nRanges, sizeof(Ranges[0]), RangesCompare);
+	for (nRange=1, nMerged=0; nRange<nRanges; nRange++) {
+		if (Ranges[nRange].dwStart <= Ranges[nMerged].dwEnd) {
+			if (Ranges[nRange].dwEnd > Ranges[nMerged].dwEnd) {
+				Ranges[nMerged].dwEnd = Ranges[nRange].dwEnd;
+			}
+		} else {
+			Ranges[++nMerged] = Ranges[nRange];
+		}
+	}
+	if (nRanges) {
+		nRanges = nMerged+1;
+	}
+	return nRanges>0;
+}
+
+// Continues the auto address read of the previous block (unless *pbLatch),
+// with option f a second pass and explicit reads to vote words that differ
+static int RangeReadBlock(int fd_X, int fd_Y, DWORD dwAddress, int nCount, int* pbLatch, DWORD* pnRetries) {
+	struct VoteStruct Vote;
+	int nPos;
+
+	if (!ReadROMRun(fd_X, fd_Y, dwAddress, RangeBuffer, nCount, *pbLatch)) {
+		return 0;
+	}
+	*pbLatch = 0;
+	if (!bVerify) {
+		return 1;
+	}
+	if (!ReadROMBlock(fd_X, fd_Y, dwAddress, RangeVerifyBuffer, nCount)) {
+		return 0;
+	}
+	for (nPos=0; nPos<nCount; nPos++) {
+		if (QualityCheck(QualityBusROM, dwAddress+nPos, RangeBuffer[nPos], RangeVerifyBuffer[nPos])) {
+			WORD wData3;
+			(*pnRetries)++;
+			*pbLatch = 1;
+			printf("-> error %04X<>%04X at %06lX, verify ...", (unsigned int)RangeBuffer[nPos], (unsigned int)RangeVerifyBuffer[nPos], dwAddress+nPos);
+			VoteInit(&Vote, RangeBuffer[nPos], RangeVerifyBuffer[nPos]);
+			while (!VoteResult(&Vote, &RangeBuffer[nPos])) {
+				if (!ReadROMWordExplicit(fd_X, fd_Y, dwAddress+nPos, &wData3)) {
+					return 0;
+				}
+				VoteAdd(&Vote, wData3);
+			}
+			printf(" finally use %04X\n", (unsigned int)RangeBuffer[nPos]);
+		}
+	}
+	return 1;
+}
+
+static int DumpGBARanges(int fd_X, int fd_Y, const char* szGameName) {
+	struct timeval tStart, t2;
+	double elapsedTime;
+	float fTimePerOperation = 0;
+	char szFileName[32], szManifest[32], szTmpFile[40];
+	FILE* fpManifest;
+	DWORD nWords = 0, nDone = 0, nRetries = 0, crcAll = 0xFFFFFFFF;
+	int fd_Part, nRange, bOK = 1;
+
+	for (nRange=0; nRange<nRanges; nRange++) {
+		nWords += Ranges[nRange].dwEnd - Ranges[nRange].dwStart;
+	}
+	snprintf(szFileName, sizeof(szFileName), "%s.part.gba", szGameName);
+	snprintf(szManifest, sizeof(szManifest), "%s.part.txt", szGameName);
+	snprintf(szTmpFile, sizeof(szTmpFile), "%s.tmp", szManifest);
+	printf("\n\n Read %d ranges (%lu Byte) of '%s' to '%s' ...\n", nRanges, nWords*2, szGameName, szFileName);
+
+	//an existing file keeps everything outside of the ranges (repair)
+	fd_Part = open(szFileName, O_WRONLY | O_CREAT, 0644);
+	fpManifest = fopen(szTmpFile, "w");
+	if (fd_Part<0 || !fpManifest) {
+		perror("Could not create range dump");
+		if (fd_Part>=0) close(fd_Part);
+		if (fpManifest) fclose(fpManifest);
+		return EXIT_FAILURE;
+	}
+	fprintf(fpManifest, "# gbxdumper ranges of '%s' in '%s', byte addresses (end included)\n", szGameName, szFileName);
+
+	ROMBusInit(fd_X, fd_Y);
+	gettimeofday(&tStart, 0);
+	for (nRange=0; nRange<nRanges && bOK && !end; nRange++) {
+		DWORD dwAddress = Ranges[nRange].dwStart;
+		DWORD crc = 0xFFFFFFFF, nRangeRetries = nRetries;
+		int bLatch = 1;
+
+		if (bConsoleProgress) printf("-> %06lX-%06lX ", dwAddress*2, Ranges[nRange].dwEnd*2-1);
+		while (dwAddress < Ranges[nRange].dwEnd && !end) {
+			int nCount = (Ranges[nRange].dwEnd-dwAddress < RANGES_BLOCK) ? Ranges[nRange].dwEnd-dwAddress : RANGES_BLOCK;
+
+			if (!RangeReadBlock(fd_X, fd_Y, dwAddress, nCount, &bLatch, &nRetries) ||
+			  nCount*2 != pwrite(fd_Part, RangeBuffer, nCount*2, (off_t)dwAddress*2)) {
+				bOK = 0;
+				break;
+			}
+			crc = CRC32(crc, (BYTE*)RangeBuffer, nCount*2);
+			crcAll = CRC32(crcAll, (BYTE*)RangeBuffer, nCount*2);
+			dwAddress += nCount;
+			nDone += nCount;
+			if (bConsoleProgress) {
+				printf(".");
+				fflush(stdout);
+			}
+			JSONProgress("rom_ranges", "word", nDone, nWords, nRetries, &tStart);
+		}
+		SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		}
+		if (dwAddress < Ranges[nRange].dwEnd) {
+			bOK = 0;
+			break;
+		}
+		crc ^= 0xFFFFFFFF;
+		fprintf(fpManifest, "0x%06lX-0x%06lX crc32 %08lX retries %lu\n", Ranges[nRange].dwStart*2, Ranges[nRange].dwEnd*2-1, crc, nRetries-nRangeRetries);
+		if (bConsoleProgress) printf(" CRC32 %08lX\n", crc);
+	}
+	SetAddress(fd_X, fd_Y, 0x000000, bLog);
+	SetControlBit(fd_Y, ControlByteDefault);
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tStart.tv_sec) + (t2.tv_usec - tStart.tv_usec)/1000000.0;
+	ReportPhase("rom_ranges", "read", elapsedTime);
+
+	if (0!=fsync(fd_Part) || 0!=close(fd_Part)) {
+		bOK = 0;
+	}
+	fflush(fpManifest);
+	fsync(fileno(fpManifest));
+	if (0!=fclose(fpManifest) || (bOK && !end && 0!=rename(szTmpFile, szManifest))) {
+		bOK = 0;
+	}
+	if (end || !bOK) {
+		unlink(szTmpFile);
+		printf("\nrange dump %s after %g sec\n", (end) ? "cancelled" : "failed", elapsedTime);
+		ReportResult("rom_ranges", szFileName, nDone*2, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, nRetries);
+		return EXIT_FAILURE;
+	}
+	fTimePerOperation = elapsedTime * 1000000.0f / nWords;
+	printf("reading %lu Byte in %d ranges took %g sec (%.0f microsec. per operation), manifest '%s'\n", nWords*2, nRanges, elapsedTime, fTimePerOperation, szManifest);
+	ReportResult("rom_ranges", szFileName, nWords*2, crcAll ^ 0xFFFFFFFF, "ok", elapsedTime, fTimePerOperation, nRetries);
+	return EXIT_SUCCESS;
+}
+
+
+//###########################################################
+// GB(C) cartridges: A0-A15 on AD0-AD15, D0-D7 on AD16-AD23, *RES on *CS2
+
+typedef enum  {
+	GBMapperNone = 0,
+	GBMapperMBC1,
+	GBMapperMBC2,
+	GBMapperMBC3,
+	GBMapperMBC5,
+	GBMapperUnknown,
+} GBMapper;
+
+static const int cnGBBankSize = 0x4000;
+static const int cnGBRAMBankSize = 0x2000;
+static BYTE GBBankBuffer[0x4000];
+
+static GBMapper GetGBMapper(BYTE nCartType, int* pbBattery) {
+	*pbBattery = 0;
+	switch (nCartType) {
+		case 0x09: *pbBattery = 1; //fall through
+		case 0x00:
+		case 0x08:
+			return GBMapperNone;
+		case 0x03: *pbBattery = 1; //fall through
+		case 0x01:
+		case 0x02:
+			return GBMapperMBC1;
+		case 0x06: *pbBattery = 1; //fall through
+		case 0x05:
+			return GBMapperMBC2;
+		case 0x0F:
+		case 0x10:
+		case 0x13: *pbBattery = 1; //fall through
+		case 0x11:
+		case 0x12:
+			return GBMapperMBC3;
+		case 0x1B:
+		case 0x1E: *pbBattery = 1; //fall through
+		case 0x19:
+		case 0x1A:
+		case 0x1C:
+		case 0x1D:
+			return GBMapperMBC5;
+	}
+	return GBMapperUnknown;
+}
+
+static int GBWriteByte(int fd_X, WORD wAddress, BYTE nData) {
+	return ByteBusWrite(fd_X, &wAddress, &nData, 1, 0);
+}
+
+//maps ROM bank nBank into the CPU address space, returns the start address of the bank
+static WORD GBSelectROMBank(int fd_X, GBMapper nMapper, int nBank) {
+	WORD Address[2];
+	BYTE Data[2];
+
+	if (0==nBank) {
+		return 0x0000;
+	}
+	switch (nMapper) {
+		case GBMapperMBC1:
+			//banks 0x20, 0x40, 0x60 are only visible at 0x0000 in mode 1
+			Address[0] = 0x4000; Data[0] = (nBank>>5) & 0x03;
+			Address[1] = 0x2000; Data[1] = nBank & 0x1F;
+			ByteBusWrite(fd_X, Address, Data, 2, 0);
+			return (nBank & 0x1F) ? 0x4000 : 0x0000;
+		case GBMapperMBC2:
+			GBWriteByte(fd_X, 0x2100, nBank & 0x0F);
+			break;
+		case GBMapperMBC3:
+			GBWriteByte(fd_X, 0x2000, nBank & 0x7F);
+			break;
+		case GBMapperMBC5:
+			Address[0] = 0x2000; Data[0] = nBank & 0xFF;
+			Address[1] = 0x3000; Data[1] = (nBank>>8) & 0x01;
+			ByteBusWrite(fd_X, Address, Data, 2, 0);
+			break;
+		default:
+			break;
+	}
+	return 0x4000;
+}
+
+static int DumpGBCartROM(int fd_X, int fd_Y, GBMapper nMapper, int nROMSize, const char* szGameFileName, const BYTE* pHeader) {
+	struct timeval tDumpStart, t2;
+	double elapsedTime;
+	float fTimePerOperation = 0;
+	struct DumpFileStruct File;
+	const char cszFilename[] = "game.gb";
+	int nBank, nBanks = nROMSize / cnGBBankSize;
+	DWORD crc = 0xFFFFFFFF;
+	DWORD nRetries = 0;
+	WORD wChecksum = 0;
+	WORD wBankAddress;
+	int nPos;
+
+	printf("\n\n Save GB(C) ROM to '%s' ...\n", szGameFileName);
+	printf("  Size : %d KB (%d banks)\n", nROMSize/1024, nBanks);
+	if (!DumpFileOpen(&File, cszFilename, GBxDataROM)) {
+		GBxReportError(GBxErrorDump, "Could not create file '%s', error %d!", cszFilename, errno);
+		return(EXIT_FAILURE);
+	}
+	if (GBMapperMBC1==nMapper) {
+		GBWriteByte(fd_X, 0x6000, 0x01); //mode 1, upper bank bits also at 0x0000
+	}
+
+	ArchiveBegin();
+	gettimeofday(&tDumpStart, 0);
+	for (nBank=0; nBank<nBanks; nBank++) {
+		if (end) break;
+		if (nBank % 32 == 0 && bConsoleProgress) {
+			printf("\n-> [%d0%%] %04d KB (16 KB per dot)", (10*nBank)/nBanks, nBank*cnGBBankSize/1024);
+			fflush(stdout);
+		}
+		if (bLog) printf("-> ROM bank %d\n", nBank);
+		wBankAddress = GBSelectROMBank(fd_X, nMapper, nBank);
+		if (!ByteBusReadVerified(fd_X, fd_Y, wBankAddress, GBBankBuffer, cnGBBankSize, 0, &nRetries)) {
+			break;
+		}
+		crc = CRC32(crc, GBBankBuffer, cnGBBankSize);
+		for (nPos=0; nPos<cnGBBankSize; nPos++) {
+			wChecksum += GBBankBuffer[nPos];
+		}
+		if (!DumpFileWrite(&File, GBBankBuffer, cnGBBankSize)) {
+			printf("Error wirting to file %s\n", File.szFileName);
+			break;
+		}
+		ArchiveWrite(GBBankBuffer, cnGBBankSize);
+		if (GPIO_SW && nBank>0 && GBxGPIORead(GPIO_SW)==LOW) {
+			printf("\ncancel dumping\n");
+			fflush(stdout);
+			while (!end && GBxGPIORead(GPIO_SW)==LOW) {
+				usleep(500000);
+			}
+			break;
+		}
+		if (bConsoleProgress) {
+			printf(".");
+			fflush(stdout);
+		}
+		JSONProgress("gb_rom", "byte", (nBank+1)*cnGBBankSize, nROMSize, nRetries, &tDumpStart);
+	}
+	if (GBMapperMBC1==nMapper) {
+		WORD Address[3] = {0x6000, 0x4000, 0x2000};
+		BYTE Data[3] = {0x00, 0x00, 0x01};
+		ByteBusWrite(fd_X, Address, Data, 3, 0);
+	}
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tDumpStart.tv_sec)  + (t2.tv_usec - tDumpStart.tv_usec)/1000000.0;
+	if (!DumpFileClose(&File)) {
+		printf("Error wirting to file %s\n", File.szFileName);
+		nBank = 0;
+	}
+	ReportPhase("gb_rom", "read", elapsedTime);
+	if (!end && nBank==nBanks) {
+		const char* szStatus = "ok";
+		int Min, Sec;
+
+		crc ^= 0xFFFFFFFF;
+		//global checksum excludes its own two bytes
+		wChecksum -= pHeader[0x14E] + pHeader[0x14F];
+		if (wChecksum == ((pHeader[0x14E]<<8) | pHeader[0x14F])) {
+			printf("\nGlobal checksum: valid (%04X), CRC32: %08X\n\n", (unsigned int)wChecksum, (unsigned int)crc);
+		} else {
+			printf("\nGlobal checksum: invalid (calc %04X, found %02X%02X), CRC32: %08X\n\n", (unsigned int)wChecksum,
+			  (unsigned int)pHeader[0x14E], (unsigned int)pHeader[0x14F], (unsigned int)crc);
+			szStatus = "checksum_mismatch";
+		}
+		fTimePerOperation = elapsedTime * 1000000.0f / nROMSize;
+		Min = elapsedTime/60;
+		Sec = (elapsedTime-60*Min)+0.5;
+		printf("dumping %d KB took %d min and %d sec (%g). (%.0f microsec. per operation)\n", nROMSize/1024, Min, Sec, elapsedTime, fTimePerOperation);
+		if (!DumpFileRename(&File, szGameFileName, NULL, 0)) {
+			perror("renaming GB dump file failed");
+			Archive.bActive = 0;
+			ReportResult("gb_rom", File.szFileName, nROMSize, crc, "failed", elapsedTime, fTimePerOperation, nRetries);
+			return(EXIT_FAILURE);
+		}
+		ArchiveEnd(szGameFileName);
+		DumpFileFinished(&File);
+		snprintf(szGameFileNameROM, sizeof(szGameFileNameROM), "%s", File.szFileName);
+		ReportResult("gb_rom", File.szFileName, nROMSize, crc, szStatus, elapsedTime, fTimePerOperation, nRetries);
+		return(EXIT_SUCCESS);
+	}
+	Archive.bActive = 0;
+	ReportResult("gb_rom", File.szFileName, nBank*cnGBBankSize, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, nRetries);
+	return(EXIT_FAILURE);
+}
+
+static int DumpGBCartRAM(int fd_X, int fd_Y, GBMapper nMapper, int nRAMSize, const char* szGameFileName) {
+	struct timeval tDumpStart, t2;
+	double elapsedTime;
+	float fTimePerOperation = 0;
+	struct DumpFileStruct File;
+	int nBank, nBanks, nBankSize;
+	DWORD crc = 0xFFFFFFFF;
+	DWORD nRetries = 0;
+	int nRet = EXIT_FAILURE;
+
+	nBankSize = (nRAMSize < cnGBRAMBankSize) ? nRAMSize : cnGBRAMBankSize;
+	nBanks = nRAMSize / nBankSize;
+	printf("\n\n Save GB(C) RAM to '%s' ...\n", szGameFileName);
+	printf("  Size : %d Byte (%d banks)\n", nRAMSize, nBanks);
+	if (!DumpFileOpen(&File, szGameFileName, GBxDataSave)) {
+		perror("Could not create dump file");
+		return(EXIT_FAILURE);
+	}
+	snprintf(szGameFileNameRAM, sizeof(szGameFileNameRAM), "%s", File.szFileName);
+
+	gettimeofday(&tDumpStart, 0);
+	GBWriteByte(fd_X, 0x0000, 0x0A); //RAM enable
+	if (GBMapperMBC1==nMapper && nBanks>1) {
+		GBWriteByte(fd_X, 0x6000, 0x01); //RAM banking mode
+	}
+	for (nBank=0; nBank<nBanks; nBank++) {
+		if (end) break;
+		if (nBanks>1) {
+			GBWriteByte(fd_X, 0x4000, nBank);
+		}
+		if (!ByteBusReadVerified(fd_X, fd_Y, 0xA000, GBBankBuffer, nBankSize, CONTROL_CS, &nRetries)) {
+			break;
+		}
+		crc = CRC32(crc, GBBankBuffer, nBankSize);
+		if (!DumpFileWrite(&File, GBBankBuffer, nBankSize)) {
+			perror("Error writing to ram dump file\n");
+			break;
+		}
+		if (bConsoleProgress) {
+			printf(".");
+			fflush(stdout);
+		}
+		JSONProgress("gb_ram", "byte", (nBank+1)*nBankSize, nRAMSize, nRetries, &tDumpStart);
+	}
+	if (GBMapperMBC1==nMapper && nBanks>1) {
+		WORD Address[2] = {0x4000, 0x6000};
+		BYTE Data[2] = {0x00, 0x00};
+		ByteBusWrite(fd_X, Address, Data, 2, 0);
+	}
+	GBWriteByte(fd_X, 0x0000, 0x00); //RAM disable, protects the save from bus noise
+	gettimeofday(&t2, 0);
+	elapsedTime = (t2.tv_sec - tDumpStart.tv_sec)  + (t2.tv_usec - tDumpStart.tv_usec)/1000000.0;
+	if (!DumpFileClose(&File)) {
+		perror("Error writing to ram dump file\n");
+		nBank = 0;
+	}
+	ReportPhase("gb_ram", "read", elapsedTime);
+	if (!end && nBank==nBanks) {
+		crc ^= 0xFFFFFFFF;
+		fTimePerOperation = elapsedTime * 1000000.0f / nRAMSize;
+		printf("\ndumping %d Byte RAM took %g sec. (%.0f microsec. per operation)\n", nRAMSize, elapsedTime, fTimePerOperation);
+		DumpFileFinished(&File);
+		ReportResult("gb_ram", File.szFileName, nRAMSize, crc, "ok", elapsedTime, fTimePerOperation, nRetries);
+		nRet = EXIT_SUCCESS;
+	} else {
+		ReportResult("gb_ram", File.szFileName, nBank*nBankSize, 0, (end) ? "cancelled" : "failed", elapsedTime, 0, nRetries);
+	}
+	return nRet;
+}
+
+static int DumpGBROM(int fd_X, int fd_Y, int* pbROMDumpDone, int* pbRAMDumpDone) {
+	char szGameName[16+1];
+	BYTE nChar; 
+	int nPos;
+	int nROMSize = 0;
+	int nRAMSize = 0;
+	int bBattery;
+	GBMapper nMapper;
+
+	//GB(C) Header was read by ProbeCartridge
+	if (CartSystemGB==Session.nSystem) {
+		BYTE* Header = Session.GBHeader;
+
+		printf("GB catridge found\n");
+		//GBA: http://problemkaputt.de/gbatek.htm#gbacartridges
+		//GB(C): http://gbdev.gg8.se/wiki/articles/The_Cartridge_Header
+		switch(Header[0x0148]) {
+			case 0x00:
+			default:
+				nROMSize = 32*1024; break;
+			case 0x01:
+				nROMSize = 64*1024; break;
+			case 0x02:
+				nROMSize = 128*1024; break;
+			case 0x03:
+				nROMSize = 256*1024; break;
+			case 0x04:
+				nROMSize = 512*1024; break;
+			case 0x05:
+				nROMSize = 1*1024*1024; break;
+			case 0x06:
+				nROMSize = 2*1024*1024; break;
+			case 0x07:
+				nROMSize = 4*1024*1024; break;
+			case 0x08:
+				nROMSize = 8*1024*1024; break;
+			case 0x52:
+				nROMSize = 72*16*1024; break;
+			case 0x53:
+				nROMSize = 80*16*1024; break;
+			case 0x54:
+				nROMSize = 96*16*1024; break;
+		}
+		switch(Header[0x0149]) {
+			case 0x01:
+				nRAMSize = 2*1024; break;
+			case 0x02:
+				nRAMSize = 8*1024; break;
+			case 0x03:
+				nRAMSize = 32*1024; break;
+			case 0x04:
+				nRAMSize = 128*1024; break;
+			case 0x05:
+				nRAMSize = 64*1024; break;
+			default:
+				nRAMSize = 0; break;
+		}
+		nMapper = GetGBMapper(Header[0x0147], &bBattery);
+		if (GBMapperMBC2==nMapper) {
+			nRAMSize = 512; //internal 512x4 bit
+		}
+		JSONEmit("\"event\":\"header\",\"system\":\"gb\",\"cart_type\":%d,\"cgb\":%s,\"rom_size\":%d,\"ram_size\":%d,\"battery\":%s",
+		  (int)Header[0x0147], (Header[0x0143]>127) ? "true" : "false", nROMSize, nRAMSize, bBattery ? "true" : "false");
+
+		nPos = 0;
+		do {
+			nChar = Header[0x0134+nPos];
+			if (nChar<127) {
+				szGameName[nPos] = nChar; //0x0134-0143
+			}
+		} while (nChar!='\0' && ++nPos<=15);
+		szGameName[nPos] = '\0';
+		strcpy(szGameFileNameROM, szGameName);
+		if (Header[0x0143]>127) {
+			strcat(szGameFileNameROM, ".gbc");
+		} else {
+			strcat(szGameFileNameROM, ".gb");
+		}
+		strcpy(szGameFileNameRAM, szGameName);
+		strcat(szGameFileNameRAM, ".sav");
+		DatBegin(szGameName, "");
+
+		if (GBMapperUnknown==nMapper) {
+			printf("Catridge type %hu not supported\n", Header[0x0147]);	
+			return EXIT_SUCCESS; // found GB(C) catridge
+		}
+		printf("Catridge type 0x%02X (ROM: %d byte, RAM: %d byte%s)\n", (unsigned int)Header[0x0147], nROMSize, nRAMSize, bBattery ? ", battery" : "");
+		if (bBattery && nRAMSize>0) {
+			DatSetSave((GBMapperMBC2==nMapper) ? "MBC2" : "SRAM", nRAMSize);
+			if (EXIT_SUCCESS == DumpGBCartRAM(fd_X, fd_Y, nMapper, nRAMSize, szGameFileNameRAM)) {
+				printf("GB(C) RAM dumped successful!\n");
+				*pbRAMDumpDone = 1;
+			}
+		}
+		if (!end && EXIT_SUCCESS == DumpGBCartROM(fd_X, fd_Y, nMapper, nROMSize, szGameFileNameROM, Header)) {
+			*pbROMDumpDone = 1;
+		}
+		return EXIT_SUCCESS; // found GB(C) catridge
+	} else {
+		printf("no GB(C) Module found\n");
+		return EXIT_FAILURE;
+	}
+}
+
+// GB(C) carts answer on the byte bus with the start of the Nintendo logo,
+// a GBA cart is not selected there and returns open bus (0x00/0xFF). Only
+// the GB(C) header is read completely, the GBA header follows in
+// DumpGBAROMHeader and is kept for the ROM dump.
+static CartSystem ProbeCartridge(int fd_X, int fd_Y) {
+	BYTE Probe[4];
+
+	memset(&Session, 0, sizeof(Session));
+	printf("\nprobing cartridge ...\n");
+	ByteBusInit(fd_X, fd_Y);
+	if (!ByteBusRead(fd_X, fd_Y, 0x0104, Probe, sizeof(Probe), 0)) {
+		return CartSystemNone;
+	}
+	if (memcmp(Probe, GBLogo, sizeof(Probe))) {
+		//logo damaged or unlicensed cart: a title byte is still a GB(C) cart
+		if (!ByteBusRead(fd_X, fd_Y, 0x0134, Probe, 1, 0)) {
+			return CartSystemNone;
+		}
+		if (0x00==Probe[0] || 0xFF==Probe[0]) {
+			Session.nSystem = CartSystemGBA;
+			return CartSystemGBA;
+		}
+	}
+	printf("reading GB(C) Header ...\n");
+	if (!ByteBusRead(fd_X, fd_Y, 0x0100, &Session.GBHeader[0x0100], 0x50, 0)) {
+		return CartSystemNone;
+	}
+	Session.nSystem = CartSystemGB;
+	return CartSystemGB;
+}
+
+
+//###########################################################
+// Wiring calibration (option --calibrate)
+// Address 0 is the same for every bit/byte swap, so a ROM read latched at 0
+// and continued by auto increment returns the header as raw port words.
+
+static BYTE GBAHeaderComplement(const BYTE* pHeader) {
+	WORD wChecksum = 0xFF00;
+	int nAddress;
+
+	for (nAddress=0xA0;  nAddress<=0xBC; nAddress++) {
+		wChecksum-=pHeader[nAddress];
+	}
+	wChecksum -= 0x19;
+	return wChecksum & 0x00FF;
+}
+
+static int ReadROMRaw(int fd_X, int fd_Y, WORD wLowRaw, BYTE nHighRaw, WORD* pwData, int nCount) {
+	int nPos;
+
+	SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+	I2CWriteWord(fd_X, MCP_Write, wLowRaw);
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTA, nHighRaw);
+	ResetControlBit(fd_Y, CONTROL_CS);
+	if (!I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT)) {
+		return 0;
+	}
+	for (nPos=0; nPos<nCount; nPos++) {
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, LOW);
+		} else {
+			ResetControlBit(fd_Y, CONTROL_RD);
+		}
+		if (!I2CReadWord(fd_X, MCP_Read + MCP_PORTA, &pwData[nPos])) {
+			return 0;
+		}
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		} else {
+			SetControlBit(fd_Y, CONTROL_RD);
+		}
+	}
+	SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);
+	return 1;
+}
+
+static int CalibrateGBA(int fd_X, int fd_Y) {
+	WORD RawHeader[0xC0/2];
+	WORD RawProbe[4];
+	BYTE Header[0xC0];
+	int nCombo, nFound = -1, nPos, nBit;
+	int bMirror[8], nMirrorCount = 0;
+
+	printf("write direction IC2 Port A (A16-A23) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+	printf("write direction IC2 Port B (Control) to output, default  ...\n");
+	I2CWrite(fd_Y, MCP_Write  + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+
+	if (!ReadROMRaw(fd_X, fd_Y, 0x0000, 0x00, RawHeader, sizeof(RawHeader)/sizeof(WORD))) {
+		return 0;
+	}
+	for (nCombo=0; nCombo<8; nCombo++) {
+		for (nPos=0; nPos<sizeof(RawHeader)/sizeof(WORD); nPos++) {
+			WORD wData = DecodeROMWord(RawHeader[nPos], nCombo & 1, (nCombo>>1) & 1, (nCombo>>2) & 1);
+			memcpy(&Header[nPos*2], &wData, 2);
+		}
+		if (!memcmp(Logo, &Header[0x04], sizeof(Logo)-4) && GBAHeaderComplement(Header)==Header[0xBD]) {
+			nFound = nCombo;
+			break;
+		}
+	}
+	if (nFound<0) {
+		printf("  GBA: no Nintendo logo found with any AD0-AD15 wiring\n");
+		return 0;
+	}
+	bAD0_7_swap = nFound & 1;
+	bAD8_15_swap = (nFound>>1) & 1;
+	bAD0_7_AD8_15_swap = (nFound>>2) & 1;
+	printf("  GBA: logo and complement match with AD0-7 %s, AD8-15 %s, bytes %s\n",
+	  bAD0_7_swap ? "swapped" : "straight", bAD8_15_swap ? "swapped" : "straight", bAD0_7_AD8_15_swap ? "swapped" : "straight");
+
+	//a high address bit beyond the ROM size mirrors the header or returns open bus (the latched address)
+	for (nBit=0; nBit<8; nBit++) {
+		if (!ReadROMRaw(fd_X, fd_Y, 0x0000, 1<<nBit, RawProbe, 4)) {
+			return 0;
+		}
+		bMirror[nBit] = !memcmp(RawProbe, RawHeader, sizeof(RawProbe));
+		if (!bMirror[nBit]) {
+			bMirror[nBit] = 1;
+			for (nPos=0; nPos<4; nPos++) {
+				if (DecodeROMWord(RawProbe[nPos], bAD0_7_swap, bAD8_15_swap, bAD0_7_AD8_15_swap)!=nPos) {
+					bMirror[nBit] = 0;
+				}
+			}
+		}
+		nMirrorCount += bMirror[nBit];
+	}
+	//only the upper address bits are unused -> mirrored bits at the top are straight wiring
+	if (nMirrorCount>0 && nMirrorCount<8) {
+		int bUpper = 1, bLower = 1;
+		for (nBit=0; nBit<8; nBit++) {
+			if (bMirror[nBit] != (nBit>=8-nMirrorCount)) bUpper = 0;
+			if (bMirror[nBit] != (nBit<nMirrorCount)) bLower = 0;
+		}
+		if (bUpper || bLower) {
+			bAD16_23_swap = bLower;
+			printf("  GBA: %d unused high address bits, AD16-23 %s\n", nMirrorCount, bAD16_23_swap ? "swapped" : "straight");
+		} else {
+			printf("  GBA: inconsistent high address probe, keep AD16-23 %s\n", bAD16_23_swap ? "swapped" : "straight");
+		}
+	} else {
+		printf("  GBA: ROM uses all high address bits, keep AD16-23 %s\n", bAD16_23_swap ? "swapped" : "straight");
+	}
+	return 1;
+}
+
+static int CalibrateGB(int fd_X, int fd_Y) {
+	BYTE nData;
+	int nCombo, nPos, bMatch, bMatchRev;
+
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_INPUT);
+	I2CWrite(fd_Y, MCP_PullUp + MCP_PORTA, MCP_ON);
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByte);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+	SetControlBit(fd_Y, ControlByteDefault);
+
+	for (nCombo=0; nCombo<8; nCombo++) {
+		bMatch = 1;
+		bMatchRev = 1;
+		for (nPos=0; nPos<8 && (bMatch || bMatchRev); nPos++) {
+			I2CWriteWord(fd_X, MCP_Write, EncodeROMWord(0x0104+nPos, nCombo & 1, (nCombo>>1) & 1, (nCombo>>2) & 1));
+			ResetControlBit(fd_Y, CONTROL_RD);
+			if (bRDviaGIOMode) {
+				GBxGPIOWrite(GPIO_RD, LOW);
+			}
+			if (!I2CRead(fd_Y, MCP_Read + MCP_PORTA, &nData)) {
+				return 0;
+			}
+			if (bRDviaGIOMode) {
+				GBxGPIOWrite(GPIO_RD, HIGH);
+			}
+			SetControlBit(fd_Y, CONTROL_RD);
+			if (nData!=GBLogo[nPos]) bMatch = 0;
+			if (nData!=revtable[GBLogo[nPos]]) bMatchRev = 0;
+		}
+		if (bMatch || bMatchRev) {
+			bAD0_7_swap = nCombo & 1;
+			bAD8_15_swap = (nCombo>>1) & 1;
+			bAD0_7_AD8_15_swap = (nCombo>>2) & 1;
+			bAD16_23_swap = bMatchRev;
+			printf("  GB: logo match with AD0-7 %s, AD8-15 %s, bytes %s, D0-7 (AD16-23) %s\n",
+			  bAD0_7_swap ? "swapped" : "straight", bAD8_15_swap ? "swapped" : "straight",
+			  bAD0_7_AD8_15_swap ? "swapped" : "straight", bAD16_23_swap ? "swapped" : "straight");
+			return 1;
+		}
+	}
+	printf("  GB: no Nintendo logo found with any wiring\n");
+	return 0;
+}
+
+static int CalibrateWiring(int fd_X, int fd_Y) {
+	int bFound;
+
+	printf("\ncalibrating wiring ...\n");
+	bFound = CalibrateGBA(fd_X, fd_Y);
+	if (!bFound && !end) {
+		bFound = CalibrateGB(fd_X, fd_Y);
+	}
+	//leave all address lines low, which is valid for every wiring
+	SetControlBit(fd_Y, ControlByteDefault);
+	I2CWriteWord(fd_X, MCP_Write, 0x0000);
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTA, 0x00);
+	GBA_Last_LowAddress = 0;
+	GBA_Last_LowAddress_A = 0;
+	GBA_Last_LowAddress_B = 0;
+	GBA_Last_HighAddress = 0;
+	if (!bFound) {
+		return 0;
+	}
+	JSONEmit("\"event\":\"wiring\",\"swap_ad0_7\":%d,\"swap_ad8_15\":%d,\"swap_ad16_23\":%d,\"swap_ad0_7_ad8_15\":%d",
+	  bAD0_7_swap, bAD8_15_swap, bAD16_23_swap, bAD0_7_AD8_15_swap);
+	if (szProfileFile && ProfileSave(szProfileFile)) {
+		printf("  board profile saved to '%s'\n", szProfileFile);
+	}
+	return 1;
+}
+
+
+//###########################################################
+// Read strategy tuning (option --tune): a sample window at the start of the
+// GBA ROM is read several times with each address mode (-n). RD over GPIO
+// or I2C (-r) is set by the jumper of the board and not changed. A strategy
+// whose own majority is no valid GBA header is dropped, the others are
+// compared with the majority of all of them. The cheapest strategy below
+// TUNE_MAX_ERROR_RATE is used for the dump, with verify (-f) if its reads
+// still disagreed (counted twice). With --profile the choice is saved for
+// the board, -n and -f given as options are kept.
+
+#define TUNE_WORDS 0x800
+#define TUNE_READS 3
+#define TUNE_MAX_ERROR_RATE 0.001
+
+// bit 0 RD via GPIO, bit 1 auto address mode
+static const char* TuneStrategyName[4] = {"I2C RD, explicit", "GPIO RD, explicit", "I2C RD, auto address", "GPIO RD, auto address"};
+static WORD TuneBuffer[4][TUNE_READS][TUNE_WORDS];
+static WORD TuneReference[TUNE_WORDS];
+
+// Bitwise majority of all reads of the tested strategies
+static void TuneMajority(const int* pbTested) {
+	int nStrategy, nRead, nPos, nBit, nOnes, nReads;
+
+	for (nPos=0; nPos<TUNE_WORDS; nPos++) {
+		TuneReference[nPos] = 0;
+		for (nBit=0; nBit<16; nBit++) {
+			nOnes = 0;
+			nReads = 0;
+			for (nStrategy=0; nStrategy<4; nStrategy++) {
+				if (!pbTested[nStrategy]) continue;
+				for (nRead=0; nRead<TUNE_READS; nRead++) {
+					nOnes += (TuneBuffer[nStrategy][nRead][nPos] >> nBit) & 1;
+					nReads++;
+				}
+			}
+			if (2*nOnes > nReads) {
+				TuneReference[nPos] |= 1 << nBit;
+			}
+		}
+	}
+}
+
+// Majority of the reads is a GBA header (logo and complement)
+static int TuneHeaderValid(void) {
+	BYTE Header[0xC0];
+	int nPos;
+
+	for (nPos=0; nPos<sizeof(Header)/sizeof(WORD); nPos++) {
+		memcpy(&Header[nPos*2], &TuneReference[nPos], 2);
+	}
+	return !memcmp(Logo, &Header[0x04], sizeof(Logo)-4) && GBAHeaderComplement(Header)==Header[0xBD];
+}
+
+static int TuneReadStrategy(int fd_X, int fd_Y) {
+	struct timeval t1, t2;
+	double fTime[4], fCost, fBestCost = 0;
+	DWORD nErrors[4];
+	int bTested[4] = {0, 0, 0, 0};
+	int bAutoAddressModeSet = bAutoAddressMode;
+	int nRDMode = bRDviaGIOMode ? 1 : 0;
+	int nStrategy, nRead, nPos, nBest = -1, bOK = 1;
+
+	printf("\ntuning read strategy (%d words, %d reads each) ...\n", TUNE_WORDS, TUNE_READS);
+	ROMBusInit(fd_X, fd_Y);
+	for (nStrategy=0; nStrategy<4 && bOK && !end; nStrategy++) {
+		if ((nStrategy & 1) != nRDMode) {
+			continue;
+		}
+		if (ProfileKept(&bAutoAddressMode) && ((nStrategy>>1) & 1) != (bAutoAddressModeSet ? 1 : 0)) {
+			continue;
+		}
+		bAutoAddressMode = (nStrategy>>1) & 1;
+		gettimeofday(&t1, 0);
+		for (nRead=0; nRead<TUNE_READS && bOK; nRead++) {
+			bOK = ReadROMBlock(fd_X, fd_Y, 0x000000, TuneBuffer[nStrategy][nRead], TUNE_WORDS);
+		}
+		SetControlBit(fd_Y, CONTROL_CS | CONTROL_RD);
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		}
+		gettimeofday(&t2, 0);
+		fTime[nStrategy] = ((t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec)/1000000.0) * 1000000.0 / (TUNE_WORDS*TUNE_READS);
+		bTested[nStrategy] = bOK;
+	}
+	bAutoAddressMode = bAutoAddressModeSet;
+	SetAddress(fd_X, fd_Y, 0x000000, bLog);
+	SetControlBit(fd_Y, ControlByteDefault);
+	if (!bOK || end) {
+		printf("  tuning failed, keep settings\n");
+		return 0;
+	}
+
+	//a strategy that misreads the header would bend the majority of the others
+	for (nStrategy=0; nStrategy<4; nStrategy++) {
+		int bOwn[4] = {0, 0, 0, 0};
+
+		if (!bTested[nStrategy]) continue;
+		bOwn[nStrategy] = 1;
+		TuneMajority(bOwn);
+		if (!TuneHeaderValid()) {
+			printf("  %-22s no valid header, dropped\n", TuneStrategyName[nStrategy]);
+			JSONEmit("\"event\":\"tune\",\"rd_gpio\":%s,\"auto_address\":%s,\"us_per_word\":%.1f,\"header_valid\":false",
+			  (nStrategy & 1) ? "true" : "false", (nStrategy & 2) ? "true" : "false", fTime[nStrategy]);
+			bTested[nStrategy] = 0;
+		}
+	}
+	TuneMajority(bTested);
+	for (nStrategy=0; nStrategy<4; nStrategy++) {
+		if (!bTested[nStrategy]) continue;
+		nErrors[nStrategy] = 0;
+		for (nRead=0; nRead<TUNE_READS; nRead++) {
+			for (nPos=0; nPos<TUNE_WORDS; nPos++) {
+				nErrors[nStrategy] += TuneBuffer[nStrategy][nRead][nPos] != TuneReference[nPos];
+			}
+		}
+		printf("  %-22s %6.0f microsec. per word, %lu of %d words differ\n", TuneStrategyName[nStrategy], fTime[nStrategy], nErrors[nStrategy], TUNE_WORDS*TUNE_READS);
+		JSONEmit("\"event\":\"tune\",\"rd_gpio\":%s,\"auto_address\":%s,\"us_per_word\":%.1f,\"header_valid\":true,\"errors\":%lu,\"words\":%d",
+		  (nStrategy & 1) ? "true" : "false", (nStrategy & 2) ? "true" : "false", fTime[nStrategy], nErrors[nStrategy], TUNE_WORDS*TUNE_READS);
+		if (nErrors[nStrategy] > TUNE_MAX_ERROR_RATE * TUNE_WORDS*TUNE_READS) {
+			continue;
+		}
+		fCost = (nErrors[nStrategy]) ? 2*fTime[nStrategy] : fTime[nStrategy];
+		if (nBest<0 || fCost<fBestCost) {
+			nBest = nStrategy;
+			fBestCost = fCost;
+		}
+	}
+	if (nBest<0) {
+		printf("  no strategy below %g errors per word, keep settings with verify\n", TUNE_MAX_ERROR_RATE);
+		bVerify = 1;
+		return 0;
+	}
+	bAutoAddressMode = (nBest>>1) & 1;
+	bVerify = nErrors[nBest]>0 || ProfileKept(&bVerify);
+	printf("  use %s%s\n", TuneStrategyName[nBest], (bVerify) ? " with verify" : "");
+	JSONEmit("\"event\":\"tune_result\",\"rd_gpio\":%s,\"auto_address\":%s,\"verify\":%s",
+	  bRDviaGIOMode ? "true" : "false", bAutoAddressMode ? "true" : "false", bVerify ? "true" : "false");
+	if (szProfileFile && ProfileSave(szProfileFile)) {
+		printf("  board profile saved to '%s'\n", szProfileFile);
+	}
+	return 1;
+}
+
+
+//###########################################################
+// Cartridge insertion (option --auto-start): instead of the switch the bus
+// is probed a few times per second. A GB(C) logo on the byte bus or a GBA
+// logo with valid header complement (any AD0-AD15 wiring) is a cartridge,
+// INSERT_DEBOUNCE equal probes in a row start the dump. The cartridge of
+// the last start (header hash) has to be removed before it starts again.
+
+#define INSERT_POLL_MS 400
+#define INSERT_DEBOUNCE 3
+
+static DWORD InsertLastHash = 0;               // 0: none started yet
+
+// Header hash of the seated cartridge (never 0), CartSystemNone if empty
+static CartSystem InsertProbe(int fd_X, int fd_Y, DWORD* pdwHash) {
+	WORD RawHeader[0xC0/2];
+	BYTE Header[0xC0];
+	int nCombo, nPos;
+	DWORD crc;
+
+	//GB(C): 0x0104-0x014F on the byte bus
+	ByteBusInitQuiet(fd_X, fd_Y);
+	if (!ByteBusRead(fd_X, fd_Y, 0x0104, Header, 0x0150-0x0104, 0)) {
+		return CartSystemNone;
+	}
+	if (!memcmp(Header, GBLogo, 0x30)) {
+		crc = CRC32(0xFFFFFFFF, Header, 0x0150-0x0104) ^ 0xFFFFFFFF;
+		*pdwHash = (crc) ? crc : 1;
+		return CartSystemGB;
+	}
+	//the GBA probe drives A16-A23 on D0-D7: only if no GB(C) cartridge
+	//(also half inserted) answers in the title area, like ProbeCartridge
+	for (nPos=0x0134; nPos<0x0144; nPos++) {
+		if (0x00!=Header[nPos-0x0104] && 0xFF!=Header[nPos-0x0104]) {
+			return CartSystemNone;
+		}
+	}
+
+	//GBA: raw header from address 0, like the wiring calibration
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+	GBA_Last_LowAddress = 0;
+	GBA_Last_LowAddress_A = 0;
+	GBA_Last_LowAddress_B = 0;
+	GBA_Last_HighAddress = 0;
+	if (!ReadROMRaw(fd_X, fd_Y, 0x0000, 0x00, RawHeader, sizeof(RawHeader)/sizeof(WORD))) {
+		return CartSystemNone;
+	}
+	SetControlBit(fd_Y, ControlByteDefault);
+	for (nCombo=0; nCombo<8; nCombo++) {
+		for (nPos=0; nPos<sizeof(RawHeader)/sizeof(WORD); nPos++) {
+			WORD wData = DecodeROMWord(RawHeader[nPos], nCombo & 1, (nCombo>>1) & 1, (nCombo>>2) & 1);
+			memcpy(&Header[nPos*2], &wData, 2);
+		}
+		if (!memcmp(Logo, &Header[0x04], sizeof(Logo)-4) && GBAHeaderComplement(Header)==Header[0xBD]) {
+			crc = CRC32(0xFFFFFFFF, Header, sizeof(Header)) ^ 0xFFFFFFFF;
+			*pdwHash = (crc) ? crc : 1;
+			return CartSystemGBA;
+		}
+	}
+	return CartSystemNone;
+}
+
+// Blocks until a new cartridge is seated, CartSystemNone after GBxAbort.
+// Insertion and removal both need INSERT_DEBOUNCE equal probes.
+CartSystem GBxWaitCartridge(struct GBxSession* pSession) {
+	CartSystem nSystem, nLastSystem = CartSystemNone;
+	DWORD dwHash = 0, dwLastHash = 0;
+	int nStable = 0, nEmpty = 0, bSeated = 0, bRemoved = 0;
+
+	printf("waiting for a cartridge ...\n");
+	while (!end) {
+		nSystem = InsertProbe(pSession->fd_X, pSession->fd_Y, &dwHash);
+		if (CartSystemNone == nSystem) {
+			nStable = 0;
+			if (++nEmpty == INSERT_DEBOUNCE) {
+				if (bSeated) {
+					printf("cartridge removed\n");
+					JSONEmit("\"event\":\"cart_removed\"");
+				}
+				bSeated = 0;
+				bRemoved = 1;
+			}
+		} else {
+			nEmpty = 0;
+			nStable = (nSystem == nLastSystem && dwHash == dwLastHash) ? nStable+1 : 1;
+		}
+		nLastSystem = nSystem;
+		dwLastHash = dwHash;
+		if (nStable == INSERT_DEBOUNCE) {
+			if (bRemoved || dwHash != InsertLastHash) {
+				printf("%s cartridge inserted (header %08lX)\n", (CartSystemGB==nSystem) ? "GB(C)" : "GBA", dwHash);
+				JSONEmit("\"event\":\"cart_inserted\",\"system\":\"%s\",\"header_hash\":\"%08lX\"", (CartSystemGB==nSystem) ? "gb" : "gba", dwHash);
+				InsertLastHash = dwHash;
+				return nSystem;
+			}
+			if (!bSeated) {
+				printf("same cartridge still seated (header %08lX), please remove it\n", dwHash);
+			}
+			bSeated = 1;
+		}
+		usleep(INSERT_POLL_MS*1000);
+	}
+	return CartSystemNone;
+}
+
+
+//###########################################################
+// Bus self-test (option --self-test), before each cartridge and well below
+// a second: the 24 lines of both expanders are driven with walking ones and
+// zeros and read back from the GPIO register, read as inputs with pull-ups,
+// and the control lines are pulled low one at a time. With a cartridge the
+// header is read at addresses that differ in one address line.
+
+static const char* SelfTestControlName[4] = {"WR", "RD", "CS", "CS2"};
+
+// Raw line 0-15 IC1 port A/B, 16-23 IC2 port A -> AD line of the wiring
+static int SelfTestLine(int nRaw) {
+	int nBit = nRaw & 7;
+
+	if (nRaw>=16) {
+		return 16 + (bAD16_23_swap ? 7-nBit : nBit);
+	}
+	if (nRaw<8) {
+		return (bAD0_7_AD8_15_swap ? 8 : 0) + (bAD0_7_swap ? 7-nBit : nBit);
+	}
+	return (bAD0_7_AD8_15_swap ? 0 : 8) + (bAD8_15_swap ? 7-nBit : nBit);
+}
+
+static const char* SelfTestLineName(char* szName, int nRaw) {
+	sprintf(szName, "AD%d (IC%d port %c bit %d)", SelfTestLine(nRaw), nRaw<16 ? 1 : 2, (nRaw & 8) ? 'B' : 'A', nRaw & 7);
+	return szName;
+}
+
+static int SelfTestWrite(int fd_X, int fd_Y, DWORD dwRaw) {
+	return I2CWriteWord(fd_X, MCP_Write, dwRaw & 0xFFFF) && I2CWrite(fd_Y, MCP_Write + MCP_PORTA, (dwRaw >> 16) & 0xFF);
+}
+
+static int SelfTestRead(int fd_X, int fd_Y, DWORD* pdwRaw) {
+	WORD wLow;
+	BYTE nHigh;
+
+	if (!I2CReadWord(fd_X, MCP_Read + MCP_PORTA, &wLow) || !I2CRead(fd_Y, MCP_Read + MCP_PORTA, &nHigh)) {
+		return 0;
+	}
+	*pdwRaw = wLow | ((DWORD)nHigh << 16);
+	return 1;
+}
+
+// Expander lines and control lines, 0 and the diagnosis on stdout if a
+// line is stuck, shorted or an expander does not answer
+static int BusSelfTest(int fd_X, int fd_Y) {
+	DWORD Shorted[24];
+	DWORD dwStuckLow = 0, dwStuckHigh = 0, dwPullLow = 0, dwRead, dwBit;
+	WORD wPullUpX;
+	BYTE nPullUpY, nValue, nControl;
+	struct timeval t1, t2;
+	char szName[40], szName2[40];
+	int nRaw, nRaw2, nFaults = 0;
+
+	gettimeofday(&t1, 0);
+	printf("\nbus self-test ...\n");
+	if (!I2CRead(fd_X, MCP_IOCON, &nValue)) {
+		printf("  IC1 (AD0-AD15) does not answer at 0x%02X (option -l)\n", SlaveAddr_IC1);
+		return 0;
+	}
+	if (!I2CRead(fd_Y, MCP_IOCON, &nValue)) {
+		printf("  IC2 (A16-A23, Control) does not answer at 0x%02X (option -h)\n", SlaveAddr_IC2);
+		return 0;
+	}
+	//control lines inactive first, the cartridge must not drive the bus
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByteDefault);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTB, MCP_OUTPUT);
+	ControlByte = ControlByteDefault;
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	//two addresses, two chips
+	I2CWrite(fd_X, MCP_Write + MCP_PORTA, 0x5A);
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTA, 0xA5);
+	if (!I2CRead(fd_X, MCP_Write + MCP_PORTA, &nValue) || nValue!=0x5A) {
+		printf("  IC1 and IC2 answer at the same address (options -l and -h)\n");
+		return 0;
+	}
+
+	//all lines high and low find stuck lines, walking ones and zeros
+	//find lines that follow another one
+	memset(Shorted, 0, sizeof(Shorted));
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_OUTPUT);
+	if (!SelfTestWrite(fd_X, fd_Y, 0xFFFFFF) || !SelfTestRead(fd_X, fd_Y, &dwRead)) {
+		return 0;
+	}
+	dwStuckLow = ~dwRead & 0xFFFFFF;
+	if (!SelfTestWrite(fd_X, fd_Y, 0) || !SelfTestRead(fd_X, fd_Y, &dwRead)) {
+		return 0;
+	}
+	dwStuckHigh = dwRead & 0xFFFFFF;
+	for (nRaw=0; nRaw<24; nRaw++) {
+		dwBit = 1UL << nRaw;
+		if (!SelfTestWrite(fd_X, fd_Y, dwBit) || !SelfTestRead(fd_X, fd_Y, &dwRead)) {
+			return 0;
+		}
+		Shorted[nRaw] |= (dwRead ^ dwBit) & ~dwBit;
+		if (!SelfTestWrite(fd_X, fd_Y, ~dwBit & 0xFFFFFF) || !SelfTestRead(fd_X, fd_Y, &dwRead)) {
+			return 0;
+		}
+		Shorted[nRaw] |= (dwRead ^ ~dwBit) & ~dwBit & 0xFFFFFF;
+	}
+	SelfTestWrite(fd_X, fd_Y, 0);
+
+	//inputs with pull-ups read high, the cartridge is not selected
+	I2CReadWord(fd_X, MCP_PullUp, &wPullUpX);
+	I2CRead(fd_Y, MCP_PullUp + MCP_PORTA, &nPullUpY);
+	I2CWriteWord(fd_X, MCP_PullUp, MCP_WON);
+	I2CWrite(fd_Y, MCP_PullUp + MCP_PORTA, MCP_ON);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_INPUT);
+	if (SelfTestRead(fd_X, fd_Y, &dwRead)) {
+		dwPullLow = ~dwRead & ~dwStuckLow & 0xFFFFFF;
+	}
+	I2CWriteWord(fd_X, MCP_PullUp, wPullUpX);
+	I2CWrite(fd_Y, MCP_PullUp + MCP_PORTA, nPullUpY);
+
+	for (nRaw=0; nRaw<24; nRaw++) {
+		dwBit = 1UL << nRaw;
+		if (dwStuckLow & dwBit) {
+			printf("  %s stuck low\n", SelfTestLineName(szName, nRaw));
+			nFaults++;
+		} else if (dwStuckHigh & dwBit) {
+			printf("  %s stuck high\n", SelfTestLineName(szName, nRaw));
+			nFaults++;
+		} else if (dwPullLow & dwBit) {
+			printf("  %s reads low with pull-up (short to GND?)\n", SelfTestLineName(szName, nRaw));
+			nFaults++;
+		}
+		for (nRaw2=nRaw+1; nRaw2<24; nRaw2++) {
+			if ((((Shorted[nRaw] >> nRaw2) | (Shorted[nRaw2] >> nRaw)) & 1) && !(((dwStuckLow | dwStuckHigh) >> nRaw2) & 1)
+			  && !((dwStuckLow | dwStuckHigh) & dwBit)) {
+				printf("  %s shorted to %s\n", SelfTestLineName(szName, nRaw), SelfTestLineName(szName2, nRaw2));
+				nFaults++;
+			}
+		}
+	}
+
+	//control lines, one at a time low (address 0, data 0x00 for GB MBC writes),
+	//a GB(C) cartridge drives D0-D7 (IC2 port A) while RD is low
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WOUTPUT);
+	I2CWrite(fd_Y, MCP_PullUp + MCP_PORTA, MCP_ON);
+	for (nRaw=0; nRaw<=4; nRaw++) {
+		BYTE nBit = nRaw<4 ? (1<<nRaw) : 0;
+		BYTE nMask = 0x0F;
+
+		if (bRDviaGIOMode) {
+			nMask &= ~CONTROL_RD;
+			if (CONTROL_RD==nBit) continue;
+		}
+		I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, (CONTROL_RD==nBit) ? MCP_INPUT : MCP_OUTPUT);
+		if (!I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByteDefault & ~nBit) || !I2CRead(fd_Y, MCP_Read + MCP_PORTB, &nControl)) {
+			return 0;
+		}
+		if (CONTROL_RD==nBit) {
+			I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByteDefault);
+		}
+		nControl = (nControl ^ (ControlByteDefault & ~nBit)) & nMask;
+		for (nRaw2=0; nRaw2<4; nRaw2++) {
+			if (!(nControl & (1<<nRaw2))) {
+				continue;
+			}
+			if ((1<<nRaw2)==nBit) {
+				printf("  *%s does not go low\n", SelfTestControlName[nRaw2]);
+			} else if (nBit) {
+				printf("  *%s follows *%s\n", SelfTestControlName[nRaw2], SelfTestControlName[nRaw]);
+			} else {
+				printf("  *%s stuck low\n", SelfTestControlName[nRaw2]);
+			}
+			nFaults++;
+		}
+	}
+	I2CWrite(fd_Y, MCP_Write + MCP_PORTB, ControlByteDefault);
+	I2CWrite(fd_Y, MCP_Direction + MCP_PORTA, MCP_INPUT);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, LOW);
+		if (GBxGPIORead(GPIO_RD)!=LOW) {
+			printf("  *RD (GPIO %d) does not go low\n", GPIO_RD);
+			nFaults++;
+		}
+		GBxGPIOWrite(GPIO_RD, HIGH);
+		if (GBxGPIORead(GPIO_RD)!=HIGH) {
+			printf("  *RD (GPIO %d) stuck low\n", GPIO_RD);
+			nFaults++;
+		}
+	}
+
+	//bus idle like after ByteBusInit
+	I2CWrite(fd_Y, MCP_PullUp + MCP_PORTA, nPullUpY);
+	I2CWriteWord(fd_X, MCP_Direction, MCP_WINPUT);
+	GBA_Last_LowAddress = 0;
+	GBA_Last_LowAddress_A = 0;
+	GBA_Last_LowAddress_B = 0;
+	GBA_Last_HighAddress = 0;
+	gettimeofday(&t2, 0);
+	printf("bus self-test %s (%ld ms)\n", nFaults ? "failed" : "passed",
+	  (t2.tv_sec-t1.tv_sec)*1000 + (t2.tv_usec-t1.tv_usec)/1000);
+	JSONEmit("\"event\":\"selftest\",\"part\":\"bus\",\"faults\":%d", nFaults);
+	return 0==nFaults;
+}
+
+// Header reads at addresses that differ in one address line. GBA: logo
+// words 0x02-0x4F (AD0-AD6), GB(C): logo bytes 0x104-0x133 (A0-A5).
+// Without a readable header (no cartridge) the test is skipped.
+static int CartSelfTest(int fd_X, int fd_Y) {
+	struct {
+		DWORD dwFirst;      // first logo address
+		DWORD dwEnd;
+		int nLines;
+	} const Range[2] = {{0x104, 0x134, 6}, {0x02, 0x50, 7}};
+	DWORD Address[2];
+	WORD Expected[2], Read[2];
+	BYTE Title[0x0144-0x0134];
+	char szReport[512];
+	size_t nReport;
+	int nSystem, nLine, nSide, nMatches, nReads, nFaults, nPos;
+
+	//GB(C) first on the byte bus, the GBA reads drive A16-A23 on D0-D7
+	for (nSystem=0; nSystem<2; nSystem++) {
+		DWORD dwFirst = Range[nSystem].dwFirst;
+		DWORD dwEnd = Range[nSystem].dwEnd;
+		int bGB = (0==nSystem);
+
+		nMatches = nReads = nFaults = 0;
+		szReport[0] = '\0';
+		nReport = 0;
+		if (bGB) {
+			ByteBusInit(fd_X, fd_Y);
+		} else {
+			//no GBA reads against a GB(C) cartridge with a damaged logo, like ProbeCartridge
+			if (!ByteBusRead(fd_X, fd_Y, 0x0134, Title, sizeof(Title), 0)) {
+				return 0;
+			}
+			for (nPos=0; nPos<sizeof(Title); nPos++) {
+				if (0x00!=Title[nPos] && 0xFF!=Title[nPos]) {
+					printf("address line test skipped: GB(C) title without logo (cartridge seated?)\n");
+					return 1;
+				}
+			}
+			//A16-A23 driven with 0, the logo words are below 0x10000
+			ROMBusInit(fd_X, fd_Y);
+		}
+		for (nLine=0; nLine<Range[nSystem].nLines && !end; nLine++) {
+			//both addresses in the logo and with different content
+			for (Address[0]=dwFirst; Address[0]<dwEnd; Address[0]++) {
+				Address[1] = Address[0] ^ (1UL<<nLine);
+				if (Address[1]<dwFirst || Address[1]>=dwEnd) {
+					continue;
+				}
+				for (nSide=0; nSide<2; nSide++) {
+					DWORD dwOffset = Address[nSide]-dwFirst;
+					Expected[nSide] = bGB ? GBLogo[dwOffset] : (Logo[dwOffset*2] | (Logo[dwOffset*2+1] << 8));
+				}
+				if (Expected[0]!=Expected[1]) {
+					break;
+				}
+			}
+			if (Address[0]>=dwEnd) {
+				continue;
+			}
+			for (nSide=0; nSide<2; nSide++) {
+				BYTE nData;
+
+				if (bGB) {
+					if (!ByteBusRead(fd_X, fd_Y, Address[nSide], &nData, 1, 0)) {
+						return 0;
+					}
+					Read[nSide] = nData;
+				} else if (!ReadROMWordExplicit(fd_X, fd_Y, Address[nSide], &Read[nSide])) {
+					return 0;
+				}
+				nMatches += (Read[nSide]==Expected[nSide]);
+				nReads++;
+			}
+			if (Read[0]==Expected[0] && Read[1]==Expected[1]) {
+				continue;
+			}
+			//printed only if this is the inserted system
+			nFaults++;
+			if (Read[0]==Read[1]) {
+				nReport += snprintf(&szReport[nReport], sizeof(szReport)-nReport, "  %s%d has no effect (0x%lX and 0x%lX read 0x%X)\n",
+				  bGB ? "A" : "AD", nLine, Address[0], Address[1], (unsigned int)Read[0]);
+			} else {
+				nSide = (Read[0]==Expected[0]) ? 1 : 0;
+				nReport += snprintf(&szReport[nReport], sizeof(szReport)-nReport, "  %s%d: 0x%lX read 0x%X, expected 0x%X\n",
+				  bGB ? "A" : "AD", nLine, Address[nSide], (unsigned int)Read[nSide], (unsigned int)Expected[nSide]);
+			}
+			if (nReport>=sizeof(szReport)) {
+				nReport = sizeof(szReport)-1;
+			}
+		}
+		SetControlBit(fd_Y, ControlByteDefault);
+		if (bRDviaGIOMode) {
+			GBxGPIOWrite(GPIO_RD, HIGH);
+		}
+		if (nMatches) {
+			printf("%s", szReport);
+			printf("address line test (%s header, %d reads) %s\n", bGB ? "GB" : "GBA", nReads, nFaults ? "failed" : "passed");
+			JSONEmit("\"event\":\"selftest\",\"part\":\"address\",\"faults\":%d", nFaults);
+			return 0==nFaults;
+		}
+	}
+	printf("address line test skipped: no header (no cartridge, or options -l and -h swapped)\n");
+	return 1;
+}
+
+
+//###########################################################
+// Session API (libgbxdump.h)
+
+void GBxAbort(void) {
+	end = 1;
+}
+
+int GBxAborted(void) {
+	return end;
+}
+
+void GBxSettingsDefault(struct GBxSettings* pSettings) {
+	memset(pSettings, 0, sizeof(*pSettings));
+	pSettings->GPIO_SW = 16;
+	pSettings->GPIO_LED = 4;
+	pSettings->GPIO_RD = 26;
+	pSettings->I2CNo = 1;
+	pSettings->SlaveAddr_IC1 = 0x22;
+	pSettings->SlaveAddr_IC2 = 0x21;
+	pSettings->bRDviaGIOMode = 1;
+	pSettings->bAutoAddressMode = 1;
+	pSettings->SpotCheckInterval = 0x4000;
+	pSettings->VoteMajority = 2;
+	pSettings->VoteReads = 3;
+	pSettings->JSONRate_ms = 1000;
+}
+
+static void SettingsApply(const struct GBxSettings* pSettings) {
+	GPIO_SW = pSettings->GPIO_SW;
+	GPIO_LED = pSettings->GPIO_LED;
+	GPIO_RD = pSettings->GPIO_RD;
+	szGPIOChip = pSettings->szGPIOChip;
+	I2CNo = pSettings->I2CNo;
+	SlaveAddr_IC1 = pSettings->SlaveAddr_IC1;
+	SlaveAddr_IC2 = pSettings->SlaveAddr_IC2;
+	bRDviaGIOMode = pSettings->bRDviaGIOMode;
+	bAutoAddressMode = pSettings->bAutoAddressMode;
+	bVerify = pSettings->bVerify;
+	bLog = pSettings->bLog;
+	bAD0_7_swap = pSettings->bAD0_7_swap;
+	bAD8_15_swap = pSettings->bAD8_15_swap;
+	bAD16_23_swap = pSettings->bAD16_23_swap;
+	bAD0_7_AD8_15_swap = pSettings->bAD0_7_AD8_15_swap;
+	Force_GBA_MaxAddress = pSettings->Force_GBA_MaxAddress;
+	AddrOffset = pSettings->AddrOffset;
+	SpotCheckInterval = pSettings->SpotCheckInterval;
+	VoteMajority = pSettings->VoteMajority;
+	VoteReads = pSettings->VoteReads;
+	bCalibrate = pSettings->bCalibrate;
+	bTune = pSettings->bTune;
+	bSelfTest = pSettings->bSelfTest;
+	szProfileFile = pSettings->szProfileFile;
+	szLibraryDir = pSettings->szLibraryDir;
+	szArchiveDir = pSettings->szArchiveDir;
+	bGzip = pSettings->bGzip;
+	szFatImage = pSettings->szFatImage;
+	szHeatmapFile = pSettings->szHeatmapFile;
+	szMetricsFile = pSettings->szMetricsFile;
+	JSONRate_ms = pSettings->JSONRate_ms;
+	szRanges = pSettings->szRanges;
+}
+
+int GBxInit(const struct GBxSettings* pSettings) {
+	struct stat fileStat;
+	FILE *fp;
+
+	SettingsApply(pSettings);
+	if (stat(szGBARelaeseList,&fileStat) >=0)  {
+		int nRead = 0;
+		printf("loding gba release list (%d kB)...", (int)fileStat.st_size/1024);
+		fflush(stdout);
+		GBARelaeseListBuffer = (char*)malloc(fileStat.st_size+1);
+		if (GBARelaeseListBuffer) {
+			GBARelaeseListBufferSize = fileStat.st_size;
+			fp = fopen(szGBARelaeseList, "r");
+			if (fp) {
+				nRead = fread(GBARelaeseListBuffer, sizeof(char), GBARelaeseListBufferSize, fp);
+				GBARelaeseListBuffer[GBARelaeseListBufferSize] = '\0';
+				fclose(fp);
+				printf("done\n");
+			} else {
+				perror("opening GBA release file failed");
+			}
+			GBARelaeseListBuffer[nRead] = '\0';
+			fflush(stdout);
+		} else {
+			printf("file buffer error\n");
+		}
+	} else {
+		perror("GBA release file error");
+	}
+
+	printf("Init GPIO interface\n");
+	if (!GPIOSetup()) {
+		return 0;
+	}
+	return 1;
+}
+
+void GBxExit(void) {
+	GPIORelease();
+	if (GBARelaeseListBuffer) {
+		free(GBARelaeseListBuffer);
+		GBARelaeseListBuffer = NULL;
+	}
+}
+
+struct GBxSession* GBxSessionOpen(const struct GBxSettings* pSettings, const struct GBxCallbacks* pCallbacks, void* pUser) {
+	static struct GBxSession Handle;
+	char dev_i2c[20];
+
+	if (pGBxSession) {
+		fprintf(stderr, "GBx session already open\n");
+		return NULL;
+	}
+	SettingsApply(pSettings);
+	memset(&Handle, 0, sizeof(Handle));
+	if (pCallbacks) {
+		Handle.Callbacks = *pCallbacks;
+	}
+	Handle.pUser = pUser;
+	Handle.bWriteFiles = 1;
+	Handle.fd_X = Handle.fd_Y = -1;
+	pGBxSession = &Handle;
+
+	if (GPIO_RD) {
+		printf("Set RD GPIO to default...\n");
+		if (!GBxGPIOMode(GPIO_RD, OUTPUT) && bRDviaGIOMode) {
+			pGBxSession = NULL;
+			return NULL;
+		}
+		GBxGPIOWrite(GPIO_RD, HIGH);
+	}
+	sprintf(dev_i2c, "/dev/i2c-%d", I2CNo);
+	printf("open dev_i2c '%s'...\n", dev_i2c);
+	if ((Handle.fd_X = open(dev_i2c, O_RDWR)) < 0) {
+		GBxReportError(GBxErrorBus, "Failed to open i2c bus '%s'", dev_i2c);
+		pGBxSession = NULL;
+		return NULL;
+	}
+	printf("set slave 0x%02X for IC1 (AD0-AD15) ...\n", SlaveAddr_IC1);
+	if (ioctl(Handle.fd_X, I2C_SLAVE, SlaveAddr_IC1) < 0) {
+		GBxReportError(GBxErrorBus, "Failed to acquire i2c bus access or talk to slave %X", SlaveAddr_IC1);
+		close(Handle.fd_X);
+		pGBxSession = NULL;
+		return NULL;
+	}
+
+	printf("open dev_i2c '%s'...\n", dev_i2c);
+	if ((Handle.fd_Y = open(dev_i2c, O_RDWR)) < 0) {
+		GBxReportError(GBxErrorBus, "Failed to open i2c bus '%s'", dev_i2c);
+		close(Handle.fd_X);
+		pGBxSession = NULL;
+		return NULL;
+	}
+	printf("set slave 0x%02X for IC2 (A16-A23, Control) ...\n", SlaveAddr_IC2);
+	if (ioctl(Handle.fd_Y, I2C_SLAVE, SlaveAddr_IC2) < 0) {
+		GBxReportError(GBxErrorBus, "Failed to acquire i2c bus access or talk to slave %X", SlaveAddr_IC2);
+		close(Handle.fd_X);
+		close(Handle.fd_Y);
+		pGBxSession = NULL;
+		return NULL;
+	}
+	return &Handle;
+}
+
+void GBxSessionClose(struct GBxSession* pSession) {
+	if (!pSession || pSession!=pGBxSession) {
+		return;
+	}
+	printf("\nSet control byte to default\n");
+	SetControlBit(pSession->fd_Y, ControlByteDefault);
+	if (bRDviaGIOMode) {
+		GBxGPIOWrite(GPIO_RD, HIGH); // RD_HIGH
+		GBxGPIOMode(GPIO_RD, INPUT);
+	}
+	//Set MCP to input
+	I2CWriteWord(pSession->fd_X, MCP_Direction, MCP_WINPUT);
+	I2CWriteWord(pSession->fd_Y, MCP_Direction, MCP_WINPUT);
+
+	close(pSession->fd_X);
+	close(pSession->fd_Y);
+	pGBxSession = NULL;
+}
+
+// Local files (also FAT image, archive, DAT) only without --stream and
+// with bWriteFiles. With --fat-image the dumps go only into the image,
+// unless --library or --archive read them back from the SD card.
+static void GBxSessionOutputs(struct GBxSession* pSession) {
+	bLocalFiles = fd_Stream<0 && pSession->bWriteFiles;
+	if (!bLocalFiles && (bGzip || szFatImage || szArchiveDir)) {
+		printf("no local files: --gzip, --fat-image and --archive ignored\n");
+		bGzip = 0;
+		szFatImage = NULL;
+		szArchiveDir = NULL;
+	}
+	bLocalDumpFiles = bLocalFiles && (!szFatImage || szLibraryDir || szArchiveDir);
+}
+
+CartSystem GBxProbe(struct GBxSession* pSession) {
+	pSession->nSystem = ProbeCartridge(pSession->fd_X, pSession->fd_Y);
+	return pSession->nSystem;
+}
+
+int GBxReadGBAHeader(struct GBxSession* pSession) {
+	return DumpGBAROMHeader(pSession->fd_X, pSession->fd_Y);
+}
+
+int GBxDumpGBAROM(struct GBxSession* pSession) {
+	GBxSessionOutputs(pSession);
+	if (EXIT_SUCCESS != DumpGBAROM(pSession->fd_X, pSession->fd_Y, GBAHeader.szGameName)) {
+		return EXIT_FAILURE;
+	}
+	pSession->bROMDumpDone = 1;
+	strcpy(pSession->szROMFile, szGameFileNameROM);
+	return EXIT_SUCCESS;
+}
+
+int GBxDumpGBASave(struct GBxSession* pSession) {
+	GBxSessionOutputs(pSession);
+	if (RAMTypeEEPROM == GBAHeader.nRAMType && 512 != GBAHeader.nRAMSizeByte && 8192 != GBAHeader.nRAMSizeByte) {
+		GBAHeader.nRAMSizeByte = EEPROMDetectSize(pSession->fd_X, pSession->fd_Y, (GBAHeader.nROMSize) ? GBAHeader.nROMSize : Force_GBA_MaxAddress*2/1024/1024);
+	}
+	if (RAMTypeUnknown == GBAHeader.nRAMType || EXIT_SUCCESS != DumpGBASave(pSession->fd_X, pSession->fd_Y, GBAHeader.nRAMType, GBAHeader.nRAMSizeByte)) {
+		return EXIT_FAILURE;
+	}
+	pSession->bRAMDumpDone = 1;
+	strcpy(pSession->szRAMFile, szGameFileNameRAM);
+	return EXIT_SUCCESS;
+}
+
+// Save image (plain or gzip) to the GBA cartridge in the slot
+int GBxRestoreGBASave(struct GBxSession* pSession, const char* szFileName) {
+	int nROMSize;
+
+	if (bSelfTest && !BusSelfTest(pSession->fd_X, pSession->fd_Y)) {
+		GBxReportError(GBxErrorBus, "bus self-test failed, restore refused");
+		return EXIT_FAILURE;
+	}
+	if (bCalibrate && !CalibrateWiring(pSession->fd_X, pSession->fd_Y)) {
+		GBxReportError(GBxErrorCartridge, "wiring calibration failed (no cartridge?), restore skipped");
+		return EXIT_FAILURE;
+	}
+	if (bSelfTest && !CartSelfTest(pSession->fd_X, pSession->fd_Y)) {
+		GBxReportError(GBxErrorCartridge, "address line test failed, restore refused");
+		return EXIT_FAILURE;
+	}
+	if (CartSystemGBA != GBxProbe(pSession)) {
+		GBxReportError(GBxErrorCartridge, "no GBA cartridge, restore skipped");
+		return EXIT_FAILURE;
+	}
+	if (EXIT_SUCCESS != GBxReadGBAHeader(pSession)) {
+		GBxReportError(GBxErrorCartridge, "invalid GBA header (cartridge seated?), restore refused");
+		return EXIT_FAILURE;
+	}
+	nROMSize = (GBAHeader.nROMSize) ? GBAHeader.nROMSize : Force_GBA_MaxAddress*2/1024/1024;
+	if (EXIT_SUCCESS != RestoreGBASave(pSession->fd_X, pSession->fd_Y, GBAHeader.nRAMType, GBAHeader.nRAMSizeByte, nROMSize, szFileName)) {
+		GBxReportError((end) ? GBxErrorCancelled : GBxErrorDump, "save restore failed");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Image (plain or gzip) to a repro/flash cart in the slot
+int GBxProgramGBAROM(struct GBxSession* pSession, const char* szFileName) {
+	if (bSelfTest && !BusSelfTest(pSession->fd_X, pSession->fd_Y)) {
+		GBxReportError(GBxErrorBus, "bus self-test failed, programming refused");
+		return EXIT_FAILURE;
+	}
+	if (EXIT_SUCCESS != ProgramGBAROM(pSession->fd_X, pSession->fd_Y, szFileName)) {
+		GBxReportError((end) ? GBxErrorCancelled : GBxErrorDump, "flash cart programming failed");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Only the ROM ranges of szRanges, to local files
+int GBxDumpGBARanges(struct GBxSession* pSession) {
+	GBxSessionOutputs(pSession);
+	if (!bLocalFiles) {
+		GBxReportError(GBxErrorDump, "range dumps need local files (no --stream)");
+		return EXIT_FAILURE;
+	}
+	if (!RangesParse(szRanges)) {
+		GBxReportError(GBxErrorDump, "no valid ranges in '%s'", szRanges);
+		return EXIT_FAILURE;
+	}
+	if (bSelfTest && !BusSelfTest(pSession->fd_X, pSession->fd_Y)) {
+		GBxReportError(GBxErrorBus, "bus self-test failed, dump refused");
+		return EXIT_FAILURE;
+	}
+	if (bCalibrate && !CalibrateWiring(pSession->fd_X, pSession->fd_Y)) {
+		GBxReportError(GBxErrorCartridge, "wiring calibration failed (no cartridge?), dump skipped");
+		return EXIT_FAILURE;
+	}
+	if (CartSystemGBA != GBxProbe(pSession)) {
+		GBxReportError(GBxErrorCartridge, "no GBA cartridge, range dump skipped");
+		return EXIT_FAILURE;
+	}
+	if (EXIT_SUCCESS != GBxReadGBAHeader(pSession)) {
+		GBxReportError(GBxErrorCartridge, "invalid GBA header (cartridge seated?), range dump refused");
+		return EXIT_FAILURE;
+	}
+	if (EXIT_SUCCESS != DumpGBARanges(pSession->fd_X, pSession->fd_Y, GBAHeader.szGameName)) {
+		GBxReportError((end) ? GBxErrorCancelled : GBxErrorDump, "range dump failed");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// EXIT_FAILURE if there is no GB(C) cartridge
+int GBxDumpGB(struct GBxSession* pSession) {
+	GBxSessionOutputs(pSession);
+	if (EXIT_FAILURE == DumpGBROM(pSession->fd_X, pSession->fd_Y, &pSession->bROMDumpDone, &pSession->bRAMDumpDone)) {
+		return EXIT_FAILURE;
+	}
+	if (pSession->bROMDumpDone) {
+		strcpy(pSession->szROMFile, szGameFileNameROM);
+	}
+	if (pSession->bRAMDumpDone) {
+		strcpy(pSession->szRAMFile, szGameFileNameRAM);
+	}
+	return EXIT_SUCCESS;
+}
+
+// One cartridge: detect GB(C) or GBA, dump save and ROM, write DAT, archive
+// and FAT image. EXIT_SUCCESS if ROM or save was dumped.
+int GBxDumpCartridge(struct GBxSession* pSession) {
+	int fd_X = pSession->fd_X;
+	int fd_Y = pSession->fd_Y;
+
+	pSession->bROMDumpDone = 0;
+	pSession->bRAMDumpDone = 0;
+	pSession->bKnownGood = 0;
+	pSession->szROMFile[0] = '\0';
+	pSession->szRAMFile[0] = '\0';
+	GBxSessionOutputs(pSession);
+	if (bSelfTest && !BusSelfTest(fd_X, fd_Y)) {
+		GBxReportError(GBxErrorBus, "bus self-test failed, dump refused");
+		return EXIT_FAILURE;
+	}
+	if (bCalibrate && !CalibrateWiring(fd_X, fd_Y)) {
+		GBxReportError(GBxErrorCartridge, "wiring calibration failed (no cartridge?), dump skipped");
+		return EXIT_FAILURE;
+	}
+	if (bSelfTest && !CartSelfTest(fd_X, fd_Y)) {
+		GBxReportError(GBxErrorCartridge, "address line test failed, dump refused");
+		return EXIT_FAILURE;
+	}
+
+	DatBegin("", "");
+	FatImageReset();
+	QualityReset();
+	JSONEmit("\"event\":\"start\",\"i2c\":%d,\"auto_address\":%s,\"verify\":%s", I2CNo, bAutoAddressMode ? "true" : "false", bVerify ? "true" : "false");
+	//Autodedect GB(C) and GBA
+	if (CartSystemGB != GBxProbe(pSession) || EXIT_FAILURE == GBxDumpGB(pSession)) {
+		if (EXIT_SUCCESS != GBxReadGBAHeader(pSession)) {
+			//this cartridge only, the next one is dumped as usual
+			if (!end) {
+				ReportResult("rom", GBAHeader.szGameName, 0, 0, "header_invalid", 0, 0, 0);
+				GBxReportError(GBxErrorCartridge, "invalid GBA header (cartridge seated?), dump skipped");
+			}
+		} else {
+			if (bTune) {
+				TuneReadStrategy(fd_X, fd_Y);
+			}
+			pSession->bKnownGood = szLibraryDir && EXIT_SUCCESS == LibraryIdentify(fd_X, fd_Y);
+			if (EXIT_SUCCESS == GBxDumpGBASave(pSession)) {
+				printf("GBA RAM dumped successful!\n");
+			}
+
+			if (pSession->bKnownGood || EXIT_SUCCESS == GBxDumpGBAROM(pSession)) {
+				RAMType nScanRAMType;
+				int nScanRAMSizeByte, nLibrary;
+
+				if (pSession->bKnownGood) {
+					printf("GBA ROM taken from library!\n");
+					pSession->bROMDumpDone = 1;
+					strcpy(pSession->szROMFile, szGameFileNameROM);
+				} else {
+					printf("GBA ROM dumped successful!\n");
+					if (szLibraryDir && bLocalFiles) {
+						LibraryAdd(szGameFileNameROM);
+					}
+				}
+				//save type not in gbalist: use the library ID found in the ROM
+				nLibrary = SaveScanResult(&nScanRAMType, &nScanRAMSizeByte);
+				if (!pSession->bRAMDumpDone && RAMTypeUnknown==GBAHeader.nRAMType && nLibrary && !end) {
+					printf("save library '%s' found in ROM\n", SaveLibraries[nLibrary-1].szID);
+					if (RAMTypeEEPROM == nScanRAMType) {
+						nScanRAMSizeByte = EEPROMDetectSize(fd_X, fd_Y, (GBAHeader.nROMSize) ? GBAHeader.nROMSize : Force_GBA_MaxAddress*2/1024/1024);
+					}
+					JSONEmit("\"event\":\"save_detected\",\"library\":\"%s\",\"ram_type\":%d,\"ram_size\":%d",
+					  SaveLibraries[nLibrary-1].szID, (int)nScanRAMType, nScanRAMSizeByte);
+					if (EXIT_SUCCESS == DumpGBASave(fd_X, fd_Y, nScanRAMType, nScanRAMSizeByte)) {
+						printf("GBA RAM dumped successful!\n");
+						pSession->bRAMDumpDone = 1;
+						strcpy(pSession->szRAMFile, szGameFileNameRAM);
+					}
+				}
+			}
+		}
+	} else if (pSession->bROMDumpDone) {
+		printf("GB(C) ROM dumped successful!\n");
+	}
+
+	if (pSession->bRAMDumpDone) {
+		ArchiveFile(szGameFileNameRAM);
+	}
+	if (!end && (bLocalFiles || fd_Stream>=0)) {
+		DatWrite();
+	}
+	FatImageClose();
+	QualityReport();
+	StreamSend(StreamFrameEnd, NULL, 0);
+	MetricsWrite();
+	JSONEmit("\"event\":\"end\",\"rom\":%s,\"ram\":%s,\"cancelled\":%s", pSession->bROMDumpDone ? "true" : "false", pSession->bRAMDumpDone ? "true" : "false", end ? "true" : "false");
+	if (end) {
+		GBxReportError(GBxErrorCancelled, "dump cancelled");
+	}
+	return (pSession->bROMDumpDone || pSession->bRAMDumpDone) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,137 @@
+// libgbxdump: GB(C) and GBA cartridge dump engines of GBxDumper
+// by Martin Strohmayer
+// Licence: CC BY-NC 3.0 (https://creativecommons.org/licenses/by-nc/3.0/)
+//
+// Settings are a struct GBxSettings (GBxSettingsDefault, then the options),
+// passed to GBxInit and GBxSessionOpen. One session (one dumper board) at a
+// time. Dump data is handed to the block callback while it is read, writing
+// the local files can be turned off. All exported names start with GBx, the
+// signal handling of the host process is left alone (no SIGPIPE on --json or
+// --stream readers that go away, the write fails with EPIPE).
+
+#ifndef LIBGBXDUMP_H
+#define LIBGBXDUMP_H
+
+#include <stddef.h>
+#include <signal.h>
+
+typedef enum {
+	CartSystemNone = 0,
+	CartSystemGB,
+	CartSystemGBA
+} CartSystem;
+
+typedef enum {
+	GBxDataROM = 0,
+	GBxDataSave
+} GBxDataKind;
+
+typedef enum {
+	GBxErrorBus = 1,        // I2C bus or GPIO
+	GBxErrorCartridge,      // no cartridge, wiring not detected
+	GBxErrorDump,           // ROM or save dump failed
+	GBxErrorCancelled       // GBxAbort
+} GBxError;
+
+struct GBxCallbacks {
+	// Verified dump data in file order, nOffset from the start of the file.
+	// Return 0 to abort the dump.
+	int (*Block)(void* pUser, GBxDataKind nKind, unsigned long nOffset, const unsigned char* pData, size_t nLen);
+	// Dump complete, szName is the final file name (also without local files)
+	void (*Finished)(void* pUser, GBxDataKind nKind, const char* szName, unsigned long nSize);
+	// szArtifact "rom", "eeprom", "ram", "gb_rom", "gb_ram"
+	void (*Progress)(void* pUser, const char* szArtifact, unsigned long nDone, unsigned long nTotal);
+	void (*Error)(void* pUser, GBxError nError, const char* szMessage);
+};
+
+struct GBxSession {
+	int fd_X;                     // IC1 (AD0-AD15)
+	int fd_Y;                     // IC2 (A16-A23, Control)
+	struct GBxCallbacks Callbacks;
+	void* pUser;
+	int bWriteFiles;              // 0: data only through the callbacks
+	// result of GBxDumpCartridge, valid until the next GBxSessionOpen
+	CartSystem nSystem;
+	int bROMDumpDone;
+	int bRAMDumpDone;
+	int bKnownGood;               // ROM taken from the library
+	char szROMFile[16+4+3+1];
+	char szRAMFile[16+4+3+1];
+};
+
+//Settings of GBxInit and GBxSessionOpen, options of gbxdumper in brackets
+struct GBxSettings {
+	int GPIO_SW;                  // switch (s, 0 = off)
+	int GPIO_LED;                 // LED (e, 0 = off)
+	int GPIO_RD;                  // RD (g)
+	const char* szGPIOChip;       // NULL: wiringPi (--gpio-chip)
+	int I2CNo;                    // /dev/i2c-<n> (i)
+	unsigned int SlaveAddr_IC1;   // AD0-AD15 (l)
+	unsigned int SlaveAddr_IC2;   // A16-A23, Control (h)
+	int bRDviaGIOMode;            // 0: RD via I2C (r)
+	int bAutoAddressMode;         // 0: explicit addresses (n)
+	int bVerify;                  // f
+	int bLog;                     // v
+	int bAD0_7_swap;              // a
+	int bAD8_15_swap;             // b
+	int bAD16_23_swap;            // c
+	int bAD0_7_AD8_15_swap;       // x
+	unsigned long Force_GBA_MaxAddress;  // words, 0: from the gbalist (z)
+	unsigned long AddrOffset;     // o
+	unsigned long SpotCheckInterval;     // words, 0 = off (--spot-check)
+	int VoteMajority;             // --vote
+	int VoteReads;
+	int bCalibrate;               // --calibrate
+	int bTune;                    // --tune
+	int bSelfTest;                // --self-test
+	const char* szProfileFile;    // --profile
+	const char* szLibraryDir;     // --library
+	const char* szArchiveDir;     // --archive
+	int bGzip;                    // --gzip
+	const char* szFatImage;       // --fat-image
+	const char* szHeatmapFile;    // --heatmap
+	const char* szMetricsFile;    // --metrics
+	int JSONRate_ms;              // --json-rate
+	const char* szRanges;         // --ranges
+};
+
+void GBxSettingsDefault(struct GBxSettings* pSettings);
+
+//Station outputs
+void GBxProfileKeep(const char* szKey);      // option given, GBxProfileLoad keeps it
+int GBxProfileLoad(struct GBxSettings* pSettings, const char* szFileName);
+int GBxJSONOpen(const char* szTarget);
+void GBxMetricsLoad(const struct GBxSettings* pSettings);
+int GBxArchiveExtract(const struct GBxSettings* pSettings, const char* szManifest);
+int GBxStreamOpen(const char* szTarget);
+int GBxQualityDiff(const struct GBxSettings* pSettings, const char* szFileName1, const char* szFileName2);
+int GBxVoteSet(struct GBxSettings* pSettings, const char* szVote);
+
+//GPIO backend (wiringPi or --gpio-chip), wiringPi pin numbers and levels
+int GBxGPIOMode(int nPin, int nMode);
+int GBxGPIOPullUp(int nPin);
+void GBxGPIOWrite(int nPin, int nValue);
+int GBxGPIORead(int nPin);
+int GBxGPIOWaitEdge(int nPin, int nTimeout_ms);
+
+//Session
+int GBxInit(const struct GBxSettings* pSettings);  // GPIO setup, GBA release list
+void GBxExit(void);
+void GBxAbort(void);              // async-signal-safe
+int GBxAborted(void);
+struct GBxSession* GBxSessionOpen(const struct GBxSettings* pSettings, const struct GBxCallbacks* pCallbacks, void* pUser);
+void GBxSessionClose(struct GBxSession* pSession);
+CartSystem GBxWaitCartridge(struct GBxSession* pSession);  // --auto-start
+
+//Engines (EXIT_SUCCESS/EXIT_FAILURE)
+CartSystem GBxProbe(struct GBxSession* pSession);
+int GBxReadGBAHeader(struct GBxSession* pSession);
+int GBxDumpGBAROM(struct GBxSession* pSession);
+int GBxDumpGBASave(struct GBxSession* pSession);
+int GBxRestoreGBASave(struct GBxSession* pSession, const char* szFileName);
+int GBxProgramGBAROM(struct GBxSession* pSession, const char* szFileName);
+int GBxDumpGBARanges(struct GBxSession* pSession);
+int GBxDumpGB(struct GBxSession* pSession);
+int GBxDumpCartridge(struct GBxSession* pSession);
+
+#endif
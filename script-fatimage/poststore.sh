@@ -0,0 +1,3 @@
+#!/bin/bash
+# the dumps are already in the FAT image, only re-expose it to the host
+sudo modprobe g_mass_storage file=/dev/ram0 stall=0 ro=1
@@ -0,0 +1,2 @@
+#!/bin/bash
+sudo rmmod g_mass_storage
@@ -0,0 +1,9 @@
+#!/bin/bash
+# please add ramdisk_size=49152 to kernel parameter (/boot/cmdline.txt)
+# gbxdumper --fat-image /dev/ram0 writes MBR and FAT32 itself, no fdisk/mkdosfs
+echo GBx-Dumper Start-Script
+echo -n "System: "
+uname -a
+echo -n "User: "
+whoami
+sudo modprobe g_mass_storage file=/dev/ram0 stall=0 ro=1